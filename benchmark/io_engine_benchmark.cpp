@@ -0,0 +1,196 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "netlib/io_engine.h"
+#include "netlib/resolver.h"
+#include "netlib/tcp.h"
+
+using namespace net;
+
+static const int64_t kConnTimeout = 1000; // ms
+
+struct Result {
+    double Seconds;
+    double CPUSeconds;
+};
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void runClients(uint16_t port, int conns, int messages, size_t size) {
+    std::vector<std::thread> clients;
+    for (int i = 0; i < conns; i++) {
+        clients.push_back(std::thread([=]() {
+            std::shared_ptr<TCPSocket> socket;
+            error err = ConnectTCP("127.0.0.1", port, kConnTimeout, &socket);
+            if (err != error::nil) {
+                fprintf(stderr, "%s\n", error::Message(err));
+                exit(1);
+            }
+            std::vector<char> buf(size, 'x');
+            for (int j = 0; j < messages; j++) {
+                if (socket->WriteFull(buf.data(), size) != error::nil
+                        || socket->ReadFull(buf.data(), size) != error::nil) {
+                    fprintf(stderr, "echo failed\n");
+                    exit(1);
+                }
+            }
+        }));
+    }
+    for (auto& th : clients) {
+        th.join();
+    }
+}
+
+static Result measure(const std::function<void()>& f) {
+    using namespace std::chrono;
+    double cpu = cpuSeconds();
+    auto start = steady_clock::now();
+    f();
+    auto stop = steady_clock::now();
+    Result result;
+    result.Seconds = duration_cast<duration<double>>(stop - start).count();
+    result.CPUSeconds = cpuSeconds() - cpu;
+    return result;
+}
+
+static Result benchBlocking(int conns, int messages, size_t size) {
+    std::shared_ptr<TCPListener> listener;
+    ListenTCP(0, &listener);
+    uint16_t port = 0;
+    LookupPort(listener->FD(), &port);
+
+    std::thread server([=]() {
+        std::vector<std::thread> handlers;
+        for (int i = 0; i < conns; i++) {
+            std::shared_ptr<TCPSocket> socket;
+            if (listener->Accept(&socket) != error::nil) {
+                break;
+            }
+            handlers.push_back(std::thread([=]() {
+                std::vector<char> buf(size);
+                int nbytes;
+                while (socket->Read(buf.data(), buf.size(), &nbytes) == error::nil) {
+                    if (socket->WriteFull(buf.data(), nbytes) != error::nil) {
+                        break;
+                    }
+                }
+            }));
+        }
+        for (auto& th : handlers) {
+            th.join();
+        }
+    });
+    Result result = measure([=]() {
+        runClients(port, conns, messages, size);
+    });
+    server.join();
+    return result;
+}
+
+// The data echoed on a connection, which is sent one buffer at a time in the order received
+struct EchoQueue {
+    std::deque<std::vector<char>> Buffers; // the front is in flight
+    size_t Sent; // bytes of the front already sent
+};
+
+static void sendFront(IOEngine* engine, SocketFD fd, const std::shared_ptr<EchoQueue>& queue) {
+    const std::vector<char>& front = queue->Buffers.front();
+    engine->Send(fd, front.data() + queue->Sent, front.size() - queue->Sent, [=](const error& err, int nbytes) {
+        if (err != error::nil) {
+            return;
+        }
+        queue->Sent += nbytes;
+        if (queue->Sent == queue->Buffers.front().size()) {
+            queue->Buffers.pop_front();
+            queue->Sent = 0;
+        }
+        // resubmit the remainder of a short send, or the next buffer
+        if (!queue->Buffers.empty()) {
+            sendFront(engine, fd, queue);
+        }
+    });
+}
+
+static Result benchEngine(IOEngineType type, int conns, int messages, size_t size, bool* supported) {
+    IOEngineConfig config = {};
+    config.Type = type;
+    config.BufferSize = size;
+    std::shared_ptr<IOEngine> engine;
+    error err = NewIOEngine(config, &engine);
+    *supported = (err == error::nil);
+    if (!*supported) {
+        return Result();
+    }
+
+    std::shared_ptr<TCPListener> listener;
+    ListenTCP(0, &listener);
+    uint16_t port = 0;
+    LookupPort(listener->FD(), &port);
+
+    std::vector<std::shared_ptr<TCPSocket>> sockets;
+    engine->AcceptMultishot(listener->FD(), [&](const error& err, const std::shared_ptr<TCPSocket>& sock) {
+        if (err != error::nil) {
+            return;
+        }
+        sockets.push_back(sock);
+        std::shared_ptr<EchoQueue> queue = std::make_shared<EchoQueue>();
+        queue->Sent = 0;
+        IOEngine* e = engine.get();
+        SocketFD fd = sock->FD();
+        engine->RecvMultishot(fd, [=](const error& err, const char* data, int nbytes) {
+            if (err != error::nil) {
+                return;
+            }
+            queue->Buffers.emplace_back(data, data + nbytes);
+            if (queue->Buffers.size() == 1) {
+                sendFront(e, fd, queue);
+            }
+        });
+    });
+    std::thread server([&]() {
+        engine->Run();
+    });
+    Result result = measure([=]() {
+        runClients(port, conns, messages, size);
+    });
+    engine->Stop();
+    server.join();
+    return result;
+}
+
+static void report(const char* name, const Result& result, int conns, int messages) {
+    double total = (double) conns * messages;
+    printf("%-10s %10.0f msg/s %8.2f us/msg (cpu)\n",
+            name, total / result.Seconds, result.CPUSeconds / total * 1e6);
+}
+
+int main(int argc, char** argv) {
+    int conns = (argc > 1) ? atoi(argv[1]) : 8;
+    int messages = (argc > 2) ? atoi(argv[2]) : 20000;
+    size_t size = (argc > 3) ? (size_t) atoi(argv[3]) : 64;
+    printf("loopback echo: %d connections x %d messages x %zu bytes\n", conns, messages, size);
+
+    report("blocking", benchBlocking(conns, messages, size), conns, messages);
+    bool supported;
+    Result epoll = benchEngine(IOEngineType::Epoll, conns, messages, size, &supported);
+    report("epoll", epoll, conns, messages);
+    Result uring = benchEngine(IOEngineType::IOUring, conns, messages, size, &supported);
+    if (supported) {
+        report("io_uring", uring, conns, messages);
+    } else {
+        printf("%-10s not supported\n", "io_uring");
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/resource.h>
+#include "netlib/resolver.h"
+#include "netlib/tcp.h"
+
+using namespace net;
+
+static const int64_t kConnTimeout = 1000; // ms
+static const size_t kBuffers = 8; // the minimum number of buffers in flight of a zero-copy sender
+// Sends complete on the ACK only, which the peer delays while less than a couple of segments
+// are unacknowledged, so a few small buffers in flight would wait for the delayed ACK each time.
+static const size_t kInFlight = 4 * 1024 * 1024;
+
+struct Result {
+    double Seconds;
+    double CPUSeconds; // of the sending thread only
+    uint64_t Completions;
+    uint64_t Copied;
+};
+
+static double threadCPUSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void fail(const char* what, const error& err) {
+    fprintf(stderr, "%s: %s\n", what, error::Message(err));
+    exit(1);
+}
+
+// Counts the completed zero-copy sends, which the kernel reports in order.
+struct Completions {
+    uint64_t Done;
+    uint64_t Copied;
+};
+
+static void reap(const std::shared_ptr<TCPSocket>& socket, bool wait, Completions* completions) {
+    if (wait) {
+        struct pollfd pfd = {0};
+        pfd.fd = socket->FD(); // POLLERR is reported without being requested
+        poll(&pfd, 1, 100);
+    }
+    std::vector<ZeroCopyCompletion> list;
+    socket->ReadZeroCopyCompletions(&list);
+    for (auto& c : list) {
+        uint64_t n = (uint64_t) (c.Last - c.First) + 1;
+        completions->Done += n;
+        if (c.Copied) {
+            completions->Copied += n;
+        }
+    }
+}
+
+static Result send(const std::shared_ptr<TCPSocket>& socket, size_t size, size_t total, bool zeroCopy) {
+    using namespace std::chrono;
+    size_t nBuffers = std::max(kBuffers, kInFlight / size);
+    std::vector<std::vector<char>> buffers(nBuffers, std::vector<char>(size, 'x'));
+    std::vector<uint64_t> lastIDs(nBuffers, 0); // the number of sends which have to complete before reuse
+    Completions completions = {0, 0};
+    uint64_t sends = 0;
+
+    double cpu = threadCPUSeconds();
+    auto start = steady_clock::now();
+    for (size_t sent = 0, i = 0; sent < total; sent += size, i++) {
+        std::vector<char>& buf = buffers[i % nBuffers];
+        if (!zeroCopy) {
+            error err = socket->WriteFull(buf.data(), buf.size());
+            if (err != error::nil) {
+                fail("write", err);
+            }
+            continue;
+        }
+
+        while (completions.Done < lastIDs[i % nBuffers]) { // the buffer is still pinned
+            reap(socket, true, &completions);
+        }
+        size_t offset = 0;
+        while (offset < buf.size()) {
+            int nbytes = 0;
+            error err = socket->WriteZeroCopy(&buf[offset], buf.size() - offset, &nbytes, nullptr);
+            if (err == error::nobufs) { // too many pending notifications
+                reap(socket, true, &completions);
+                continue;
+            }
+            if (err != error::nil) {
+                fail("write zero-copy", err);
+            }
+            offset += nbytes;
+            sends++;
+        }
+        lastIDs[i % nBuffers] = sends;
+        reap(socket, false, &completions);
+    }
+    while (completions.Done < sends) {
+        reap(socket, true, &completions);
+    }
+    auto stop = steady_clock::now();
+
+    Result result;
+    result.Seconds = duration_cast<duration<double>>(stop - start).count();
+    result.CPUSeconds = threadCPUSeconds() - cpu;
+    result.Completions = completions.Done;
+    result.Copied = completions.Copied;
+    return result;
+}
+
+static Result bench(const std::string& host, uint16_t port, size_t size, size_t total, bool zeroCopy) {
+    std::shared_ptr<TCPSocket> socket;
+    error err = ConnectTCP(host, port, kConnTimeout, &socket);
+    if (err != error::nil) {
+        fail("connect", err);
+    }
+    if (zeroCopy) {
+        err = socket->SetZeroCopy(true);
+        if (err != error::nil) {
+            fail("SO_ZEROCOPY", err);
+        }
+    }
+    Result result = send(socket, size, total, zeroCopy);
+    socket->Close();
+    return result;
+}
+
+// Discards everything received on each connection.
+static void sink(const std::shared_ptr<TCPListener>& listener) {
+    while (true) {
+        std::shared_ptr<TCPSocket> socket;
+        if (listener->Accept(&socket) != error::nil) {
+            return;
+        }
+        std::vector<char> buf(1024 * 1024);
+        int nbytes;
+        while (socket->Read(buf.data(), buf.size(), &nbytes) == error::nil) {}
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t totalMB = (argc > 1) ? (size_t) atoi(argv[1]) : 256;
+    std::string host = (argc > 2) ? argv[2] : "127.0.0.1"; // a remote discard server, e.g. nc -l > /dev/null
+    uint16_t port = (argc > 3) ? (uint16_t) atoi(argv[3]) : 0;
+    size_t total = totalMB * 1024 * 1024;
+
+    std::shared_ptr<TCPListener> listener;
+    std::thread server;
+    if (argc <= 2) {
+        ListenTCP(0, &listener);
+        LookupPort(listener->FD(), &port);
+        server = std::thread([=]() {
+            sink(listener);
+        });
+    }
+
+    printf("send %zu MB to %s:%u\n", totalMB, host.c_str(), port);
+    if (host == "127.0.0.1") {
+        printf("note: the kernel copies zero-copy sends over loopback, so savings show on a real NIC only\n");
+    }
+    printf("%10s %14s %14s %8s %8s\n", "size", "copy us/MB", "zerocopy us/MB", "saving", "copied");
+    const size_t sizes[] = {4 * 1024, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    for (size_t size : sizes) {
+        Result copy = bench(host, port, size, total, false);
+        Result zeroCopy = bench(host, port, size, total, true);
+        double copyCPU = copy.CPUSeconds / totalMB * 1e6;
+        double zeroCopyCPU = zeroCopy.CPUSeconds / totalMB * 1e6;
+        printf("%10zu %14.1f %14.1f %7.1f%% %7.1f%%\n", size, copyCPU, zeroCopyCPU,
+                (1 - zeroCopyCPU / copyCPU) * 100,
+                zeroCopy.Completions > 0 ? 100.0 * zeroCopy.Copied / zeroCopy.Completions : 0.0);
+    }
+
+    if (listener != nullptr) {
+        listener->Shutdown(); // wakes up Accept, which must not run on a closed listener
+        server.join();
+        listener->Close();
+    }
+    return 0;
+}
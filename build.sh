@@ -21,6 +21,7 @@ if [ $debug ] ; then
     cmake -DCMAKE_BUILD_TYPE=Debug \
         -Dbuild_tests=ON \
         -Dbuild_examples=ON \
+        -Dbuild_benchmarks=ON \
         $@ \
         ..
 else
@@ -58,3 +58,22 @@ macro(project_add_example)
         target_link_libraries(${example} ${example_libraries})
     endforeach()
 endmacro(project_add_example)
+
+# project_add_benchmark([DEPENDS [depends1 [depends2 ...]]]
+#                       benchmark_name1 [benchmark_name2 ...])
+macro(project_add_benchmark)
+    set(options "")
+    set(oneValueArgs "")
+    set(multiValueArgs DEPENDS)
+    cmake_parse_arguments(arg "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+
+    set(benchmark_libraries ${arg_DEPENDS}
+        ${PROJECT_NAME}_static
+    )
+    foreach(benchmark_path IN LISTS arg_UNPARSED_ARGUMENTS)
+        string(REPLACE "/" "_" benchmark_name ${benchmark_path})
+        set(benchmark ${benchmark_name})
+        add_executable(${benchmark} ${benchmark_path}.cpp)
+        target_link_libraries(${benchmark} ${benchmark_libraries})
+    endforeach()
+endmacro(project_add_benchmark)
@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
+#include "netlib/bufio.h"
 #include "netlib/ssl.h"
 
 using namespace net;
@@ -40,9 +41,10 @@ int main(int argc, char** argv) {
     }
     // recv response
     {
+        BufferedReader reader(socket);
         char buf[256];
         while (true) {
-            error err = socket->ReadLine(buf, sizeof(buf));
+            error err = reader.ReadLine(buf, sizeof(buf));
             if (err == error::eof) {
                 break;
             }
@@ -5,6 +5,7 @@
 #include <thread>
 #include "netlib/resolver.h"
 #include "netlib/tcp.h"
+#include "netlib/tcp_server.h"
 
 using namespace net;
 
@@ -49,21 +50,22 @@ int main(int argc, char** argv) {
     uint16_t localPort = 0;
     LookupPort(listener->FD(), &localPort);
     printf("Listening on port %d\n", localPort);
-    for (;;) {
-        std::shared_ptr<TCPSocket> socket;
-        error err = listener->Accept(&socket);
-        if (err != error::nil) {
-            printf("%s\n", error::Message(err));
-            continue;
-        }
+
+    TCPServerConfig config = {};
+    std::shared_ptr<TCPServer> server;
+    err = NewTCPServer(listener, config, [](const std::shared_ptr<TCPSocket>& socket) {
         socket->SetKeepAlive(true);
         socket->SetKeepAlivePeriod(kKeepAlivePeriod);
-
-        std::thread th([=]() {
-            handle(socket);
-        });
-        th.detach();
+        handle(socket);
+    }, &server);
+    if (err != error::nil) {
+        printf("%s\n", error::Message(err));
+        return 1;
+    }
+    err = server->Serve();
+    if (err != error::nil) {
+        printf("%s\n", error::Message(err));
     }
-    listener->Close();
+    server->Close();
     return 0;
 }
@@ -0,0 +1,230 @@
+#include "netlib/async.h"
+#include <cassert>
+#include <cerrno>
+#include "netlib/internal/init.h"
+
+namespace net {
+
+AsyncStream::~AsyncStream() {
+    Close();
+}
+
+error AsyncStream::Close() {
+    if (m_closed.exchange(true)) {
+        return error::nil;
+    }
+
+    if (!m_loop->IsClosed()) {
+        m_loop->Remove(m_fd); // error::not_found if the loop has dropped the fd
+    }
+    abortAll(error::wrap(etype::os, ECANCELED));
+    return m_stream->Close();
+}
+
+error AsyncStream::AsyncRead(char* buf, size_t len, const AsyncCallback& callback) {
+    return start(Op{false, buf, len, false, 0, callback});
+}
+
+error AsyncStream::AsyncReadFull(char* buf, size_t len, const AsyncCallback& callback) {
+    return start(Op{false, buf, len, true, 0, callback});
+}
+
+error AsyncStream::AsyncWrite(const char* buf, size_t len, const AsyncCallback& callback) {
+    return start(Op{true, const_cast<char*>(buf), len, false, 0, callback});
+}
+
+error AsyncStream::AsyncWriteFull(const char* buf, size_t len, const AsyncCallback& callback) {
+    return start(Op{true, const_cast<char*>(buf), len, true, 0, callback});
+}
+
+error AsyncStream::start(const Op& op) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (op.Buf == nullptr && op.Len > 0) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (!op.Callback) {
+        assert(0 && "callback must not be empty");
+        return error::illegal_argument;
+    }
+
+    if (m_loop->IsInLoopThread()) {
+        enqueue(op);
+        return error::nil;
+    }
+    std::shared_ptr<AsyncStream> self = shared_from_this();
+    m_loop->Post([self, op]() {
+        if (self->m_closed) {
+            op.Callback(error::wrap(etype::os, ECANCELED), 0);
+            return;
+        }
+        self->enqueue(op);
+    });
+    return error::nil;
+}
+
+void AsyncStream::enqueue(const Op& op) {
+    std::deque<Op>* ops = op.Write ? &m_writes : &m_reads;
+    if (!ops->empty()) { // keep the order; tried when the earlier ones have completed
+        ops->push_back(op);
+        return;
+    }
+
+    Op first = op;
+    if (attempt(&first)) {
+        return;
+    }
+    if (m_hungUp != error::nil) { // no more events will come
+        first.Callback(m_hungUp, (int) first.Offset);
+        return;
+    }
+    ops->push_back(std::move(first));
+}
+
+bool AsyncStream::attempt(Op* op) {
+    while (true) {
+        if (op->Full && op->Offset >= op->Len) {
+            op->Callback(error::nil, (int) op->Offset);
+            return true;
+        }
+
+        int nbytes = 0;
+        error err = op->Write
+                ? m_stream->Write(&op->Buf[op->Offset], op->Len - op->Offset, &nbytes)
+                : m_stream->Read(&op->Buf[op->Offset], op->Len - op->Offset, &nbytes);
+        if (err == error::intr) {
+            continue;
+        }
+        if (err == error::wouldblock || err == error::again) {
+            return false;
+        }
+        if (err != error::nil) {
+            op->Callback(err, (int) op->Offset);
+            return true;
+        }
+        op->Offset += nbytes;
+        if (!op->Full) {
+            op->Callback(error::nil, (int) op->Offset);
+            return true;
+        }
+    }
+}
+
+void AsyncStream::drain(std::deque<Op>* ops) {
+    while (!ops->empty() && !m_closed) {
+        // take the op out, since its callback may start or abort other ops
+        Op op = std::move(ops->front());
+        ops->pop_front();
+        if (!attempt(&op)) {
+            ops->push_front(std::move(op)); // no callback has been called
+            return;
+        }
+    }
+}
+
+void AsyncStream::abortAll(const error& err) {
+    std::deque<Op> reads;
+    std::deque<Op> writes;
+    reads.swap(m_reads);
+    writes.swap(m_writes);
+    for (auto& op : reads) {
+        op.Callback(err, (int) op.Offset);
+    }
+    for (auto& op : writes) {
+        op.Callback(err, (int) op.Offset);
+    }
+}
+
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const SocketFD& fd,
+        const std::shared_ptr<ReadWriteCloser>& stream, std::shared_ptr<AsyncStream>* asyncStream) {
+    if (loop == nullptr) {
+        assert(0 && "loop must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (stream == nullptr) {
+        assert(0 && "stream must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (asyncStream == nullptr) {
+        assert(0 && "asyncStream must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    std::shared_ptr<AsyncStream> s = std::make_shared<AsyncStream>(loop, fd, stream);
+    std::weak_ptr<AsyncStream> weak = s;
+    // an SSL record may wait for either direction, so that both queues are tried on any event
+    auto onReady = [weak]() {
+        std::shared_ptr<AsyncStream> self = weak.lock();
+        if (self == nullptr) {
+            return;
+        }
+        self->drain(&self->m_reads);
+        self->drain(&self->m_writes);
+    };
+    EventHandler handler;
+    handler.OnReadable = onReady;
+    handler.OnWritable = onReady;
+    handler.OnClosed = [weak](const error& err) {
+        std::shared_ptr<AsyncStream> self = weak.lock();
+        if (self == nullptr) {
+            return;
+        }
+        // the data which has arrived before the hangup can still be read
+        self->drain(&self->m_reads);
+        self->drain(&self->m_writes);
+        self->m_hungUp = (err != error::nil) ? err : error::eof;
+        self->abortAll(self->m_hungUp);
+    };
+    error err = loop->Add(fd, handler);
+    if (err != error::nil) {
+        s->m_closed = true; // the stream is left open to the caller
+        return err;
+    }
+    *asyncStream = std::move(s);
+    return error::nil;
+}
+
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& sock,
+        std::shared_ptr<AsyncStream>* asyncStream) {
+    if (sock == nullptr) {
+        assert(0 && "sock must not be nullptr");
+        return error::illegal_argument;
+    }
+    error err = sock->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+    return NewAsyncStream(loop, sock->FD(), sock, asyncStream);
+}
+
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<UDPSocket>& sock,
+        std::shared_ptr<AsyncStream>* asyncStream) {
+    if (sock == nullptr) {
+        assert(0 && "sock must not be nullptr");
+        return error::illegal_argument;
+    }
+    error err = sock->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+    return NewAsyncStream(loop, sock->FD(), sock, asyncStream);
+}
+
+std::future<AsyncResult> MakeFuture(const std::function<error(const AsyncCallback& callback)>& op) {
+    std::shared_ptr<std::promise<AsyncResult>> promise = std::make_shared<std::promise<AsyncResult>>();
+    std::future<AsyncResult> future = promise->get_future();
+    error err = op([promise](const error& err, int nbytes) {
+        promise->set_value(AsyncResult{err, nbytes});
+    });
+    if (err != error::nil) {
+        promise->set_value(AsyncResult{err, 0});
+    }
+    return future;
+}
+
+} // namespace net
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include "netlib/error.h"
+#include "netlib/event_loop.h"
+#include "netlib/fd.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+#include "netlib/udp.h"
+
+namespace net {
+
+/**
+ * Called with the number of bytes transferred. For AsyncReadFull and AsyncWriteFull,
+ * nbytes is the number of bytes transferred before the error if err is not error::nil.
+ */
+using AsyncCallback = std::function<void(const error& err, int nbytes)>;
+
+struct AsyncResult {
+    error Err;
+    int NBytes;
+};
+
+/**
+ * Reads and writes a non-blocking stream with completion callbacks on an EventLoop.
+ * An operation is tried at once, and is retried on readiness events of the fd
+ * until it completes, so that no thread is blocked per operation.
+ * Reads and writes are each completed in the order they are started.
+ *
+ * Operations may be started from any thread, while callbacks are always called
+ * on the loop thread. Close must be called on the loop thread,
+ * and so the last reference must be released there while operations are pending.
+ */
+class AsyncStream final : public Closer, public std::enable_shared_from_this<AsyncStream> {
+public:
+    AsyncStream(const std::shared_ptr<EventLoop>& loop, const SocketFD& fd, const std::shared_ptr<ReadWriteCloser>& stream)
+            : m_loop(loop), m_fd(fd), m_stream(stream), m_closed(false), m_hungUp(error::nil) {}
+    ~AsyncStream();
+    AsyncStream(const AsyncStream&) = delete;
+    AsyncStream& operator=(const AsyncStream&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Remove the fd from the loop, call the pending callbacks with ECANCELED,
+     * and close the stream.
+     */
+    error Close();
+    /**
+     * buf must be valid until callback is called.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback Called with error::eof if the peer has closed the connection
+     */
+    error AsyncRead(char* buf, size_t len, const AsyncCallback& callback);
+    /**
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback Called when len bytes have been read
+     */
+    error AsyncReadFull(char* buf, size_t len, const AsyncCallback& callback);
+    /**
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback
+     */
+    error AsyncWrite(const char* buf, size_t len, const AsyncCallback& callback);
+    /**
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback Called when len bytes have been written
+     */
+    error AsyncWriteFull(const char* buf, size_t len, const AsyncCallback& callback);
+    SocketFD FD() { return m_fd; }
+
+private:
+    friend error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const SocketFD& fd,
+            const std::shared_ptr<ReadWriteCloser>& stream, std::shared_ptr<AsyncStream>* asyncStream);
+
+    struct Op {
+        bool Write;
+        char* Buf;
+        size_t Len;
+        bool Full;
+        size_t Offset;
+        AsyncCallback Callback;
+    };
+
+    const std::shared_ptr<EventLoop> m_loop;
+    const SocketFD m_fd;
+    const std::shared_ptr<ReadWriteCloser> m_stream;
+    std::atomic<bool> m_closed;
+    error m_hungUp; // set when the loop has dropped the fd
+    std::deque<Op> m_reads;
+    std::deque<Op> m_writes;
+
+    error start(const Op& op);
+    void enqueue(const Op& op);
+    bool attempt(Op* op);
+    void drain(std::deque<Op>* ops);
+    void abortAll(const error& err);
+};
+
+/**
+ * Register stream to loop. fd must already be in non-blocking mode;
+ * the overloads below switch the sockets themselves.
+ * For an SSLSocket, call SetNonBlocking(true) on it and pass its FD.
+ *
+ * @param[in] loop
+ * @param[in] fd The fd underlying stream
+ * @param[in] stream
+ * @param[out] asyncStream
+ */
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const SocketFD& fd,
+        const std::shared_ptr<ReadWriteCloser>& stream, std::shared_ptr<AsyncStream>* asyncStream);
+
+/**
+ * @param[in] loop
+ * @param[in] sock
+ * @param[out] asyncStream
+ */
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& sock,
+        std::shared_ptr<AsyncStream>* asyncStream);
+
+/**
+ * Read and Write of sock exchange datagrams with the address which sock has been connected to.
+ *
+ * @param[in] loop
+ * @param[in] sock
+ * @param[out] asyncStream
+ */
+error NewAsyncStream(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<UDPSocket>& sock,
+        std::shared_ptr<AsyncStream>* asyncStream);
+
+/**
+ * Adapt an operation with a completion callback to a future, e.g.
+ * MakeFuture([&](const AsyncCallback& cb) { return stream->AsyncRead(buf, len, cb); }).
+ * If the operation cannot be started, the future is ready with its error.
+ * Never wait for the future on the loop thread, which deadlocks.
+ *
+ * @param[in] op Start the operation with the given callback
+ */
+std::future<AsyncResult> MakeFuture(const std::function<error(const AsyncCallback& callback)>& op);
+
+} // namespace net
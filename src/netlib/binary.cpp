@@ -2,6 +2,7 @@
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
+#include "netlib/iobuf.h"
 
 namespace net {
 
@@ -66,6 +67,19 @@ void ByteBuffer::Get(unsigned char* dst, size_t len) {
     m_offset += len;
 }
 
+void ByteBuffer::Get(IOBuf* dst, size_t len) {
+    if (dst == nullptr) {
+        assert(0 && "dst must not be nullptr");
+        return;
+    }
+    if (isOutOfRange(len)) {
+        assert(0 && "Buffer overflow");
+        return;
+    }
+    dst->Append(&m_buf[m_offset], len);
+    m_offset += len;
+}
+
 bool ByteBuffer::GetBool() {
     int8_t i = GetInt8();
     return i ? true : false;
@@ -233,6 +247,14 @@ void ByteBuffer::Put(const unsigned char* dst, size_t len) {
     m_offset += len;
 }
 
+void ByteBuffer::Put(const IOBuf& src) {
+    if (isOutOfRange(src.Length())) {
+        assert(0 && "Buffer overflow");
+        return;
+    }
+    m_offset += src.CopyTo(0, &m_buf[m_offset], src.Length());
+}
+
 void ByteBuffer::PutBool(bool value) {
     int8_t i = value ? 1 : 0;
     PutInt8(i);
@@ -5,6 +5,8 @@
 
 namespace net {
 
+class IOBuf;
+
 enum struct ByteOrder {
     BigEndian,
     LittleEndian,
@@ -21,6 +23,10 @@ public:
 
     void     Get(char* dst, size_t len);
     void     Get(unsigned char* dst, size_t len);
+    /**
+     * Append the next len bytes to dst.
+     */
+    void     Get(IOBuf* dst, size_t len);
     bool     GetBool();
     int8_t   GetInt8();
     int16_t  GetInt16();
@@ -35,6 +41,10 @@ public:
 
     void Put(const char* dst, size_t len);
     void Put(const unsigned char* dst, size_t len);
+    /**
+     * Copy all of the bytes of src across its segments.
+     */
+    void Put(const IOBuf& src);
     void PutBool(bool value);
     void PutInt8(int8_t value);
     void PutInt16(int16_t value);
@@ -0,0 +1,297 @@
+#include "netlib/bufio.h"
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+namespace net {
+
+BufferedReader::BufferedReader(const std::shared_ptr<Reader>& reader, size_t size)
+        : m_reader(reader), m_buf(size > 0 ? size : kDefaultSize), m_start(0), m_end(0) {
+    assert(reader != nullptr && "reader must not be nullptr");
+}
+
+error BufferedReader::fill() {
+    if (m_start == m_end) {
+        m_start = m_end = 0;
+    } else if (m_end == m_buf.size() && m_start > 0) { // slide the buffered bytes to the front
+        memmove(m_buf.data(), m_buf.data() + m_start, m_end - m_start);
+        m_end -= m_start;
+        m_start = 0;
+    }
+    if (m_end == m_buf.size()) {
+        return error::nil; // full
+    }
+
+    int n = 0;
+    error err = m_reader->Read(m_buf.data() + m_end, m_buf.size() - m_end, &n);
+    if (err != error::nil) {
+        return err;
+    }
+    m_end += n;
+    return error::nil;
+}
+
+error BufferedReader::Read(char* buf, size_t len, int* nbytes) {
+    if (buf == nullptr) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    if (m_start == m_end) {
+        if (len >= m_buf.size()) { // spare the copy
+            return m_reader->Read(buf, len, nbytes);
+        }
+        error err = fill();
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    size_t n = (len < m_end - m_start) ? len : m_end - m_start;
+    memcpy(buf, m_buf.data() + m_start, n);
+    m_start += n;
+    if (nbytes != nullptr) {
+        *nbytes = (int) n;
+    }
+    return error::nil;
+}
+
+error BufferedReader::ReadFull(char* buf, size_t len, size_t* nbytes) {
+    if (buf == nullptr) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    size_t offset = (len < m_end - m_start) ? len : m_end - m_start;
+    memcpy(buf, m_buf.data() + m_start, offset);
+    m_start += offset;
+
+    error err = error::nil;
+    while (offset < len) {
+        int n = 0;
+        err = Read(&buf[offset], len - offset, &n);
+        if (err != error::nil) {
+            break;
+        }
+        offset += n;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = offset;
+    }
+    return err;
+}
+
+error BufferedReader::ReadLine(char* buf, size_t len) {
+    if (buf == nullptr) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (len == 0) {
+        assert(0 && "len must not be 0");
+        return error::illegal_argument;
+    }
+
+    size_t offset = 0;
+    while (true) {
+        size_t room = len - 1 - offset;
+        size_t avail = (room < m_end - m_start) ? room : m_end - m_start;
+        const char* begin = m_buf.data() + m_start;
+        const char* found = (const char*) memchr(begin, '\n', avail);
+        size_t n = (found != nullptr) ? (size_t) (found - begin) + 1 : avail;
+        memcpy(&buf[offset], begin, n);
+        m_start += n;
+        offset += n;
+        if (found != nullptr || offset + 1 >= len) { // the line end, or buf is full
+            buf[offset] = '\0';
+            return error::nil;
+        }
+
+        error err = fill();
+        if (err != error::nil) {
+            return err;
+        }
+    }
+}
+
+error BufferedReader::ReadUntil(char delim, std::string* data) {
+    if (data == nullptr) {
+        assert(0 && "data must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    data->clear();
+    while (true) {
+        const char* begin = m_buf.data() + m_start;
+        const char* found = (const char*) memchr(begin, delim, m_end - m_start);
+        size_t n = (found != nullptr) ? (size_t) (found - begin) + 1 : m_end - m_start;
+        data->append(begin, n);
+        m_start += n;
+        if (found != nullptr) {
+            return error::nil;
+        }
+
+        error err = fill();
+        if (err != error::nil) {
+            return err;
+        }
+    }
+}
+
+error BufferedReader::Peek(size_t len, const char** data) {
+    if (data == nullptr) {
+        assert(0 && "data must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (len > m_buf.size()) {
+        assert(0 && "len must not exceed the size of the buffer");
+        return error::illegal_argument;
+    }
+
+    while (m_end - m_start < len) {
+        error err = fill();
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    *data = m_buf.data() + m_start;
+    return error::nil;
+}
+
+error BufferedReader::Discard(size_t len, size_t* discarded) {
+    size_t offset = 0;
+    error err = error::nil;
+    while (true) {
+        size_t n = (len - offset < m_end - m_start) ? len - offset : m_end - m_start;
+        m_start += n;
+        offset += n;
+        if (offset >= len) {
+            break;
+        }
+        err = fill();
+        if (err != error::nil) {
+            break;
+        }
+    }
+    if (discarded != nullptr) {
+        *discarded = offset;
+    }
+    return err;
+}
+
+static int64_t monotonicMilliseconds() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+BufferedWriter::BufferedWriter(const std::shared_ptr<Writer>& writer, const BufferedWriterConfig& config)
+        : m_writer(writer),
+          m_cork(config.Cork ? std::dynamic_pointer_cast<TCPSocket>(writer) : nullptr),
+          m_maxDelay(config.MaxDelayMilliseconds),
+          m_buf(config.Size > 0 ? config.Size : kDefaultSize),
+          m_len(0),
+          m_bufferedAt(0),
+          m_corked(false) {
+    assert(writer != nullptr && "writer must not be nullptr");
+}
+
+error BufferedWriter::Write(const char* buf, size_t len, int* nbytes) {
+    if (buf == nullptr) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    // once bytes have been accepted, a failure to write them is left to the next Write or Flush,
+    // since a caller which sees an error retries the bytes which it has not been told are accepted
+    if (m_len + len > m_buf.size()) {
+        if (len >= m_buf.size()) { // spare the copy, and send both with a single call
+            size_t written = 0;
+            error err = writeThrough(buf, len, &written);
+            if (nbytes != nullptr) {
+                *nbytes = (int) written;
+            }
+            return (written > 0) ? error::nil : err;
+        }
+        error err = flush(false);
+        if (err != error::nil) {
+            if (nbytes != nullptr) {
+                *nbytes = 0;
+            }
+            return err;
+        }
+    }
+
+    if (m_len == 0) {
+        m_bufferedAt = monotonicMilliseconds();
+    }
+    memcpy(m_buf.data() + m_len, buf, len);
+    m_len += len;
+    if (nbytes != nullptr) {
+        *nbytes = (int) len;
+    }
+    if (m_len == m_buf.size()) {
+        flush(false);
+    } else {
+        FlushIfExpired();
+    }
+    return error::nil;
+}
+
+error BufferedWriter::Flush() {
+    return flush(true);
+}
+
+error BufferedWriter::FlushIfExpired() {
+    if (m_maxDelay <= 0 || m_len == 0) {
+        return error::nil;
+    }
+    if (monotonicMilliseconds() - m_bufferedAt < m_maxDelay) {
+        return error::nil;
+    }
+    return flush(true);
+}
+
+error BufferedWriter::flush(bool push) {
+    error err = error::nil;
+    if (m_len > 0) {
+        cork(!push);
+        size_t n = 0;
+        err = m_writer->WriteFull(m_buf.data(), m_len, &n);
+        consume(n);
+    }
+    if (push && err == error::nil) {
+        cork(false);
+    }
+    return err;
+}
+
+error BufferedWriter::writeThrough(const char* buf, size_t len, size_t* written) {
+    cork(true);
+    IOVec iov[2] = {{m_buf.data(), m_len}, {const_cast<char*>(buf), len}};
+    size_t n = 0;
+    error err = m_writer->WriteFullV(iov, 2, &n);
+    if (n >= m_len) {
+        *written = n - m_len;
+        m_len = 0;
+    } else {
+        *written = 0;
+        consume(n);
+    }
+    return err;
+}
+
+void BufferedWriter::consume(size_t n) {
+    memmove(m_buf.data(), m_buf.data() + n, m_len - n);
+    m_len -= n;
+}
+
+void BufferedWriter::cork(bool on) {
+    if (m_cork == nullptr || m_corked == on) {
+        return;
+    }
+    if (m_cork->SetCork(on) != error::nil) { // a hint only, so write uncorked
+        m_cork = nullptr;
+        return;
+    }
+    m_corked = on;
+}
+
+} // namespace net
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "netlib/error.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+
+namespace net {
+
+/**
+ * A Reader which reads its source in bulk into a buffer, and serves small reads from the buffer.
+ * Each fill of the buffer costs a single Read of the source.
+ * Not thread-safe.
+ */
+class BufferedReader final : public Reader {
+public:
+    static const size_t kDefaultSize = 4096;
+
+    /**
+     * @param[in] reader The source
+     * @param[in] size The size of the buffer. kDefaultSize if 0 is specified.
+     */
+    explicit BufferedReader(const std::shared_ptr<Reader>& reader, size_t size = kDefaultSize);
+    BufferedReader(const BufferedReader&) = delete;
+    BufferedReader& operator=(const BufferedReader&) = delete;
+
+    /**
+     * Read from the buffer, which is filled first if empty.
+     * A read as large as the buffer goes to the source directly when the buffer is empty.
+     */
+    error Read(char* buf, size_t len, int* nbytes);
+    using Reader::ReadFull;
+    /**
+     * Copy the buffered bytes, and read the rest from the source directly into buf.
+     */
+    error ReadFull(char* buf, size_t len, size_t* nbytes);
+    error ReadLine(char* buf, size_t len);
+    /**
+     * Read until the first occurrence of delim.
+     *
+     * @param[in] delim
+     * @param[out] data The bytes read including delim.
+     *                  The bytes read before an error, e.g. error::eof, are stored as well.
+     */
+    error ReadUntil(char delim, std::string* data);
+    /**
+     * Return the next len bytes without consuming them.
+     *
+     * @param[in] len Must not exceed the size of the buffer
+     * @param[out] data Valid until the next call to this reader
+     */
+    error Peek(size_t len, const char** data);
+    /**
+     * Skip the next len bytes.
+     *
+     * @param[in] len
+     * @param[out] discarded The number of bytes skipped even if an error is returned
+     */
+    error Discard(size_t len, size_t* discarded);
+    /**
+     * @return the number of bytes which can be read without reading the source
+     */
+    size_t Buffered() { return m_end - m_start; }
+
+private:
+    std::shared_ptr<Reader> m_reader;
+    std::vector<char> m_buf;
+    size_t m_start; // the next byte to be read
+    size_t m_end;   // the end of the buffered bytes
+
+    error fill();
+};
+
+struct BufferedWriterConfig {
+    /** The size of the buffer. 4096 if 0 is specified. */
+    size_t Size;
+    /**
+     * Flush the buffer once its oldest byte has waited this long.
+     * Checked by Write and FlushIfExpired. Never if 0 is specified.
+     */
+    int64_t MaxDelayMilliseconds;
+    /**
+     * Keep a TCPSocket corked between explicit flushes, so that the tail of
+     * a full buffer waits for the next one instead of going out as a small segment.
+     * Ignored for the other writers.
+     */
+    bool Cork;
+};
+
+/**
+ * A Writer which gathers small writes into a buffer, and writes them to its destination at once.
+ * A write which does not fit into the buffer is sent together with the buffered bytes
+ * in a single WriteV. The buffer is flushed when it is full, when Flush is called,
+ * or when MaxDelayMilliseconds has elapsed.
+ * Unflushed bytes are dropped on destruction. Not thread-safe.
+ */
+class BufferedWriter final : public Writer {
+public:
+    static const size_t kDefaultSize = 4096;
+
+    /**
+     * @param[in] writer The destination
+     * @param[in] config
+     */
+    BufferedWriter(const std::shared_ptr<Writer>& writer, const BufferedWriterConfig& config);
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    /**
+     * Buffer the bytes, and write the buffer if it is full.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[out] nbytes The number of bytes accepted
+     * @return an error only if no byte has been accepted, e.g. error::wouldblock in non-blocking mode.
+     *         A failure to write the accepted bytes is returned by a later Write or by Flush.
+     */
+    error Write(const char* buf, size_t len, int* nbytes);
+    /**
+     * Write the buffered bytes, and uncork the destination.
+     * The bytes which could not be written are kept.
+     */
+    error Flush();
+    /**
+     * Flush if MaxDelayMilliseconds has elapsed since the oldest byte was buffered.
+     * Call this from a timer, e.g. EventLoop::RunAfter, so that a quiet writer is flushed as well.
+     */
+    error FlushIfExpired();
+    /**
+     * @return the number of bytes waiting for Flush
+     */
+    size_t Buffered() { return m_len; }
+
+private:
+    std::shared_ptr<Writer> m_writer;
+    std::shared_ptr<TCPSocket> m_cork; // the destination to be corked
+    const int64_t m_maxDelay;
+    std::vector<char> m_buf;
+    size_t m_len;
+    int64_t m_bufferedAt; // when the oldest buffered byte was written
+    bool m_corked;
+
+    error flush(bool push);
+    error writeThrough(const char* buf, size_t len, size_t* written);
+    void consume(size_t n);
+    void cork(bool on);
+};
+
+} // namespace net
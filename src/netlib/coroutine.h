@@ -0,0 +1,384 @@
+#pragma once
+
+// C++20 coroutine front end of IOEngine.
+// Include this header only from translation units compiled as C++20 or later.
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include "netlib/error.h"
+#include "netlib/io_engine.h"
+#include "netlib/resolver.h"
+#include "netlib/tcp.h"
+#include "netlib/udp.h"
+
+namespace net {
+
+/**
+ * A lazily started coroutine which returns T.
+ * It runs when it is awaited, and resumes the awaiting coroutine when it finishes.
+ * Exceptions are not supported; an unhandled exception terminates the program.
+ */
+template <typename T = void>
+class Task;
+
+namespace internal {
+
+template <typename T>
+struct TaskPromiseBase {
+    std::coroutine_handle<> Continuation;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().Continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : public TaskPromiseBase<T> {
+    T Value;
+
+    Task<T> get_return_object() noexcept;
+    void return_value(T value) { Value = std::move(value); }
+    T result() { return std::move(Value); }
+};
+
+template <>
+struct TaskPromise<void> : public TaskPromiseBase<void> {
+    Task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void result() noexcept {}
+};
+
+/** Runs a task to the end without anybody awaiting it, and destroys itself. */
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/**
+ * Awaits an IOEngine operation. start is called with a completion callback
+ * taking an error, and returns the error of starting the operation.
+ */
+template <typename Start>
+class CompletionAwaiter {
+public:
+    explicit CompletionAwaiter(Start start) : m_start(std::move(start)), m_err(error::nil) {}
+
+    bool await_ready() noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // IOEngine never completes an operation before the engine runs,
+        // so the callback cannot be called before this returns
+        m_err = m_start([this, handle](const error& err) {
+            m_err = err;
+            handle.resume();
+        });
+        return m_err == error::nil; // resume at once if the operation could not be started
+    }
+    error await_resume() noexcept { return m_err; }
+
+private:
+    Start m_start;
+    error m_err;
+};
+
+template <typename Start>
+CompletionAwaiter<Start> makeAwaiter(Start start) {
+    return CompletionAwaiter<Start>(std::move(start));
+}
+
+} // namespace internal
+
+template <typename T>
+class Task final {
+public:
+    using promise_type = internal::TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        m_handle.promise().Continuation = continuation;
+        return m_handle;
+    }
+    T await_resume() { return m_handle.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace internal {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+inline Detached runDetached(Task<void> task) {
+    co_await task;
+}
+
+} // namespace internal
+
+/**
+ * Start task on the calling thread, and let it run to the end on its own.
+ * Call this on the thread running the engine which task awaits.
+ *
+ * @param[in] task
+ */
+inline void Spawn(Task<void> task) {
+    internal::runDetached(std::move(task));
+}
+
+/**
+ * @param[in] engine
+ * @param[in] listener
+ * @param[out] sock
+ */
+inline auto AsyncAccept(IOEngine& engine, TCPListener& listener, std::shared_ptr<TCPSocket>* sock) {
+    SocketFD fd = listener.FD();
+    return internal::makeAwaiter([&engine, fd, sock](auto done) {
+        return engine.Accept(fd, [sock, done](const error& err, const std::shared_ptr<TCPSocket>& accepted) {
+            if (sock != nullptr) {
+                *sock = accepted;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * Connect to an IPv4 address. Use AsyncConnectTCP to connect to a hostname.
+ *
+ * @param[in] engine
+ * @param[in] addr An IPv4 address
+ * @param[in] port
+ * @param[out] sock
+ */
+inline auto AsyncConnectAddress(IOEngine& engine, const std::string& addr, uint16_t port,
+        std::shared_ptr<TCPSocket>* sock) {
+    return internal::makeAwaiter([&engine, addr, port, sock](auto done) {
+        return engine.Connect(addr, port, [sock, done](const error& err, const std::shared_ptr<TCPSocket>& connected) {
+            if (sock != nullptr) {
+                *sock = connected;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * host is resolved synchronously, which is immediate for an IPv4 address.
+ *
+ * @param[in] engine
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[out] sock
+ */
+inline Task<error> AsyncConnectTCP(IOEngine& engine, std::string host, uint16_t port,
+        std::shared_ptr<TCPSocket>* sock) {
+    std::string addr;
+    error err = LookupAddress(host, &addr);
+    if (err != error::nil) {
+        co_return err;
+    }
+    co_return co_await AsyncConnectAddress(engine, addr, port, sock);
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[out] nbytes
+ * @return error::eof if the peer has closed the connection
+ */
+inline auto AsyncRead(IOEngine& engine, TCPSocket& sock, char* buf, size_t len, int* nbytes) {
+    SocketFD fd = sock.FD();
+    return internal::makeAwaiter([&engine, fd, buf, len, nbytes](auto done) {
+        return engine.Recv(fd, buf, len, [nbytes, done](const error& err, int n) {
+            if (nbytes != nullptr) {
+                *nbytes = n;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[out] nbytes
+ */
+inline auto AsyncWrite(IOEngine& engine, TCPSocket& sock, const char* buf, size_t len, int* nbytes) {
+    SocketFD fd = sock.FD();
+    return internal::makeAwaiter([&engine, fd, buf, len, nbytes](auto done) {
+        return engine.Send(fd, buf, len, [nbytes, done](const error& err, int n) {
+            if (nbytes != nullptr) {
+                *nbytes = n;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ */
+inline Task<error> AsyncReadFull(IOEngine& engine, TCPSocket& sock, char* buf, size_t len) {
+    size_t offset = 0;
+    while (offset < len) {
+        int nbytes = 0;
+        error err = co_await AsyncRead(engine, sock, &buf[offset], len - offset, &nbytes);
+        if (err != error::nil) {
+            co_return err;
+        }
+        offset += nbytes;
+    }
+    co_return error::nil;
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ */
+inline Task<error> AsyncWriteFull(IOEngine& engine, TCPSocket& sock, const char* buf, size_t len) {
+    size_t offset = 0;
+    while (offset < len) {
+        int nbytes = 0;
+        error err = co_await AsyncWrite(engine, sock, &buf[offset], len - offset, &nbytes);
+        if (err != error::nil) {
+            co_return err;
+        }
+        offset += nbytes;
+    }
+    co_return error::nil;
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[out] nbytes
+ * @param[out] addr
+ * @param[out] port
+ */
+inline auto AsyncReadFrom(IOEngine& engine, UDPSocket& sock, char* buf, size_t len, int* nbytes,
+        std::string* addr, uint16_t* port) {
+    SocketFD fd = sock.FD();
+    return internal::makeAwaiter([&engine, fd, buf, len, nbytes, addr, port](auto done) {
+        return engine.RecvFrom(fd, buf, len, [nbytes, addr, port, done](const error& err, int n,
+                const std::string& from, uint16_t fromPort) {
+            if (nbytes != nullptr) {
+                *nbytes = n;
+            }
+            if (addr != nullptr) {
+                *addr = from;
+            }
+            if (port != nullptr) {
+                *port = fromPort;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[in] addr An IPv4 address
+ * @param[in] port
+ * @param[out] nbytes
+ */
+inline auto AsyncWriteTo(IOEngine& engine, UDPSocket& sock, const char* buf, size_t len,
+        const std::string& addr, uint16_t port, int* nbytes) {
+    SocketFD fd = sock.FD();
+    return internal::makeAwaiter([&engine, fd, buf, len, addr, port, nbytes](auto done) {
+        return engine.SendTo(fd, buf, len, addr, port, [nbytes, done](const error& err, int n) {
+            if (nbytes != nullptr) {
+                *nbytes = n;
+            }
+            done(err);
+        });
+    });
+}
+
+/**
+ * Receive a datagram from any sender.
+ *
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[out] nbytes
+ */
+inline auto AsyncRead(IOEngine& engine, UDPSocket& sock, char* buf, size_t len, int* nbytes) {
+    return AsyncReadFrom(engine, sock, buf, len, nbytes, nullptr, nullptr);
+}
+
+/**
+ * Send a datagram to the address which sock has been connected to.
+ *
+ * @param[in] engine
+ * @param[in] sock
+ * @param[in] buf
+ * @param[in] len
+ * @param[out] nbytes
+ */
+inline auto AsyncWrite(IOEngine& engine, UDPSocket& sock, const char* buf, size_t len, int* nbytes) {
+    return AsyncWriteTo(engine, sock, buf, len, sock.RemoteAddress(), sock.RemotePort(), nbytes);
+}
+
+} // namespace net
+
+#endif // __cplusplus >= 202002L && __has_include(<coroutine>)
@@ -0,0 +1,146 @@
+#include "netlib/endpoint.h"
+#include <cassert>
+#include <cstring>
+#if defined(_WIN32) || defined(_WIN64)
+ #include <winsock2.h>
+ #include <ws2tcpip.h>
+#else
+ #include <arpa/inet.h>
+ #include <netinet/in.h>
+ #include <sys/socket.h>
+#endif // defined(_WIN32) || defined(_WIN64)
+
+namespace net {
+
+Endpoint::Endpoint() : m_family(0), m_port(0), m_scopeID(0) {
+    memset(m_addr, 0, sizeof(m_addr));
+}
+
+error Endpoint::Parse(const std::string& addr, uint16_t port, Endpoint* endpoint) {
+    if (endpoint == nullptr) {
+        assert(0 && "endpoint must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    Endpoint ep;
+    if (inet_pton(AF_INET, addr.c_str(), ep.m_addr) == 1) {
+        ep.m_family = kIPv4;
+    } else if (inet_pton(AF_INET6, addr.c_str(), ep.m_addr) == 1) {
+        ep.m_family = kIPv6;
+    } else {
+        return error::illegal_argument;
+    }
+    ep.m_port = port;
+    *endpoint = ep;
+    return error::nil;
+}
+
+error Endpoint::FromSockAddr(const struct sockaddr* sa, size_t len, Endpoint* endpoint) {
+    if (sa == nullptr) {
+        assert(0 && "sa must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (endpoint == nullptr) {
+        assert(0 && "endpoint must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    Endpoint ep;
+    if (sa->sa_family == AF_INET && len >= sizeof(struct sockaddr_in)) {
+        const struct sockaddr_in* in4 = (const struct sockaddr_in*) sa;
+        ep.m_family = kIPv4;
+        ep.m_port = ntohs(in4->sin_port);
+        memcpy(ep.m_addr, &in4->sin_addr, sizeof(in4->sin_addr));
+    } else if (sa->sa_family == AF_INET6 && len >= sizeof(struct sockaddr_in6)) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*) sa;
+        ep.m_family = kIPv6;
+        ep.m_port = ntohs(in6->sin6_port);
+        ep.m_scopeID = in6->sin6_scope_id;
+        memcpy(ep.m_addr, &in6->sin6_addr, sizeof(in6->sin6_addr));
+    } else {
+        return error::afnosupport;
+    }
+    *endpoint = ep;
+    return error::nil;
+}
+
+size_t Endpoint::ToSockAddr(struct sockaddr_storage* ss) const {
+    if (ss == nullptr) {
+        assert(0 && "ss must not be nullptr");
+        return 0;
+    }
+
+    if (m_family == kIPv4) {
+        struct sockaddr_in* in4 = (struct sockaddr_in*) ss;
+        memset(in4, 0, sizeof(*in4));
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(m_port);
+        memcpy(&in4->sin_addr, m_addr, sizeof(in4->sin_addr));
+        return sizeof(*in4);
+    }
+    if (m_family == kIPv6) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*) ss;
+        memset(in6, 0, sizeof(*in6));
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(m_port);
+        in6->sin6_scope_id = m_scopeID;
+        memcpy(&in6->sin6_addr, m_addr, sizeof(in6->sin6_addr));
+        return sizeof(*in6);
+    }
+    return 0;
+}
+
+std::string Endpoint::Address() const {
+    char buf[INET6_ADDRSTRLEN] = {0};
+    if (m_family == kIPv4) {
+        inet_ntop(AF_INET, (void*) m_addr, buf, sizeof(buf));
+    } else if (m_family == kIPv6) {
+        inet_ntop(AF_INET6, (void*) m_addr, buf, sizeof(buf));
+    }
+    return buf;
+}
+
+std::string Endpoint::String() const {
+    if (m_family == kIPv6) {
+        return "[" + Address() + "]:" + std::to_string(m_port);
+    }
+    return Address() + ":" + std::to_string(m_port);
+}
+
+size_t Endpoint::Hash() const {
+    // FNV-1a over the fields which tell endpoints apart
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](uint8_t b) {
+        hash ^= b;
+        hash *= 1099511628211ULL;
+    };
+    mix(m_family);
+    mix((uint8_t) (m_port >> 8));
+    mix((uint8_t) m_port);
+    size_t len = (m_family == kIPv6) ? sizeof(m_addr) : 4;
+    for (size_t i = 0; i < len; i++) {
+        mix(m_addr[i]);
+    }
+    return (size_t) hash;
+}
+
+bool Endpoint::operator==(const Endpoint& other) const {
+    return m_family == other.m_family && m_port == other.m_port && m_scopeID == other.m_scopeID
+            && memcmp(m_addr, other.m_addr, sizeof(m_addr)) == 0;
+}
+
+bool Endpoint::operator<(const Endpoint& other) const {
+    if (m_family != other.m_family) {
+        return m_family < other.m_family;
+    }
+    int cmp = memcmp(m_addr, other.m_addr, sizeof(m_addr));
+    if (cmp != 0) {
+        return cmp < 0;
+    }
+    if (m_port != other.m_port) {
+        return m_port < other.m_port;
+    }
+    return m_scopeID < other.m_scopeID;
+}
+
+} // namespace net
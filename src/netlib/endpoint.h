@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "netlib/error.h"
+#include "netlib/fd.h"
+
+struct sockaddr;
+struct sockaddr_storage;
+
+namespace net {
+
+/**
+ * An IPv4 or IPv6 address and a port in binary form, which is copied, compared and hashed
+ * without allocations. Text is only parsed by Parse, and only formatted by Address and String.
+ */
+class Endpoint final {
+public:
+    /**
+     * An unspecified endpoint.
+     */
+    Endpoint();
+
+    /**
+     * @param[in] addr A numeric IPv4 or IPv6 address, which is not resolved
+     * @param[in] port
+     * @param[out] endpoint
+     * @return error::illegal_argument if addr is not numeric
+     */
+    static error Parse(const std::string& addr, uint16_t port, Endpoint* endpoint);
+    /**
+     * @param[in] sa An AF_INET or AF_INET6 address
+     * @param[in] len The length of sa
+     * @param[out] endpoint
+     * @return error::afnosupport for the other families
+     */
+    static error FromSockAddr(const struct sockaddr* sa, size_t len, Endpoint* endpoint);
+
+    /**
+     * @param[out] ss
+     * @return the length of the address written to ss, or 0 if unspecified
+     */
+    size_t ToSockAddr(struct sockaddr_storage* ss) const;
+
+    bool IsSpecified() const { return m_family != 0; }
+    bool IsIPv6() const { return m_family == kIPv6; }
+    uint16_t Port() const { return m_port; }
+    /**
+     * @return the address formatted, e.g. "127.0.0.1" or "::1"
+     */
+    std::string Address() const;
+    /**
+     * @return the address and the port formatted, e.g. "127.0.0.1:80" or "[::1]:80"
+     */
+    std::string String() const;
+    size_t Hash() const;
+
+    bool operator==(const Endpoint& other) const;
+    bool operator!=(const Endpoint& other) const { return !(*this == other); }
+    bool operator<(const Endpoint& other) const;
+
+private:
+    static const uint8_t kIPv4 = 4;
+    static const uint8_t kIPv6 = 6;
+
+    uint8_t m_family; // 0 if unspecified
+    uint16_t m_port;
+    uint32_t m_scopeID;
+    uint8_t m_addr[16]; // in network byte order; the first 4 bytes for IPv4
+};
+
+} // namespace net
+
+namespace std {
+
+template<>
+struct hash<net::Endpoint> {
+    size_t operator()(const net::Endpoint& endpoint) const { return endpoint.Hash(); }
+};
+
+} // namespace std
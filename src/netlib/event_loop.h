@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "netlib/error.h"
+#include "netlib/fd.h"
+#include "netlib/stream.h"
+#include "netlib/timer.h"
+
+namespace net {
+
+struct EventHandler {
+    /** Called when the fd becomes readable, or the peer has shut down its writing side. */
+    std::function<void()> OnReadable;
+    /** Called when the fd becomes writable. */
+    std::function<void()> OnWritable;
+    /**
+     * Called when the fd is hung up, an error is pending on it, or its deadline has expired (error::timedout).
+     * The fd has already been removed from the loop, but is not closed.
+     */
+    std::function<void(const error& err)> OnClosed;
+    /**
+     * Called instead of OnClosed when the fd reports an error without a hang-up or a pending socket error,
+     * which means messages are queued on its error queue, e.g. the completions of zero-copy sends.
+     * The handler should drain the queue, e.g. by TCPSocket::ReadZeroCopyCompletions.
+     * If not set, the fd is closed as before.
+     */
+    std::function<void()> OnErrorQueue;
+};
+
+/**
+ * A reactor which dispatches readiness events of many fds on a single thread.
+ * Fds are watched in edge-triggered mode, so a handler has to read or write
+ * until error::wouldblock is returned before it waits for the next event.
+ *
+ * Add, Remove, Post and Stop may be called from any thread,
+ * while handlers are always called on the thread running the loop.
+ * Timers and deadlines are managed only on the loop thread, or before the loop runs.
+ */
+class EventLoop final : public Closer {
+public:
+    EventLoop(const SocketFD& pollFD, const SocketFD& wakeupFD)
+            : m_pollFD(pollFD), m_wakeupFD(wakeupFD), m_closed(false), m_stopped(false), m_nextSeq(1),
+              m_loopThread(std::thread::id()), m_now(now()), m_timers(m_now) {}
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Release the loop. Registered fds are not closed.
+     */
+    error Close();
+    /**
+     * Register fd, which must already be in non-blocking mode,
+     * e.g. by SetNonBlocking(true) on the socket, which then keeps track of the mode.
+     *
+     * @param[in] fd
+     * @param[in] handler
+     */
+    error Add(const SocketFD& fd, const EventHandler& handler);
+    /**
+     * Unregister fd. Handlers of fd are never called after this returns
+     * on the loop thread.
+     *
+     * @param[in] fd
+     */
+    error Remove(const SocketFD& fd);
+    /**
+     * Wait for events once and dispatch them.
+     *
+     * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if a negative integer is specified.
+     */
+    error RunOnce(int64_t timeoutMilliseconds);
+    /**
+     * Dispatch events until Stop is called.
+     */
+    error Run();
+    /**
+     * @return an error if the loop could not be woken up
+     */
+    error Stop();
+    /**
+     * Run task on the loop thread.
+     *
+     * @param[in] task
+     * @return an error if the loop could not be woken up, in which case task runs on the next wakeup
+     */
+    error Post(const std::function<void()>& task);
+    /**
+     * @return true if called on the thread which runs the loop
+     */
+    bool IsInLoopThread() { return m_loopThread == std::this_thread::get_id(); }
+    /**
+     * Run task on the loop thread after delayMilliseconds.
+     *
+     * @param[in] delayMilliseconds
+     * @param[in] task
+     * @return the id of the timer
+     */
+    TimerID RunAfter(int64_t delayMilliseconds, const std::function<void()>& task);
+    /**
+     * @param[in] id
+     * @return false if the timer has already fired or been cancelled
+     */
+    bool CancelTimer(TimerID id);
+    /**
+     * Remove fd and call OnClosed with error::timedout when timeoutMilliseconds elapses,
+     * unless the deadline is reset before. A read, write or connect deadline is set
+     * before waiting for the corresponding event, and cleared once it has arrived.
+     *
+     * @param[in] fd
+     * @param[in] timeoutMilliseconds Clear the deadline if 0 or a negative integer is specified.
+     */
+    error SetDeadline(const SocketFD& fd, int64_t timeoutMilliseconds);
+    /**
+     * Same as SetDeadline, except that the deadline is pushed back
+     * whenever an event of fd is dispatched.
+     *
+     * @param[in] fd
+     * @param[in] timeoutMilliseconds Clear the timeout if 0 or a negative integer is specified.
+     */
+    error SetIdleTimeout(const SocketFD& fd, int64_t timeoutMilliseconds);
+    /**
+     * @return the number of registered fds
+     */
+    size_t Size();
+
+private:
+    struct Registration {
+        uint32_t Seq;
+        EventHandler Handler;
+        TimerID Deadline;
+        TimerID IdleTimer;
+        int64_t IdleTimeout;
+        int64_t LastActive;
+    };
+
+    const SocketFD m_pollFD;
+    const SocketFD m_wakeupFD;
+    std::atomic<bool> m_closed;
+    std::atomic<bool> m_stopped;
+    std::mutex m_mutex;
+    uint32_t m_nextSeq;
+    std::unordered_map<SocketFD, std::shared_ptr<Registration>> m_registrations;
+    std::vector<std::function<void()>> m_tasks;
+    std::atomic<std::thread::id> m_loopThread;
+    int64_t m_now; // the time when the loop has woken up last
+    TimerWheel m_timers;
+
+    static int64_t now();
+    std::shared_ptr<Registration> find(const SocketFD& fd, uint32_t seq);
+    error wakeup();
+    void runTasks();
+    void expire(const SocketFD& fd, uint32_t seq, bool idle);
+    void cancelTimers(Registration* reg);
+};
+
+/**
+ * @param[out] loop
+ */
+error NewEventLoop(std::shared_ptr<EventLoop>* loop);
+
+} // namespace net
@@ -0,0 +1,390 @@
+#include "netlib/event_loop.h"
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "netlib/internal/init.h"
+#include "netlib/internal/socket.h"
+
+namespace net {
+
+static const int kMaxEvents = 1024;
+static const uint64_t kWakeupToken = UINT64_MAX;
+
+static uint64_t toToken(const SocketFD& fd, uint32_t seq) {
+    return ((uint64_t) seq << 32) | (uint32_t) fd;
+}
+
+static error pendingError(const SocketFD& fd) {
+    int soErr = 0;
+    socklen_t optlen = sizeof(soErr);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &soErr, &optlen) == -1 || soErr == 0) {
+        return error::eof;
+    }
+    return error::wrap(etype::os, soErr);
+}
+
+error NewEventLoop(std::shared_ptr<EventLoop>* loop) {
+    if (loop == nullptr) {
+        assert(0 && "loop must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    int pollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (pollFD == -1) {
+        return error::wrap(etype::os, errno);
+    }
+
+    int wakeupFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupFD == -1) {
+        int err = errno;
+        close(pollFD);
+        return error::wrap(etype::os, err);
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeupToken;
+    if (epoll_ctl(pollFD, EPOLL_CTL_ADD, wakeupFD, &ev) == -1) {
+        int err = errno;
+        close(wakeupFD);
+        close(pollFD);
+        return error::wrap(etype::os, err);
+    }
+
+    *loop = std::make_shared<EventLoop>(pollFD, wakeupFD);
+    return error::nil;
+}
+
+EventLoop::~EventLoop() {
+    Close();
+}
+
+error EventLoop::Close() {
+    if (m_closed) {
+        return error::nil;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_registrations.clear();
+        m_tasks.clear();
+    }
+    // the fds are released even if close fails, so that the loop must not be closed again
+    m_closed = true;
+    close(m_wakeupFD);
+    if (close(m_pollFD) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
+error EventLoop::Add(const SocketFD& fd, const EventHandler& handler) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if ((flags & O_NONBLOCK) == 0) {
+        assert(0 && "fd must be in non-blocking mode");
+        return error::illegal_argument;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_registrations.count(fd) != 0) {
+        return error::wrap(etype::os, EEXIST);
+    }
+    std::shared_ptr<Registration> reg = std::make_shared<Registration>();
+    reg->Seq = m_nextSeq++;
+    reg->Handler = handler;
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = toToken(fd, reg->Seq);
+    if (epoll_ctl(m_pollFD, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    m_registrations[fd] = std::move(reg);
+    return error::nil;
+}
+
+error EventLoop::Remove(const SocketFD& fd) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    std::shared_ptr<Registration> reg; // destroy handlers outside of the lock
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_registrations.find(fd);
+    if (it == m_registrations.end()) {
+        return error::not_found;
+    }
+    reg = std::move(it->second);
+    m_registrations.erase(it);
+    // the fd may have been closed already, in which case the kernel has dropped it
+    epoll_ctl(m_pollFD, EPOLL_CTL_DEL, fd, nullptr);
+    return error::nil;
+}
+
+std::shared_ptr<EventLoop::Registration> EventLoop::find(const SocketFD& fd, uint32_t seq) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_registrations.find(fd);
+    if (it == m_registrations.end() || it->second->Seq != seq) {
+        return nullptr; // removed, or replaced by a new registration of a reused fd
+    }
+    return it->second;
+}
+
+error EventLoop::RunOnce(int64_t timeoutMilliseconds) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    m_loopThread = std::this_thread::get_id();
+    struct epoll_event events[kMaxEvents];
+    int64_t timeout = timeoutMilliseconds;
+    int64_t next = m_timers.NextTimeout(now());
+    if (next >= 0 && (timeout < 0 || next < timeout)) {
+        timeout = next;
+    }
+    int n = epoll_wait(m_pollFD, events, kMaxEvents, (timeout < 0) ? -1 : (int) timeout);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return error::nil;
+        }
+        return error::wrap(etype::os, errno);
+    }
+    m_now = now();
+
+    for (int i = 0; i < n; i++) {
+        const struct epoll_event& ev = events[i];
+        if (ev.data.u64 == kWakeupToken) {
+            uint64_t count;
+            while (read(m_wakeupFD, &count, sizeof(count)) > 0) {}
+            runTasks();
+            continue;
+        }
+
+        SocketFD fd = (SocketFD) (ev.data.u64 & 0xffffffff);
+        uint32_t seq = (uint32_t) (ev.data.u64 >> 32);
+        std::shared_ptr<Registration> reg = find(fd, seq);
+        if (reg == nullptr) {
+            continue;
+        }
+        reg->LastActive = m_now;
+
+        // EPOLLERR without a hang-up nor a socket error means that the error queue is readable
+        error sockErr = error::nil;
+        bool errorQueue = false;
+        if ((ev.events & EPOLLERR) && !(ev.events & EPOLLHUP) && reg->Handler.OnErrorQueue) {
+            sockErr = pendingError(fd);
+            errorQueue = (sockErr == error::eof);
+        }
+        bool closing = (ev.events & EPOLLHUP) || ((ev.events & EPOLLERR) && !errorQueue);
+
+        if (ev.events & (EPOLLIN | EPOLLRDHUP)) {
+            if (reg->Handler.OnReadable) {
+                reg->Handler.OnReadable();
+            }
+        }
+        if ((ev.events & EPOLLOUT) && !closing) {
+            if (find(fd, seq) != nullptr && reg->Handler.OnWritable) {
+                reg->Handler.OnWritable();
+            }
+        }
+        if (errorQueue) {
+            if (find(fd, seq) != nullptr) {
+                reg->Handler.OnErrorQueue();
+            }
+        }
+        if (closing) {
+            if (find(fd, seq) != nullptr) {
+                error err = (sockErr != error::nil) ? sockErr : pendingError(fd);
+                cancelTimers(reg.get());
+                Remove(fd);
+                if (reg->Handler.OnClosed) {
+                    reg->Handler.OnClosed(err);
+                }
+            }
+        }
+    }
+    m_timers.Advance(m_now);
+    return error::nil;
+}
+
+error EventLoop::Run() {
+    while (!m_stopped) {
+        error err = RunOnce(-1);
+        if (err != error::nil) {
+            m_stopped = false;
+            return err;
+        }
+    }
+    m_stopped = false;
+    return error::nil;
+}
+
+error EventLoop::Stop() {
+    m_stopped = true;
+    return wakeup();
+}
+
+error EventLoop::Post(const std::function<void()>& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(task);
+    }
+    return wakeup();
+}
+
+error EventLoop::wakeup() {
+    uint64_t one = 1;
+    if (write(m_wakeupFD, &one, sizeof(one)) == -1) {
+        if (errno == EAGAIN) { // the counter is saturated, so that a wakeup is pending anyway
+            return error::nil;
+        }
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
+void EventLoop::runTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tasks.swap(m_tasks);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+size_t EventLoop::Size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_registrations.size();
+}
+
+int64_t EventLoop::now() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+TimerID EventLoop::RunAfter(int64_t delayMilliseconds, const std::function<void()>& task) {
+    return m_timers.Schedule(now() + delayMilliseconds, task);
+}
+
+bool EventLoop::CancelTimer(TimerID id) {
+    return m_timers.Cancel(id);
+}
+
+error EventLoop::SetDeadline(const SocketFD& fd, int64_t timeoutMilliseconds) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    std::shared_ptr<Registration> reg;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_registrations.find(fd);
+        if (it == m_registrations.end()) {
+            return error::not_found;
+        }
+        reg = it->second;
+    }
+
+    if (reg->Deadline != 0) {
+        m_timers.Cancel(reg->Deadline);
+        reg->Deadline = 0;
+    }
+    if (timeoutMilliseconds > 0) {
+        uint32_t seq = reg->Seq;
+        reg->Deadline = RunAfter(timeoutMilliseconds, [this, fd, seq]() {
+            expire(fd, seq, false);
+        });
+    }
+    return error::nil;
+}
+
+error EventLoop::SetIdleTimeout(const SocketFD& fd, int64_t timeoutMilliseconds) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    std::shared_ptr<Registration> reg;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_registrations.find(fd);
+        if (it == m_registrations.end()) {
+            return error::not_found;
+        }
+        reg = it->second;
+    }
+
+    if (reg->IdleTimer != 0) {
+        m_timers.Cancel(reg->IdleTimer);
+        reg->IdleTimer = 0;
+    }
+    reg->IdleTimeout = (timeoutMilliseconds > 0) ? timeoutMilliseconds : 0;
+    if (reg->IdleTimeout > 0) {
+        reg->LastActive = now();
+        uint32_t seq = reg->Seq;
+        reg->IdleTimer = RunAfter(reg->IdleTimeout, [this, fd, seq]() {
+            expire(fd, seq, true);
+        });
+    }
+    return error::nil;
+}
+
+void EventLoop::expire(const SocketFD& fd, uint32_t seq, bool idle) {
+    // timers of removed fds are not cancelled, since Remove may be called from any thread
+    std::shared_ptr<Registration> reg = find(fd, seq);
+    if (reg == nullptr) {
+        return;
+    }
+
+    if (idle) {
+        reg->IdleTimer = 0;
+        int64_t idleDeadline = reg->LastActive + reg->IdleTimeout;
+        int64_t current = now();
+        if (idleDeadline > current) { // active since the timer was scheduled
+            reg->IdleTimer = RunAfter(idleDeadline - current, [this, fd, seq]() {
+                expire(fd, seq, true);
+            });
+            return;
+        }
+    } else {
+        reg->Deadline = 0;
+    }
+    cancelTimers(reg.get());
+    Remove(fd);
+    if (reg->Handler.OnClosed) {
+        reg->Handler.OnClosed(error::timedout);
+    }
+}
+
+void EventLoop::cancelTimers(Registration* reg) {
+    if (reg->Deadline != 0) {
+        m_timers.Cancel(reg->Deadline);
+        reg->Deadline = 0;
+    }
+    if (reg->IdleTimer != 0) {
+        m_timers.Cancel(reg->IdleTimer);
+        reg->IdleTimer = 0;
+    }
+}
+
+} // namespace net
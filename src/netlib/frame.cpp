@@ -0,0 +1,200 @@
+#include "netlib/frame.h"
+#include <cassert>
+
+namespace net {
+
+static const size_t kMaxVarintSize = 10; // of a uint64_t
+static const uint64_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+static uint64_t maxLength(const FrameConfig& config) {
+    uint64_t limit = UINT64_MAX;
+    if (config.Prefix == LengthPrefix::Fixed32) {
+        limit = UINT32_MAX;
+    } else if (config.Prefix == LengthPrefix::Fixed16) {
+        limit = UINT16_MAX;
+    }
+    // a peer must not be able to make the reader allocate as much as the prefix allows
+    uint64_t max = (config.MaxFrameSize > 0) ? config.MaxFrameSize : kDefaultMaxFrameSize;
+    return (max < limit) ? max : limit;
+}
+
+FrameReader::FrameReader(const std::shared_ptr<Reader>& reader, const FrameConfig& config, size_t bufferSize)
+        : m_reader(reader, bufferSize), m_config(config) {}
+
+error FrameReader::readLength(uint64_t* length) {
+    if (m_config.Prefix == LengthPrefix::Varint) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < kMaxVarintSize; i++) {
+            char c;
+            error err = m_reader.ReadFull(&c, 1);
+            if (err != error::nil) {
+                return err;
+            }
+            if (i == kMaxVarintSize - 1 && (unsigned char) c > 1) { // beyond 64 bits
+                return error::proto;
+            }
+            value |= (uint64_t) (c & 0x7f) << (7 * i);
+            if ((c & 0x80) == 0) {
+                *length = value;
+                return error::nil;
+            }
+        }
+        return error::proto;
+    }
+
+    char buf[sizeof(uint32_t)];
+    size_t size = (m_config.Prefix == LengthPrefix::Fixed16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    error err = m_reader.ReadFull(buf, size);
+    if (err != error::nil) {
+        return err;
+    }
+    ByteBuffer bb(buf, size, m_config.Order);
+    *length = (size == sizeof(uint16_t)) ? bb.GetUint16() : bb.GetUint32();
+    return error::nil;
+}
+
+error FrameReader::ReadFrame(std::vector<char>* frame) {
+    if (frame == nullptr) {
+        assert(0 && "frame must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    uint64_t length = 0;
+    error err = readLength(&length);
+    if (err != error::nil) {
+        return err;
+    }
+    if (length > maxLength(m_config) || length > frame->max_size()) {
+        return error::msgsize;
+    }
+    frame->resize(length);
+    if (length == 0) {
+        return error::nil;
+    }
+    return m_reader.ReadFull(frame->data(), length);
+}
+
+FrameWriter::FrameWriter(const std::shared_ptr<Writer>& writer, const FrameConfig& config)
+        : m_writer(writer), m_config(config), m_pending(0) {
+    assert(writer != nullptr && "writer must not be nullptr");
+}
+
+error FrameWriter::addPrefix(size_t len) {
+    if (len > maxLength(m_config)) {
+        return error::msgsize;
+    }
+
+    char buf[kMaxVarintSize];
+    size_t size = 0;
+    if (m_config.Prefix == LengthPrefix::Varint) {
+        uint64_t value = len;
+        do {
+            buf[size] = (char) (value & 0x7f);
+            value >>= 7;
+            if (value != 0) {
+                buf[size] |= 0x80;
+            }
+            size++;
+        } while (value != 0);
+    } else if (m_config.Prefix == LengthPrefix::Fixed16) {
+        size = sizeof(uint16_t);
+        ByteBuffer(buf, size, m_config.Order).PutUint16((uint16_t) len);
+    } else {
+        size = sizeof(uint32_t);
+        ByteBuffer(buf, size, m_config.Order).PutUint32((uint32_t) len);
+    }
+
+    Part part = {nullptr, m_prefixes.size(), size};
+    m_prefixes.insert(m_prefixes.end(), buf, buf + size);
+    m_parts.push_back(part);
+    m_pending += size;
+    return error::nil;
+}
+
+void FrameWriter::addPart(const char* base, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    Part part = {base, 0, len};
+    m_parts.push_back(part);
+    m_pending += len;
+}
+
+error FrameWriter::Add(const char* buf, size_t len) {
+    if (buf == nullptr && len > 0) {
+        assert(0 && "buf must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    error err = addPrefix(len);
+    if (err != error::nil) {
+        return err;
+    }
+    addPart(buf, len);
+    return error::nil;
+}
+
+error FrameWriter::Add(const IOBuf& frame) {
+    error err = addPrefix(frame.Length());
+    if (err != error::nil) {
+        return err;
+    }
+    m_retained.push_back(frame);
+    m_iov.clear();
+    m_retained.back().ToIOVecs(&m_iov);
+    for (const IOVec& v : m_iov) {
+        addPart(v.Base, v.Len);
+    }
+    return error::nil;
+}
+
+error FrameWriter::Flush() {
+    if (m_parts.empty()) {
+        return error::nil;
+    }
+
+    m_iov.clear(); // resolved here, as m_prefixes may have moved while adding
+    for (const Part& part : m_parts) {
+        const char* base = (part.Base != nullptr) ? part.Base : m_prefixes.data() + part.Offset;
+        IOVec v = {const_cast<char*>(base), part.Len};
+        m_iov.push_back(v);
+    }
+    size_t written = 0;
+    error err = m_writer->WriteFullV(m_iov.data(), m_iov.size(), &written);
+    if (err == error::nil) {
+        m_prefixes.clear();
+        m_parts.clear();
+        m_retained.clear();
+        m_pending = 0;
+        return error::nil;
+    }
+
+    // keep the rest for the next Flush
+    m_pending -= written;
+    size_t i = 0;
+    while (written > 0 && written >= m_parts[i].Len) {
+        written -= m_parts[i].Len;
+        i++;
+    }
+    m_parts.erase(m_parts.begin(), m_parts.begin() + i);
+    if (written > 0) {
+        Part& part = m_parts.front();
+        if (part.Base != nullptr) {
+            part.Base += written;
+        } else {
+            part.Offset += written;
+        }
+        part.Len -= written;
+    }
+    return err;
+}
+
+error FrameWriter::WriteFrame(const char* buf, size_t len) {
+    error err = Add(buf, len);
+    if (err != error::nil) {
+        return err;
+    }
+    return Flush();
+}
+
+} // namespace net
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "netlib/binary.h"
+#include "netlib/bufio.h"
+#include "netlib/error.h"
+#include "netlib/iobuf.h"
+#include "netlib/stream.h"
+
+namespace net {
+
+enum struct LengthPrefix {
+    Fixed32,
+    Fixed16,
+    Varint, // unsigned LEB128 as in Protocol Buffers
+};
+
+struct FrameConfig {
+    LengthPrefix Prefix;
+    /** The byte order of a fixed length prefix. */
+    ByteOrder Order;
+    /** The largest length of a frame, excluding the prefix. 16 MB if 0 is specified. */
+    size_t MaxFrameSize;
+};
+
+/**
+ * Reads length-prefixed frames.
+ * The frames are read from a BufferedReader, so that a single Read of the source
+ * serves as many small frames as fit into the buffer.
+ * Not thread-safe.
+ */
+class FrameReader final {
+public:
+    /**
+     * @param[in] reader The source
+     * @param[in] config
+     * @param[in] bufferSize The size of the read buffer. BufferedReader::kDefaultSize if 0 is specified.
+     */
+    FrameReader(const std::shared_ptr<Reader>& reader, const FrameConfig& config,
+            size_t bufferSize = BufferedReader::kDefaultSize);
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    /**
+     * Read the next frame. The stream cannot be read any further after an error
+     * except error::eof at the start of a frame.
+     *
+     * @param[out] frame The payload of the frame. Reuse it to spare allocations.
+     * @return error::msgsize if the frame is larger than MaxFrameSize,
+     *         error::proto if the length prefix is malformed
+     */
+    error ReadFrame(std::vector<char>* frame);
+    /**
+     * @return the number of bytes which can be read without reading the source
+     */
+    size_t Buffered() { return m_reader.Buffered(); }
+
+private:
+    BufferedReader m_reader;
+    const FrameConfig m_config;
+
+    error readLength(uint64_t* length);
+};
+
+/**
+ * Writes length-prefixed frames.
+ * The frames added are written with a single vectored write on Flush.
+ * Not thread-safe.
+ */
+class FrameWriter final {
+public:
+    /**
+     * @param[in] writer The destination
+     * @param[in] config
+     */
+    FrameWriter(const std::shared_ptr<Writer>& writer, const FrameConfig& config);
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    /**
+     * Add a frame without copying the payload.
+     *
+     * @param[in] buf Must be valid until it is written by Flush
+     * @param[in] len
+     * @return error::msgsize if len is larger than MaxFrameSize
+     */
+    error Add(const char* buf, size_t len);
+    /**
+     * Add a frame which keeps a reference to the payload until it is written.
+     */
+    error Add(const IOBuf& frame);
+    /**
+     * Write all of the frames added. The bytes which could not be written are kept,
+     * e.g. on error::wouldblock in non-blocking mode.
+     */
+    error Flush();
+    /**
+     * Add a frame and flush.
+     */
+    error WriteFrame(const char* buf, size_t len);
+    /**
+     * @return the number of bytes waiting for Flush
+     */
+    size_t Pending() { return m_pending; }
+
+private:
+    struct Part {
+        const char* Base; // nullptr for a prefix, which is stored in m_prefixes at Offset
+        size_t Offset;
+        size_t Len;
+    };
+
+    std::shared_ptr<Writer> m_writer;
+    const FrameConfig m_config;
+    std::vector<char> m_prefixes;
+    std::vector<Part> m_parts;
+    std::vector<IOBuf> m_retained;
+    std::vector<IOVec> m_iov;
+    size_t m_pending;
+
+    error addPrefix(size_t len);
+    void addPart(const char* base, size_t len);
+};
+
+} // namespace net
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+#include "netlib/io_engine.h"
+
+namespace net {
+namespace internal {
+
+error newEpollEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine);
+error newURingEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine);
+
+} // namespace internal
+} // namespace net
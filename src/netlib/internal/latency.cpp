@@ -0,0 +1,52 @@
+#include "netlib/internal/latency.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace net {
+namespace internal {
+
+static const size_t kMaxEntries = 1024;
+static const int64_t kUnknown = INT64_MAX - 1;
+static const int64_t kFailed = INT64_MAX;
+
+static std::mutex s_mutex;
+static std::unordered_map<std::string, int64_t> s_latencies; // smoothed, in milliseconds
+
+void recordLatency(const std::string& addr, int64_t milliseconds) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_latencies.size() >= kMaxEntries && s_latencies.count(addr) == 0) {
+        s_latencies.clear(); // the cache is only a hint
+    }
+    if (milliseconds < 0) {
+        s_latencies[addr] = kFailed;
+        return;
+    }
+    auto it = s_latencies.find(addr);
+    if (it == s_latencies.end() || it->second == kFailed) {
+        s_latencies[addr] = milliseconds;
+    } else {
+        it->second = (it->second * 7 + milliseconds) / 8;
+    }
+}
+
+void sortByLatency(std::vector<std::string>* addrs) {
+    std::vector<std::pair<int64_t, std::string>> sorted;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto& addr : *addrs) {
+            auto it = s_latencies.find(addr);
+            sorted.emplace_back((it != s_latencies.end()) ? it->second : kUnknown, addr);
+        }
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+            [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+        return a.first < b.first;
+    });
+    for (size_t i = 0; i < sorted.size(); i++) {
+        (*addrs)[i] = std::move(sorted[i].second);
+    }
+}
+
+} // namespace internal
+} // namespace net
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace net {
+namespace internal {
+
+/**
+ * Record the time which a connect to addr has taken.
+ * A negative latency records a failure.
+ */
+void recordLatency(const std::string& addr, int64_t milliseconds);
+
+/**
+ * Stably sort addrs so that the addresses which have connected fastest come first,
+ * followed by the unknown ones, and then the ones which have failed.
+ */
+void sortByLatency(std::vector<std::string>* addrs);
+
+} // namespace internal
+} // namespace net
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "netlib/error.h"
+#include "netlib/fd.h"
+#include "netlib/socket_options.h"
+#include "netlib/stream.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+ #include <vector>
+#else
+struct iovec;
+#endif // defined(_WIN32) || defined(_WIN64)
+
+namespace net {
+namespace internal {
+
+error setNonBlocking(const SocketFD& fd, bool on);
+/**
+ * @param[in] fd
+ * @param[in] options
+ * @param[in] tcp false to skip the TCP options
+ */
+error applySocketOptions(const SocketFD& fd, const SocketOptions& options, bool tcp);
+
+#if defined(_WIN32) || defined(_WIN64)
+std::vector<WSABUF> toWSABufs(const IOVec* iov, size_t iovcnt);
+#else
+/** IOVec is passed to the kernel as is, since it is laid out as struct iovec. */
+inline struct iovec* toIOVec(const IOVec* iov) {
+    return reinterpret_cast<struct iovec*>(const_cast<IOVec*>(iov));
+}
+#endif // defined(_WIN32) || defined(_WIN64)
+
+} // namespace internal
+} // namespace net
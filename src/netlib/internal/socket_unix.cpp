@@ -0,0 +1,100 @@
+#include "netlib/internal/socket.h"
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace net {
+namespace internal {
+
+static_assert(sizeof(IOVec) == sizeof(struct iovec)
+        && offsetof(IOVec, Base) == offsetof(struct iovec, iov_base)
+        && offsetof(IOVec, Len) == offsetof(struct iovec, iov_len),
+        "IOVec must be laid out as struct iovec");
+
+error setNonBlocking(const SocketFD& fd, bool on) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    int newFlags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (newFlags == flags) {
+        return error::nil;
+    }
+    if (fcntl(fd, F_SETFL, newFlags) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
+static error setIntOption(const SocketFD& fd, int level, int name, int value) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
+error applySocketOptions(const SocketFD& fd, const SocketOptions& options, bool tcp) {
+    error err = error::nil;
+    if (options.ReceiveBufferSize > 0) {
+        err = setIntOption(fd, SOL_SOCKET, SO_RCVBUF, options.ReceiveBufferSize);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    if (options.SendBufferSize > 0) {
+        err = setIntOption(fd, SOL_SOCKET, SO_SNDBUF, options.SendBufferSize);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#ifdef SO_REUSEPORT
+    if (options.ReusePort) {
+        err = setIntOption(fd, SOL_SOCKET, SO_REUSEPORT, 1);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#endif // SO_REUSEPORT
+#ifdef SO_BUSY_POLL
+    if (options.BusyPollMicroseconds > 0) {
+        err = setIntOption(fd, SOL_SOCKET, SO_BUSY_POLL, options.BusyPollMicroseconds);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#endif // SO_BUSY_POLL
+    if (!tcp) {
+        return error::nil;
+    }
+
+    if (options.NoDelay) {
+        err = setIntOption(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#ifdef TCP_QUICKACK
+    if (options.QuickAck) {
+        err = setIntOption(fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#endif // TCP_QUICKACK
+#ifdef TCP_NOTSENT_LOWAT
+    if (options.NotSentLowWatermark > 0) {
+        err = setIntOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.NotSentLowWatermark);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+#endif // TCP_NOTSENT_LOWAT
+    return error::nil;
+}
+
+} // namespace internal
+} // namespace net
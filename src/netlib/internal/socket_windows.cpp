@@ -0,0 +1,56 @@
+#include "netlib/internal/socket.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+namespace net {
+namespace internal {
+
+error setNonBlocking(const SocketFD& fd, bool on) {
+    unsigned long mode = on ? 1 : 0;
+    if (ioctlsocket(fd, FIONBIO, &mode) == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    return error::nil;
+}
+
+static error setIntOption(const SocketFD& fd, int level, int name, int value) {
+    if (setsockopt(fd, level, name, (const char*) &value, sizeof(value)) == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    return error::nil;
+}
+
+error applySocketOptions(const SocketFD& fd, const SocketOptions& options, bool tcp) {
+    error err = error::nil;
+    if (options.ReceiveBufferSize > 0) {
+        err = setIntOption(fd, SOL_SOCKET, SO_RCVBUF, options.ReceiveBufferSize);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    if (options.SendBufferSize > 0) {
+        err = setIntOption(fd, SOL_SOCKET, SO_SNDBUF, options.SendBufferSize);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    if (tcp && options.NoDelay) {
+        err = setIntOption(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    return error::nil;
+}
+
+std::vector<WSABUF> toWSABufs(const IOVec* iov, size_t iovcnt) {
+    std::vector<WSABUF> bufs(iovcnt);
+    for (size_t i = 0; i < iovcnt; i++) {
+        bufs[i].buf = iov[i].Base;
+        bufs[i].len = (ULONG) iov[i].Len;
+    }
+    return bufs;
+}
+
+} // namespace internal
+} // namespace net
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "netlib/error.h"
+#include "netlib/fd.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+
+namespace net {
+
+enum struct IOEngineType {
+    Epoll,   // readiness-based, emulates completions on top of EventLoop
+    IOUring, // completion-based, requires Linux 6.0 or later
+};
+
+struct IOEngineConfig {
+    IOEngineType Type;
+    /** The number of submission queue entries. 256 if 0 is specified. */
+    unsigned int QueueDepth;
+    /** The number of buffers shared by RecvMultishot. 256 if 0 is specified; rounded up to a power of 2. */
+    unsigned int BufferCount;
+    /** The size of each buffer shared by RecvMultishot. 4096 if 0 is specified. */
+    size_t BufferSize;
+};
+
+/**
+ * A proactor which runs socket operations asynchronously and reports
+ * their results through completion callbacks.
+ *
+ * Operations are queued and submitted in a batch when Submit or RunOnce
+ * is called, and callbacks are always called on the thread running the engine.
+ * Buffers passed to an operation must outlive its completion.
+ * Only Post and Stop may be called from other threads.
+ */
+class IOEngine : public Closer {
+public:
+    using AcceptCallback = std::function<void(const error& err, const std::shared_ptr<TCPSocket>& sock)>;
+    using ConnectCallback = std::function<void(const error& err, const std::shared_ptr<TCPSocket>& sock)>;
+    using IOCallback = std::function<void(const error& err, int nbytes)>;
+    /** data is owned by the engine, and is valid only until the callback returns. */
+    using RecvCallback = std::function<void(const error& err, const char* data, int nbytes)>;
+    using RecvFromCallback = std::function<void(const error& err, int nbytes, const std::string& addr, uint16_t port)>;
+
+    virtual ~IOEngine() {}
+
+    virtual IOEngineType Type() = 0;
+    /**
+     * @param[in] fd A listening socket
+     * @param[in] callback
+     */
+    virtual error Accept(const SocketFD& fd, const AcceptCallback& callback) = 0;
+    /**
+     * Accept connections repeatedly until an error occurs or Cancel is called.
+     *
+     * @param[in] fd A listening socket
+     * @param[in] callback
+     */
+    virtual error AcceptMultishot(const SocketFD& fd, const AcceptCallback& callback) = 0;
+    /**
+     * The connected socket is passed in blocking mode, as the accepted ones are,
+     * whichever the backend is.
+     *
+     * @param[in] addr An IPv4 address
+     * @param[in] port
+     * @param[in] callback
+     */
+    virtual error Connect(const std::string& addr, uint16_t port, const ConnectCallback& callback) = 0;
+    /**
+     * @param[in] fd
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback error::eof is passed if the peer has closed the connection.
+     */
+    virtual error Recv(const SocketFD& fd, char* buf, size_t len, const IOCallback& callback) = 0;
+    /**
+     * Receive repeatedly into buffers owned by the engine
+     * until an error occurs or Cancel is called.
+     *
+     * @param[in] fd
+     * @param[in] callback error::eof is passed if the peer has closed the connection.
+     */
+    virtual error RecvMultishot(const SocketFD& fd, const RecvCallback& callback) = 0;
+    /**
+     * @param[in] fd
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback
+     */
+    virtual error Send(const SocketFD& fd, const char* buf, size_t len, const IOCallback& callback) = 0;
+    /**
+     * @param[in] fd A UDP socket
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] callback
+     */
+    virtual error RecvFrom(const SocketFD& fd, char* buf, size_t len, const RecvFromCallback& callback) = 0;
+    /**
+     * @param[in] fd A UDP socket
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] addr An IPv4 address
+     * @param[in] port
+     * @param[in] callback
+     */
+    virtual error SendTo(const SocketFD& fd, const char* buf, size_t len,
+            const std::string& addr, uint16_t port, const IOCallback& callback) = 0;
+    /**
+     * Cancel all pending operations on fd.
+     * Their callbacks are called with ECANCELED.
+     *
+     * @param[in] fd
+     */
+    virtual error Cancel(const SocketFD& fd) = 0;
+    /**
+     * Submit all queued operations to the kernel.
+     */
+    virtual error Submit() = 0;
+    /**
+     * Submit queued operations, wait for completions once and dispatch them.
+     *
+     * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if a negative integer is specified.
+     */
+    virtual error RunOnce(int64_t timeoutMilliseconds) = 0;
+    /**
+     * Dispatch completions until Stop is called.
+     */
+    virtual error Run() = 0;
+    virtual void Stop() = 0;
+    /**
+     * Run task on the engine thread.
+     *
+     * @param[in] task
+     */
+    virtual void Post(const std::function<void()>& task) = 0;
+};
+
+/**
+ * @param[in] config
+ * @param[out] engine
+ */
+error NewIOEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine);
+
+} // namespace net
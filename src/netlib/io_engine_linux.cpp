@@ -0,0 +1,498 @@
+#include "netlib/io_engine.h"
+#include <cassert>
+#include <cerrno>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "netlib/event_loop.h"
+#include "netlib/internal/init.h"
+#include "netlib/internal/io_engine.h"
+#include "netlib/internal/socket.h"
+
+namespace net {
+
+static const unsigned int kDefaultBufferSize = 4096;
+
+error NewIOEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine) {
+    if (engine == nullptr) {
+        assert(0 && "engine must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    switch (config.Type) {
+    case IOEngineType::Epoll:
+        return internal::newEpollEngine(config, engine);
+    case IOEngineType::IOUring:
+        return internal::newURingEngine(config, engine);
+    default:
+        return error::illegal_argument;
+    }
+}
+
+namespace {
+
+/**
+ * Emulates completions with readiness events: an operation is attempted
+ * when it is submitted, and retried every time its fd becomes ready.
+ */
+class EpollEngine final : public IOEngine {
+public:
+    EpollEngine(const std::shared_ptr<EventLoop>& loop, size_t bufferSize)
+            : m_loop(loop), m_buffer(bufferSize), m_stopped(false), m_nextID(1), m_completed(0) {}
+    ~EpollEngine() { Close(); }
+
+    error Close() { return m_loop->Close(); }
+    IOEngineType Type() { return IOEngineType::Epoll; }
+    error Accept(const SocketFD& fd, const AcceptCallback& callback);
+    error AcceptMultishot(const SocketFD& fd, const AcceptCallback& callback);
+    error Connect(const std::string& addr, uint16_t port, const ConnectCallback& callback);
+    error Recv(const SocketFD& fd, char* buf, size_t len, const IOCallback& callback);
+    error RecvMultishot(const SocketFD& fd, const RecvCallback& callback);
+    error Send(const SocketFD& fd, const char* buf, size_t len, const IOCallback& callback);
+    error RecvFrom(const SocketFD& fd, char* buf, size_t len, const RecvFromCallback& callback);
+    error SendTo(const SocketFD& fd, const char* buf, size_t len,
+            const std::string& addr, uint16_t port, const IOCallback& callback);
+    error Cancel(const SocketFD& fd);
+    error Submit();
+    error RunOnce(int64_t timeoutMilliseconds);
+    error Run();
+    void Stop();
+    void Post(const std::function<void()>& task) { m_loop->Post(task); }
+
+private:
+    struct Op {
+        uint64_t ID;
+        /** Return true if the operation has finished, false if it has to wait for the next event. */
+        std::function<bool()> Attempt;
+        std::function<void(const error& err)> Abort;
+    };
+    struct Channel {
+        bool Registered;
+        ino_t Inode; // tells a reused fd apart from the socket registered
+        std::deque<Op> Reads;
+        std::deque<Op> Writes;
+    };
+    /** An operation being attempted, which its own callback may cancel. */
+    struct Running {
+        uint64_t ID;
+        bool Cancelled;
+        error Err;
+    };
+
+    std::shared_ptr<EventLoop> m_loop;
+    std::vector<char> m_buffer;
+    std::atomic<bool> m_stopped;
+    uint64_t m_nextID;
+    uint64_t m_completed;
+    std::unordered_map<SocketFD, Channel> m_channels;
+    std::vector<SocketFD> m_dirty;
+    std::vector<Running> m_running; // nested if a callback submits
+
+    error enqueue(const SocketFD& fd, bool write,
+            const std::function<bool()>& attempt,
+            const std::function<void(const error& err)>& abort);
+    void drain(const SocketFD& fd, bool write);
+    void abortAll(const SocketFD& fd, const error& err);
+};
+
+} // namespace
+
+static error lastError() {
+    return error::wrap(etype::os, errno);
+}
+
+static bool wouldBlock(int err) {
+    return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+}
+
+static std::shared_ptr<TCPSocket> newTCPSocket(const SocketFD& fd, const struct sockaddr_in& addr) {
+    return std::make_shared<TCPSocket>(fd, addr.sin_addr.s_addr, ntohs(addr.sin_port), false);
+}
+
+static bool toSockaddr(const std::string& addr, uint16_t port, struct sockaddr_in* dest) {
+    *dest = {};
+    dest->sin_family = AF_INET;
+    dest->sin_port = htons(port);
+    return inet_pton(AF_INET, addr.c_str(), &dest->sin_addr) == 1;
+}
+
+error internal::newEpollEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine) {
+    std::shared_ptr<EventLoop> loop;
+    error err = NewEventLoop(&loop);
+    if (err != error::nil) {
+        return err;
+    }
+    size_t bufferSize = (config.BufferSize > 0) ? config.BufferSize : kDefaultBufferSize;
+    *engine = std::make_shared<EpollEngine>(loop, bufferSize);
+    return error::nil;
+}
+
+error EpollEngine::enqueue(const SocketFD& fd, bool write,
+        const std::function<bool()>& attempt,
+        const std::function<void(const error& err)>& abort) {
+    if (m_loop->IsClosed()) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return lastError();
+    }
+    auto it = m_channels.find(fd);
+    if (it != m_channels.end() && it->second.Registered && it->second.Inode != st.st_ino) {
+        // the socket has been closed without Cancel, and its fd reused by a new one
+        abortAll(fd, error::wrap(etype::os, EBADF));
+    }
+    Channel& ch = m_channels[fd];
+    if (!ch.Registered) {
+        EventHandler handler;
+        handler.OnReadable = [this, fd]() { drain(fd, false); };
+        handler.OnWritable = [this, fd]() { drain(fd, true); };
+        handler.OnClosed = [this, fd](const error& err) {
+            // let the pending operations observe the error by themselves
+            drain(fd, false);
+            drain(fd, true);
+            abortAll(fd, err);
+        };
+        // the engine owns the I/O on fd, which is never done in blocking mode
+        error err = internal::setNonBlocking(fd, true);
+        if (err == error::nil) {
+            err = m_loop->Add(fd, handler);
+        }
+        if (err != error::nil) {
+            m_channels.erase(fd);
+            return err;
+        }
+        ch.Registered = true;
+        ch.Inode = st.st_ino;
+    }
+    Op op = { m_nextID++, attempt, abort };
+    if (write) {
+        ch.Writes.push_back(std::move(op));
+    } else {
+        ch.Reads.push_back(std::move(op));
+    }
+    m_dirty.push_back(fd);
+    return error::nil;
+}
+
+void EpollEngine::drain(const SocketFD& fd, bool write) {
+    while (true) {
+        auto it = m_channels.find(fd);
+        if (it == m_channels.end()) {
+            return;
+        }
+        std::deque<Op>& ops = write ? it->second.Writes : it->second.Reads;
+        if (ops.empty()) {
+            return;
+        }
+        Op op = ops.front(); // the callback may enqueue or cancel operations
+        m_running.push_back({op.ID, false, error::nil});
+        bool finished = op.Attempt();
+        Running running = m_running.back();
+        m_running.pop_back();
+        if (running.Cancelled) { // the channel has been dropped by the callback
+            if (!finished) {
+                op.Abort(running.Err);
+            }
+            continue;
+        }
+        if (!finished) {
+            return;
+        }
+        m_completed++;
+
+        it = m_channels.find(fd);
+        if (it == m_channels.end()) {
+            return;
+        }
+        std::deque<Op>& rest = write ? it->second.Writes : it->second.Reads;
+        if (!rest.empty() && rest.front().ID == op.ID) {
+            rest.pop_front();
+        }
+    }
+}
+
+void EpollEngine::abortAll(const SocketFD& fd, const error& err) {
+    auto it = m_channels.find(fd);
+    if (it == m_channels.end()) {
+        return;
+    }
+    Channel ch = std::move(it->second);
+    m_channels.erase(it);
+    if (ch.Registered) {
+        m_loop->Remove(fd);
+    }
+    for (auto* ops : { &ch.Reads, &ch.Writes }) {
+        for (auto& op : *ops) {
+            bool running = false;
+            for (auto& r : m_running) {
+                if (r.ID == op.ID) { // aborted by drain once its attempt returns
+                    r.Cancelled = true;
+                    r.Err = err;
+                    running = true;
+                }
+            }
+            if (!running) {
+                op.Abort(err);
+            }
+        }
+    }
+}
+
+error EpollEngine::Accept(const SocketFD& fd, const AcceptCallback& callback) {
+    return enqueue(fd, false, [fd, callback]() {
+        struct sockaddr_in addr = {0};
+        socklen_t addrlen = sizeof(addr);
+        int clientFD = accept4(fd, (struct sockaddr*) &addr, &addrlen, SOCK_CLOEXEC);
+        if (clientFD == -1) {
+            if (wouldBlock(errno)) {
+                return false;
+            }
+            callback(lastError(), nullptr);
+            return true;
+        }
+        callback(error::nil, newTCPSocket(clientFD, addr));
+        return true;
+    }, [callback](const error& err) {
+        callback(err, nullptr);
+    });
+}
+
+error EpollEngine::AcceptMultishot(const SocketFD& fd, const AcceptCallback& callback) {
+    return enqueue(fd, false, [fd, callback]() {
+        while (true) {
+            struct sockaddr_in addr = {0};
+            socklen_t addrlen = sizeof(addr);
+            int clientFD = accept4(fd, (struct sockaddr*) &addr, &addrlen, SOCK_CLOEXEC);
+            if (clientFD == -1) {
+                if (wouldBlock(errno)) {
+                    return false;
+                }
+                callback(lastError(), nullptr);
+                return true;
+            }
+            callback(error::nil, newTCPSocket(clientFD, addr));
+        }
+    }, [callback](const error& err) {
+        callback(err, nullptr);
+    });
+}
+
+error EpollEngine::Connect(const std::string& addr, uint16_t port, const ConnectCallback& callback) {
+    struct sockaddr_in serverAddr;
+    if (!toSockaddr(addr, port, &serverAddr)) {
+        return error::illegal_argument;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return lastError();
+    }
+    if (connect(fd, (struct sockaddr*) &serverAddr, sizeof(serverAddr)) == -1 && errno != EINPROGRESS) {
+        int err = errno;
+        close(fd);
+        return error::wrap(etype::os, err);
+    }
+
+    error err = enqueue(fd, true, [this, fd, serverAddr, callback]() {
+        int soErr = 0;
+        socklen_t optlen = sizeof(soErr);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &soErr, &optlen);
+        if (soErr == 0) {
+            struct sockaddr_in peer;
+            socklen_t peerlen = sizeof(peer);
+            if (getpeername(fd, (struct sockaddr*) &peer, &peerlen) == -1) {
+                return false; // still in progress
+            }
+        }
+        m_channels.erase(fd);
+        m_loop->Remove(fd);
+        if (soErr == 0) { // handed over in blocking mode as the io_uring backend does
+            error err = internal::setNonBlocking(fd, false);
+            soErr = (err != error::nil) ? err.code : 0;
+        }
+        if (soErr != 0) {
+            close(fd);
+            callback(error::wrap(etype::os, soErr), nullptr);
+            return true;
+        }
+        callback(error::nil, newTCPSocket(fd, serverAddr));
+        return true;
+    }, [fd, callback](const error& err) {
+        close(fd);
+        callback(err, nullptr);
+    });
+    if (err != error::nil) {
+        close(fd);
+    }
+    return err;
+}
+
+error EpollEngine::Recv(const SocketFD& fd, char* buf, size_t len, const IOCallback& callback) {
+    return enqueue(fd, false, [fd, buf, len, callback]() {
+        ssize_t size = recv(fd, buf, len, 0);
+        if (size == -1) {
+            if (wouldBlock(errno)) {
+                return false;
+            }
+            callback(lastError(), 0);
+            return true;
+        }
+        callback((size == 0) ? error::eof : error::nil, (int) size);
+        return true;
+    }, [callback](const error& err) {
+        callback(err, 0);
+    });
+}
+
+error EpollEngine::RecvMultishot(const SocketFD& fd, const RecvCallback& callback) {
+    return enqueue(fd, false, [this, fd, callback]() {
+        while (true) {
+            ssize_t size = recv(fd, m_buffer.data(), m_buffer.size(), 0);
+            if (size == -1) {
+                if (wouldBlock(errno)) {
+                    return false;
+                }
+                callback(lastError(), nullptr, 0);
+                return true;
+            }
+            if (size == 0) {
+                callback(error::eof, nullptr, 0);
+                return true;
+            }
+            callback(error::nil, m_buffer.data(), (int) size);
+        }
+    }, [callback](const error& err) {
+        callback(err, nullptr, 0);
+    });
+}
+
+error EpollEngine::Send(const SocketFD& fd, const char* buf, size_t len, const IOCallback& callback) {
+    return enqueue(fd, true, [fd, buf, len, callback]() {
+        ssize_t size = send(fd, buf, len, MSG_NOSIGNAL);
+        if (size == -1) {
+            if (wouldBlock(errno)) {
+                return false;
+            }
+            callback(lastError(), 0);
+            return true;
+        }
+        callback(error::nil, (int) size);
+        return true;
+    }, [callback](const error& err) {
+        callback(err, 0);
+    });
+}
+
+error EpollEngine::RecvFrom(const SocketFD& fd, char* buf, size_t len, const RecvFromCallback& callback) {
+    return enqueue(fd, false, [fd, buf, len, callback]() {
+        struct sockaddr_in from = {0};
+        socklen_t fromlen = sizeof(from);
+        ssize_t size = recvfrom(fd, buf, len, 0, (struct sockaddr*) &from, &fromlen);
+        if (size == -1) {
+            if (wouldBlock(errno)) {
+                return false;
+            }
+            callback(lastError(), 0, "", 0);
+            return true;
+        }
+        callback(error::nil, (int) size, inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+        return true;
+    }, [callback](const error& err) {
+        callback(err, 0, "", 0);
+    });
+}
+
+error EpollEngine::SendTo(const SocketFD& fd, const char* buf, size_t len,
+        const std::string& addr, uint16_t port, const IOCallback& callback) {
+    struct sockaddr_in to;
+    if (!toSockaddr(addr, port, &to)) {
+        return error::illegal_argument;
+    }
+    return enqueue(fd, true, [fd, buf, len, to, callback]() {
+        ssize_t size = sendto(fd, buf, len, 0, (const struct sockaddr*) &to, sizeof(to));
+        if (size == -1) {
+            if (wouldBlock(errno)) {
+                return false;
+            }
+            callback(lastError(), 0);
+            return true;
+        }
+        callback(error::nil, (int) size);
+        return true;
+    }, [callback](const error& err) {
+        callback(err, 0);
+    });
+}
+
+error EpollEngine::Cancel(const SocketFD& fd) {
+    if (m_loop->IsClosed()) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    abortAll(fd, error::wrap(etype::os, ECANCELED));
+    return error::nil;
+}
+
+error EpollEngine::Submit() {
+    if (m_loop->IsClosed()) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    while (!m_dirty.empty()) {
+        std::vector<SocketFD> dirty;
+        dirty.swap(m_dirty);
+        for (auto& fd : dirty) {
+            drain(fd, false);
+            drain(fd, true);
+        }
+    }
+    return error::nil;
+}
+
+error EpollEngine::RunOnce(int64_t timeoutMilliseconds) {
+    uint64_t completed = m_completed;
+    error err = Submit();
+    if (err != error::nil) {
+        return err;
+    }
+    if (m_completed != completed) {
+        timeoutMilliseconds = 0; // do not block when some operations have already finished
+    }
+    err = m_loop->RunOnce(timeoutMilliseconds);
+    if (err != error::nil) {
+        return err;
+    }
+    return Submit();
+}
+
+error EpollEngine::Run() {
+    while (!m_stopped) {
+        error err = RunOnce(-1);
+        if (err != error::nil) {
+            m_stopped = false;
+            return err;
+        }
+    }
+    m_stopped = false;
+    return error::nil;
+}
+
+void EpollEngine::Stop() {
+    m_stopped = true;
+    m_loop->Post([]() {}); // wake up the loop
+}
+
+} // namespace net
@@ -0,0 +1,771 @@
+#include "netlib/internal/io_engine.h"
+#if defined(__has_include)
+ #if __has_include(<linux/io_uring.h>)
+  #define NETLIB_HAVE_IO_URING
+ #endif
+#endif // defined(__has_include)
+
+#ifdef NETLIB_HAVE_IO_URING
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace net {
+
+static const unsigned int kDefaultQueueDepth = 256;
+static const unsigned int kDefaultBufferCount = 256;
+static const unsigned int kMaxBufferCount = 32768;
+static const size_t kDefaultBufferSize = 4096;
+static const uint16_t kBufferGroup = 0;
+static const uint64_t kIgnoredUserData = 0;
+
+template <typename T>
+static T loadAcquire(const T* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+static void storeRelease(T* p, T v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static unsigned int roundUpPow2(unsigned int n) {
+    unsigned int v = 1;
+    while (v < n) {
+        v <<= 1;
+    }
+    return v;
+}
+
+static bool toSockaddr(const std::string& addr, uint16_t port, struct sockaddr_in* dest) {
+    *dest = {};
+    dest->sin_family = AF_INET;
+    dest->sin_port = htons(port);
+    return inet_pton(AF_INET, addr.c_str(), &dest->sin_addr) == 1;
+}
+
+static error toError(int res) {
+    return error::wrap(etype::os, -res);
+}
+
+namespace {
+
+enum struct OpKind {
+    Accept,
+    AcceptMultishot,
+    Connect,
+    Recv,
+    RecvMultishot,
+    Send,
+    RecvFrom,
+    SendTo,
+    Wakeup,
+};
+
+struct Op {
+    OpKind Kind;
+    SocketFD FD;
+    IOEngine::AcceptCallback OnAccept;
+    IOEngine::ConnectCallback OnConnect;
+    IOEngine::IOCallback OnIO;
+    IOEngine::RecvCallback OnRecv;
+    IOEngine::RecvFromCallback OnRecvFrom;
+    char* Buf;
+    size_t Len;
+    struct sockaddr_in Addr;
+    socklen_t AddrLen;
+    struct msghdr Msg;
+    struct iovec Iov;
+};
+
+class URingEngine final : public IOEngine {
+public:
+    URingEngine() : m_ringFD(-1), m_wakeupFD(-1), m_closed(false), m_stopped(false),
+            m_sqPtr(nullptr), m_sqSize(0), m_sqes(nullptr), m_sqesSize(0), m_sqTail(0), m_sqSubmitted(0),
+            m_cqPtr(nullptr), m_cqSize(0),
+            m_bufRing(nullptr), m_bufRingSize(0), m_bufCount(0), m_bufSize(0), m_bufTail(0),
+            m_nextID(1), m_wakeupValue(0) {}
+    ~URingEngine() { Close(); }
+
+    error Init(const IOEngineConfig& config);
+
+    error Close();
+    IOEngineType Type() { return IOEngineType::IOUring; }
+    error Accept(const SocketFD& fd, const AcceptCallback& callback);
+    error AcceptMultishot(const SocketFD& fd, const AcceptCallback& callback);
+    error Connect(const std::string& addr, uint16_t port, const ConnectCallback& callback);
+    error Recv(const SocketFD& fd, char* buf, size_t len, const IOCallback& callback);
+    error RecvMultishot(const SocketFD& fd, const RecvCallback& callback);
+    error Send(const SocketFD& fd, const char* buf, size_t len, const IOCallback& callback);
+    error RecvFrom(const SocketFD& fd, char* buf, size_t len, const RecvFromCallback& callback);
+    error SendTo(const SocketFD& fd, const char* buf, size_t len,
+            const std::string& addr, uint16_t port, const IOCallback& callback);
+    error Cancel(const SocketFD& fd);
+    error Submit();
+    error RunOnce(int64_t timeoutMilliseconds);
+    error Run();
+    void Stop();
+    void Post(const std::function<void()>& task);
+
+private:
+    int m_ringFD;
+    int m_wakeupFD;
+    std::atomic<bool> m_closed;
+    std::atomic<bool> m_stopped;
+
+    // submission queue
+    void* m_sqPtr;
+    size_t m_sqSize;
+    unsigned* m_sqHeadPtr;
+    unsigned* m_sqTailPtr;
+    unsigned* m_sqArray;
+    unsigned m_sqMask;
+    unsigned m_sqEntries;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqesSize;
+    unsigned m_sqTail;
+    unsigned m_sqSubmitted;
+    // completion queue
+    void* m_cqPtr;
+    size_t m_cqSize;
+    unsigned* m_cqHeadPtr;
+    unsigned* m_cqTailPtr;
+    unsigned m_cqMask;
+    struct io_uring_cqe* m_cqes;
+    // provided buffers for RecvMultishot
+    struct io_uring_buf* m_bufRing;
+    size_t m_bufRingSize;
+    unsigned int m_bufCount;
+    size_t m_bufSize;
+    uint16_t m_bufTail;
+    std::vector<char> m_bufs;
+
+    uint64_t m_nextID;
+    std::unordered_map<uint64_t, std::unique_ptr<Op>> m_ops;
+    uint64_t m_wakeupValue;
+    std::mutex m_mutex;
+    std::vector<std::function<void()>> m_tasks;
+
+    error initBufferRing(unsigned int count, size_t size);
+    struct io_uring_sqe* getSQE();
+    error enter(unsigned int minComplete, int64_t timeoutMilliseconds);
+    error start(std::unique_ptr<Op> op);
+    bool prepare(uint64_t id, Op* op);
+    bool reap();
+    void complete(uint64_t id, int res, uint32_t flags);
+    void recycleBuffer(uint16_t bid);
+    void runTasks();
+};
+
+} // namespace
+
+error URingEngine::Init(const IOEngineConfig& config) {
+    unsigned int entries = (config.QueueDepth > 0) ? config.QueueDepth : kDefaultQueueDepth;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    m_ringFD = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (m_ringFD == -1 && errno == EINVAL) { // retry without the optional flags
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CLAMP;
+        m_ringFD = (int) syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (m_ringFD == -1) {
+        return (errno == ENOSYS) ? error::opnotsupp : error::wrap(etype::os, errno);
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        return error::opnotsupp;
+    }
+
+    m_sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+    }
+    m_sqPtr = mmap(nullptr, m_sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_ringFD, IORING_OFF_SQ_RING);
+    if (m_sqPtr == MAP_FAILED) {
+        m_sqPtr = nullptr;
+        return error::wrap(etype::os, errno);
+    }
+    if (singleMmap) {
+        m_cqPtr = m_sqPtr;
+    } else {
+        m_cqPtr = mmap(nullptr, m_cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_ringFD, IORING_OFF_CQ_RING);
+        if (m_cqPtr == MAP_FAILED) {
+            m_cqPtr = nullptr;
+            return error::wrap(etype::os, errno);
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_ringFD, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return error::wrap(etype::os, errno);
+    }
+    m_sqes = (struct io_uring_sqe*) sqes;
+
+    char* sq = (char*) m_sqPtr;
+    m_sqHeadPtr = (unsigned*) (sq + params.sq_off.head);
+    m_sqTailPtr = (unsigned*) (sq + params.sq_off.tail);
+    m_sqArray = (unsigned*) (sq + params.sq_off.array);
+    m_sqMask = *(unsigned*) (sq + params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+    m_sqTail = m_sqSubmitted = *m_sqTailPtr;
+    char* cq = (char*) m_cqPtr;
+    m_cqHeadPtr = (unsigned*) (cq + params.cq_off.head);
+    m_cqTailPtr = (unsigned*) (cq + params.cq_off.tail);
+    m_cqMask = *(unsigned*) (cq + params.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    unsigned int bufCount = (config.BufferCount > 0) ? config.BufferCount : kDefaultBufferCount;
+    size_t bufSize = (config.BufferSize > 0) ? config.BufferSize : kDefaultBufferSize;
+    // RecvMultishot is unavailable if the kernel does not support buffer rings
+    initBufferRing(std::min(roundUpPow2(bufCount), kMaxBufferCount), bufSize);
+
+    m_wakeupFD = eventfd(0, EFD_CLOEXEC);
+    if (m_wakeupFD == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    std::unique_ptr<Op> wakeup(new Op());
+    wakeup->Kind = OpKind::Wakeup;
+    wakeup->FD = m_wakeupFD;
+    return start(std::move(wakeup));
+}
+
+error URingEngine::initBufferRing(unsigned int count, size_t size) {
+    m_bufRingSize = count * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+        return error::wrap(etype::os, errno);
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) ring;
+    reg.ring_entries = count;
+    reg.bgid = kBufferGroup;
+    if (syscall(__NR_io_uring_register, m_ringFD, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        int err = errno;
+        munmap(ring, m_bufRingSize);
+        return error::wrap(etype::os, err);
+    }
+
+    m_bufRing = (struct io_uring_buf*) ring;
+    m_bufCount = count;
+    m_bufSize = size;
+    m_bufs.resize(count * size);
+    for (unsigned int i = 0; i < count; i++) {
+        recycleBuffer((uint16_t) i);
+    }
+    return error::nil;
+}
+
+void URingEngine::recycleBuffer(uint16_t bid) {
+    struct io_uring_buf* buf = &m_bufRing[m_bufTail & (m_bufCount - 1)];
+    buf->addr = (uint64_t) &m_bufs[bid * m_bufSize];
+    buf->len = (uint32_t) m_bufSize;
+    buf->bid = bid;
+    m_bufTail++;
+    // the tail of the ring overlays resv of the first entry;
+    // struct io_uring_buf_ring is not used since its flexible array member is laid out differently in C++
+    storeRelease(&m_bufRing[0].resv, m_bufTail);
+}
+
+error internal::newURingEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine) {
+    std::shared_ptr<URingEngine> uring = std::make_shared<URingEngine>();
+    error err = uring->Init(config);
+    if (err != error::nil) {
+        return err;
+    }
+    *engine = uring;
+    return error::nil;
+}
+
+error URingEngine::Close() {
+    if (m_closed) {
+        return error::nil;
+    }
+
+    for (auto& entry : m_ops) {
+        // the socket of a pending connect is owned by the engine until the callback
+        if (entry.second->Kind == OpKind::Connect) {
+            close(entry.second->FD);
+        }
+    }
+    m_ops.clear();
+    if (m_bufRing != nullptr) {
+        munmap(m_bufRing, m_bufRingSize);
+    }
+    if (m_sqes != nullptr) {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if (m_cqPtr != nullptr && m_cqPtr != m_sqPtr) {
+        munmap(m_cqPtr, m_cqSize);
+    }
+    if (m_sqPtr != nullptr) {
+        munmap(m_sqPtr, m_sqSize);
+    }
+    if (m_wakeupFD != -1) {
+        close(m_wakeupFD);
+    }
+    if (m_ringFD != -1 && close(m_ringFD) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    m_closed = true;
+    return error::nil;
+}
+
+struct io_uring_sqe* URingEngine::getSQE() {
+    if (m_sqTail - loadAcquire(m_sqHeadPtr) >= m_sqEntries) {
+        // the submission queue is full
+        if (enter(0, 0) != error::nil || m_sqTail - loadAcquire(m_sqHeadPtr) >= m_sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned index = m_sqTail & m_sqMask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    m_sqTail++;
+    return sqe;
+}
+
+error URingEngine::enter(unsigned int minComplete, int64_t timeoutMilliseconds) {
+    storeRelease(m_sqTailPtr, m_sqTail);
+    unsigned int toSubmit = m_sqTail - m_sqSubmitted;
+    if (toSubmit == 0 && minComplete == 0) {
+        return error::nil;
+    }
+
+    unsigned int flags = (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (minComplete > 0 && timeoutMilliseconds >= 0) {
+        ts.tv_sec = timeoutMilliseconds / 1000;
+        ts.tv_nsec = timeoutMilliseconds % 1000 * 1000000;
+        arg.ts = (uint64_t) &ts;
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+    int n = (int) syscall(__NR_io_uring_enter, m_ringFD, toSubmit, minComplete, flags, &arg, sizeof(arg));
+    if (n == -1) {
+        if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            return error::nil;
+        }
+        return error::wrap(etype::os, errno);
+    }
+    m_sqSubmitted += n;
+    return error::nil;
+}
+
+error URingEngine::start(std::unique_ptr<Op> op) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    uint64_t id = m_nextID++;
+    Op* p = op.get();
+    m_ops[id] = std::move(op);
+    if (!prepare(id, p)) {
+        m_ops.erase(id);
+        return error::nobufs;
+    }
+    return error::nil;
+}
+
+bool URingEngine::prepare(uint64_t id, Op* op) {
+    struct io_uring_sqe* sqe = getSQE();
+    if (sqe == nullptr) {
+        return false;
+    }
+    sqe->fd = op->FD;
+    sqe->user_data = id;
+    switch (op->Kind) {
+    case OpKind::Accept:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->addr = (uint64_t) &op->Addr;
+        op->AddrLen = sizeof(op->Addr);
+        sqe->addr2 = (uint64_t) &op->AddrLen;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        break;
+    case OpKind::AcceptMultishot:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        break;
+    case OpKind::Connect:
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->addr = (uint64_t) &op->Addr;
+        sqe->off = sizeof(op->Addr);
+        break;
+    case OpKind::Recv:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = (uint64_t) op->Buf;
+        sqe->len = (uint32_t) op->Len;
+        break;
+    case OpKind::RecvMultishot:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        break;
+    case OpKind::Send:
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uint64_t) op->Buf;
+        sqe->len = (uint32_t) op->Len;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        break;
+    case OpKind::RecvFrom:
+    case OpKind::SendTo:
+        op->Iov.iov_base = op->Buf;
+        op->Iov.iov_len = op->Len;
+        op->Msg.msg_name = &op->Addr;
+        op->Msg.msg_namelen = sizeof(op->Addr);
+        op->Msg.msg_iov = &op->Iov;
+        op->Msg.msg_iovlen = 1;
+        sqe->opcode = (op->Kind == OpKind::RecvFrom) ? IORING_OP_RECVMSG : IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t) &op->Msg;
+        sqe->len = 1;
+        break;
+    case OpKind::Wakeup:
+        sqe->opcode = IORING_OP_READ;
+        sqe->addr = (uint64_t) &m_wakeupValue;
+        sqe->len = sizeof(m_wakeupValue);
+        break;
+    }
+    return true;
+}
+
+error URingEngine::Accept(const SocketFD& fd, const AcceptCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::Accept;
+    op->FD = fd;
+    op->OnAccept = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::AcceptMultishot(const SocketFD& fd, const AcceptCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::AcceptMultishot;
+    op->FD = fd;
+    op->OnAccept = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::Connect(const std::string& addr, uint16_t port, const ConnectCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    if (!toSockaddr(addr, port, &op->Addr)) {
+        return error::illegal_argument;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    op->Kind = OpKind::Connect;
+    op->FD = fd;
+    op->OnConnect = callback;
+    error err = start(std::move(op));
+    if (err != error::nil) {
+        close(fd);
+    }
+    return err;
+}
+
+error URingEngine::Recv(const SocketFD& fd, char* buf, size_t len, const IOCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::Recv;
+    op->FD = fd;
+    op->Buf = buf;
+    op->Len = len;
+    op->OnIO = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::RecvMultishot(const SocketFD& fd, const RecvCallback& callback) {
+    if (m_bufRing == nullptr) {
+        return error::opnotsupp;
+    }
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::RecvMultishot;
+    op->FD = fd;
+    op->OnRecv = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::Send(const SocketFD& fd, const char* buf, size_t len, const IOCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::Send;
+    op->FD = fd;
+    op->Buf = const_cast<char*>(buf);
+    op->Len = len;
+    op->OnIO = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::RecvFrom(const SocketFD& fd, char* buf, size_t len, const RecvFromCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    op->Kind = OpKind::RecvFrom;
+    op->FD = fd;
+    op->Buf = buf;
+    op->Len = len;
+    op->OnRecvFrom = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::SendTo(const SocketFD& fd, const char* buf, size_t len,
+        const std::string& addr, uint16_t port, const IOCallback& callback) {
+    std::unique_ptr<Op> op(new Op());
+    if (!toSockaddr(addr, port, &op->Addr)) {
+        return error::illegal_argument;
+    }
+    op->Kind = OpKind::SendTo;
+    op->FD = fd;
+    op->Buf = const_cast<char*>(buf);
+    op->Len = len;
+    op->OnIO = callback;
+    return start(std::move(op));
+}
+
+error URingEngine::Cancel(const SocketFD& fd) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct io_uring_sqe* sqe = getSQE();
+    if (sqe == nullptr) {
+        return error::nobufs;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = kIgnoredUserData;
+    return error::nil;
+}
+
+error URingEngine::Submit() {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    return enter(0, 0);
+}
+
+bool URingEngine::reap() {
+    bool reaped = false;
+    unsigned head = *m_cqHeadPtr;
+    while (head != loadAcquire(m_cqTailPtr)) {
+        const struct io_uring_cqe* cqe = &m_cqes[head & m_cqMask];
+        uint64_t id = cqe->user_data;
+        int res = cqe->res;
+        uint32_t flags = cqe->flags;
+        head++;
+        storeRelease(m_cqHeadPtr, head); // free the slot before the callback submits more
+        if (id != kIgnoredUserData) {
+            complete(id, res, flags);
+        }
+        reaped = true;
+    }
+    return reaped;
+}
+
+void URingEngine::complete(uint64_t id, int res, uint32_t flags) {
+    auto it = m_ops.find(id);
+    if (it == m_ops.end()) {
+        return;
+    }
+    Op* op = it->second.get();
+    bool more = flags & IORING_CQE_F_MORE;
+
+    switch (op->Kind) {
+    case OpKind::Accept: {
+        std::unique_ptr<Op> done = std::move(it->second);
+        m_ops.erase(it);
+        if (res < 0) {
+            done->OnAccept(toError(res), nullptr);
+        } else {
+            done->OnAccept(error::nil, std::make_shared<TCPSocket>(res,
+                    done->Addr.sin_addr.s_addr, ntohs(done->Addr.sin_port), false));
+        }
+        return;
+    }
+    case OpKind::AcceptMultishot: {
+        if (res < 0) {
+            std::unique_ptr<Op> done = std::move(it->second);
+            m_ops.erase(it);
+            done->OnAccept(toError(res), nullptr);
+            return;
+        }
+        struct sockaddr_in addr = {0};
+        socklen_t addrlen = sizeof(addr);
+        getpeername(res, (struct sockaddr*) &addr, &addrlen);
+        AcceptCallback callback = op->OnAccept;
+        bool armed = more || prepare(id, op); // rearm if the kernel has stopped accepting
+        if (!armed) {
+            m_ops.erase(id);
+        }
+        callback(error::nil, std::make_shared<TCPSocket>(res, addr.sin_addr.s_addr, ntohs(addr.sin_port), false));
+        if (!armed) {
+            callback(error::nobufs, nullptr);
+        }
+        return;
+    }
+    case OpKind::Connect: {
+        std::unique_ptr<Op> done = std::move(it->second);
+        m_ops.erase(it);
+        if (res < 0) {
+            close(done->FD);
+            done->OnConnect(toError(res), nullptr);
+        } else {
+            done->OnConnect(error::nil, std::make_shared<TCPSocket>(done->FD,
+                    done->Addr.sin_addr.s_addr, ntohs(done->Addr.sin_port), false));
+        }
+        return;
+    }
+    case OpKind::Recv:
+    case OpKind::Send: {
+        std::unique_ptr<Op> done = std::move(it->second);
+        m_ops.erase(it);
+        if (res < 0) {
+            done->OnIO(toError(res), 0);
+        } else if (res == 0 && done->Kind == OpKind::Recv && done->Len > 0) {
+            done->OnIO(error::eof, 0);
+        } else {
+            done->OnIO(error::nil, res);
+        }
+        return;
+    }
+    case OpKind::RecvMultishot: {
+        if (res == -ENOBUFS && prepare(id, op)) {
+            return; // all buffers were in use, so retry when some are recycled
+        }
+        if (res <= 0) {
+            std::unique_ptr<Op> done = std::move(it->second);
+            m_ops.erase(it);
+            done->OnRecv((res == 0) ? error::eof : toError(res), nullptr, 0);
+            return;
+        }
+        uint16_t bid = (uint16_t) (flags >> IORING_CQE_BUFFER_SHIFT);
+        RecvCallback callback = op->OnRecv;
+        bool armed = more || prepare(id, op);
+        if (!armed) {
+            m_ops.erase(id);
+        }
+        callback(error::nil, &m_bufs[bid * m_bufSize], res);
+        recycleBuffer(bid);
+        if (!armed) {
+            callback(error::nobufs, nullptr, 0);
+        }
+        return;
+    }
+    case OpKind::RecvFrom: {
+        std::unique_ptr<Op> done = std::move(it->second);
+        m_ops.erase(it);
+        if (res < 0) {
+            done->OnRecvFrom(toError(res), 0, "", 0);
+        } else {
+            done->OnRecvFrom(error::nil, res, inet_ntoa(done->Addr.sin_addr), ntohs(done->Addr.sin_port));
+        }
+        return;
+    }
+    case OpKind::SendTo: {
+        std::unique_ptr<Op> done = std::move(it->second);
+        m_ops.erase(it);
+        done->OnIO((res < 0) ? toError(res) : error::nil, (res < 0) ? 0 : res);
+        return;
+    }
+    case OpKind::Wakeup:
+        prepare(id, op);
+        runTasks();
+        return;
+    }
+}
+
+error URingEngine::RunOnce(int64_t timeoutMilliseconds) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (reap()) {
+        return enter(0, 0);
+    }
+    error err = enter(1, timeoutMilliseconds);
+    if (err != error::nil) {
+        return err;
+    }
+    reap();
+    return enter(0, 0);
+}
+
+error URingEngine::Run() {
+    while (!m_stopped) {
+        error err = RunOnce(-1);
+        if (err != error::nil) {
+            m_stopped = false;
+            return err;
+        }
+    }
+    m_stopped = false;
+    return error::nil;
+}
+
+void URingEngine::Stop() {
+    m_stopped = true;
+    uint64_t one = 1;
+    write(m_wakeupFD, &one, sizeof(one));
+}
+
+void URingEngine::Post(const std::function<void()>& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(task);
+    }
+    uint64_t one = 1;
+    write(m_wakeupFD, &one, sizeof(one));
+}
+
+void URingEngine::runTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tasks.swap(m_tasks);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+} // namespace net
+
+#else // NETLIB_HAVE_IO_URING
+
+namespace net {
+
+error internal::newURingEngine(const IOEngineConfig& config, std::shared_ptr<IOEngine>* engine) {
+    return error::opnotsupp;
+}
+
+} // namespace net
+
+#endif // NETLIB_HAVE_IO_URING
@@ -0,0 +1,240 @@
+#include "netlib/iobuf.h"
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace net {
+
+IOBuf::IOBuf() : m_length(0) {}
+
+IOBuf::IOBuf(size_t capacity, size_t headroom) : m_length(0) {
+    if (headroom > capacity) {
+        assert(0 && "headroom must not exceed capacity");
+        headroom = capacity;
+    }
+    m_segments.push_back(newSegment(capacity, headroom));
+}
+
+IOBuf::IOBuf(const char* buf, size_t len, size_t headroom) : IOBuf(headroom + len, headroom) {
+    Append(buf, len);
+}
+
+IOBuf::IOBuf(IOBuf&& other) : m_segments(std::move(other.m_segments)), m_length(other.m_length) {
+    other.m_segments.clear();
+    other.m_length = 0;
+}
+
+IOBuf& IOBuf::operator=(IOBuf&& other) {
+    if (this != &other) {
+        m_segments = std::move(other.m_segments);
+        m_length = other.m_length;
+        other.m_segments.clear();
+        other.m_length = 0;
+    }
+    return *this;
+}
+
+IOBuf::Segment IOBuf::newSegment(size_t capacity, size_t offset) {
+    std::shared_ptr<Block> block = std::make_shared<Block>();
+    block->Data.reset(new char[capacity]);
+    block->Capacity = capacity;
+    Segment seg = {block, offset, 0};
+    return seg;
+}
+
+size_t IOBuf::Headroom() const {
+    if (m_segments.empty() || m_segments.front().Memory.use_count() > 1) {
+        return 0;
+    }
+    return m_segments.front().Offset;
+}
+
+size_t IOBuf::Tailroom() const {
+    if (m_segments.empty() || m_segments.back().Memory.use_count() > 1) {
+        return 0;
+    }
+    const Segment& seg = m_segments.back();
+    return seg.Memory->Capacity - seg.Offset - seg.Length;
+}
+
+char* IOBuf::PrependSpace(size_t len) {
+    if (m_segments.empty() || Headroom() < len) {
+        if (!m_segments.empty() && m_segments.front().Length == 0) {
+            m_segments.pop_front();
+        }
+        // leave headroom in the new block for the headers prepended later
+        size_t capacity = (len > kDefaultCapacity) ? len : kDefaultCapacity;
+        m_segments.push_front(newSegment(capacity, capacity));
+    }
+    Segment& seg = m_segments.front();
+    seg.Offset -= len;
+    seg.Length += len;
+    m_length += len;
+    return seg.Memory->Data.get() + seg.Offset;
+}
+
+char* IOBuf::AppendSpace(size_t len) {
+    if (m_segments.empty() || Tailroom() < len) {
+        if (!m_segments.empty() && m_segments.back().Length == 0) {
+            m_segments.pop_back();
+        }
+        size_t capacity = (len > kDefaultCapacity) ? len : kDefaultCapacity;
+        m_segments.push_back(newSegment(capacity, 0));
+    }
+    Segment& seg = m_segments.back();
+    char* p = seg.Memory->Data.get() + seg.Offset + seg.Length;
+    seg.Length += len;
+    m_length += len;
+    return p;
+}
+
+void IOBuf::Prepend(const char* buf, size_t len) {
+    if (buf == nullptr && len > 0) {
+        assert(0 && "buf must not be nullptr");
+        return;
+    }
+    if (len > 0) {
+        memcpy(PrependSpace(len), buf, len);
+    }
+}
+
+void IOBuf::Append(const char* buf, size_t len) {
+    if (buf == nullptr && len > 0) {
+        assert(0 && "buf must not be nullptr");
+        return;
+    }
+    if (len > 0) {
+        memcpy(AppendSpace(len), buf, len);
+    }
+}
+
+void IOBuf::Append(const IOBuf& other) {
+    if (&other == this) {
+        IOBuf copy = other;
+        Append(copy);
+        return;
+    }
+    for (const Segment& seg : other.m_segments) {
+        if (seg.Length > 0) {
+            m_segments.push_back(seg);
+        }
+    }
+    m_length += other.m_length;
+}
+
+void IOBuf::TrimStart(size_t len) {
+    if (len > m_length) {
+        assert(0 && "len must not exceed the length");
+        len = m_length;
+    }
+    m_length -= len;
+    while (len > 0) {
+        Segment& seg = m_segments.front();
+        if (len < seg.Length) {
+            seg.Offset += len;
+            seg.Length -= len;
+            return;
+        }
+        len -= seg.Length;
+        m_segments.pop_front();
+    }
+}
+
+void IOBuf::TrimEnd(size_t len) {
+    if (len > m_length) {
+        assert(0 && "len must not exceed the length");
+        len = m_length;
+    }
+    m_length -= len;
+    while (len > 0) {
+        Segment& seg = m_segments.back();
+        if (len < seg.Length) {
+            seg.Length -= len;
+            return;
+        }
+        len -= seg.Length;
+        m_segments.pop_back();
+    }
+}
+
+IOBuf IOBuf::Slice(size_t offset, size_t len) const {
+    IOBuf slice;
+    if (offset > m_length) {
+        assert(0 && "offset must not exceed the length");
+        return slice;
+    }
+    if (len > m_length - offset) {
+        assert(0 && "len must not exceed the length");
+        len = m_length - offset;
+    }
+    for (const Segment& seg : m_segments) {
+        if (len == 0) {
+            break;
+        }
+        if (offset >= seg.Length) {
+            offset -= seg.Length;
+            continue;
+        }
+        size_t n = (len < seg.Length - offset) ? len : seg.Length - offset;
+        Segment part = {seg.Memory, seg.Offset + offset, n};
+        slice.m_segments.push_back(part);
+        slice.m_length += n;
+        offset = 0;
+        len -= n;
+    }
+    return slice;
+}
+
+size_t IOBuf::CopyTo(size_t offset, char* buf, size_t len) const {
+    if (buf == nullptr && len > 0) {
+        assert(0 && "buf must not be nullptr");
+        return 0;
+    }
+
+    size_t copied = 0;
+    for (const Segment& seg : m_segments) {
+        if (copied == len) {
+            break;
+        }
+        if (offset >= seg.Length) {
+            offset -= seg.Length;
+            continue;
+        }
+        size_t n = (len - copied < seg.Length - offset) ? len - copied : seg.Length - offset;
+        memcpy(&buf[copied], seg.Memory->Data.get() + seg.Offset + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+const char* IOBuf::Coalesce() {
+    if (m_length == 0) {
+        return nullptr;
+    }
+    if (m_segments.size() > 1) {
+        Segment seg = newSegment(m_length, 0);
+        CopyTo(0, seg.Memory->Data.get(), m_length);
+        seg.Length = m_length;
+        m_segments.clear();
+        m_segments.push_back(seg);
+    }
+    const Segment& seg = m_segments.front();
+    return seg.Memory->Data.get() + seg.Offset;
+}
+
+void IOBuf::ToIOVecs(std::vector<IOVec>* iov) const {
+    if (iov == nullptr) {
+        assert(0 && "iov must not be nullptr");
+        return;
+    }
+
+    for (const Segment& seg : m_segments) {
+        if (seg.Length > 0) {
+            IOVec v = {seg.Memory->Data.get() + seg.Offset, seg.Length};
+            iov->push_back(v);
+        }
+    }
+}
+
+} // namespace net
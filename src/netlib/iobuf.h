@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "netlib/stream.h"
+
+namespace net {
+
+/**
+ * A chain of reference-counted memory blocks.
+ * Copies, slices and chains of a buffer share the blocks instead of copying the bytes,
+ * and a block is freed with the last buffer which refers to it.
+ * A shared block is never written, so a buffer can be modified without affecting the others.
+ * Not thread-safe, but the buffers sharing blocks can be used on different threads.
+ */
+class IOBuf final {
+public:
+    static const size_t kDefaultCapacity = 4096;
+
+    IOBuf();
+    /**
+     * Create an empty buffer.
+     *
+     * @param[in] capacity The size of the first block
+     * @param[in] headroom The room at the front of the first block reserved for Prepend
+     */
+    IOBuf(size_t capacity, size_t headroom);
+    /**
+     * Create a buffer with a copy of the bytes.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] headroom The room reserved for Prepend
+     */
+    IOBuf(const char* buf, size_t len, size_t headroom = 0);
+    ~IOBuf() = default;
+    IOBuf(const IOBuf&) = default;
+    IOBuf& operator=(const IOBuf&) = default;
+    /**
+     * Leave other empty.
+     */
+    IOBuf(IOBuf&& other);
+    IOBuf& operator=(IOBuf&& other);
+
+    /**
+     * @return the number of bytes in the whole chain
+     */
+    size_t Length() const { return m_length; }
+    bool Empty() const { return m_length == 0; }
+    size_t CountSegments() const { return m_segments.size(); }
+    /**
+     * @return the number of bytes which can be prepended without allocation
+     */
+    size_t Headroom() const;
+    /**
+     * @return the number of bytes which can be appended without allocation
+     */
+    size_t Tailroom() const;
+
+    /**
+     * Grow the buffer at the front, allocating a block if there is not enough headroom.
+     *
+     * @param[in] len
+     * @return the contiguous len bytes to be filled by the caller
+     */
+    char* PrependSpace(size_t len);
+    /**
+     * Grow the buffer at the back, allocating a block if there is not enough tailroom.
+     *
+     * @param[in] len
+     * @return the contiguous len bytes to be filled by the caller
+     */
+    char* AppendSpace(size_t len);
+    void Prepend(const char* buf, size_t len);
+    void Append(const char* buf, size_t len);
+    /**
+     * Chain the blocks of other after this buffer without copying.
+     */
+    void Append(const IOBuf& other);
+    /**
+     * Remove bytes from the front.
+     */
+    void TrimStart(size_t len);
+    /**
+     * Remove bytes from the back.
+     */
+    void TrimEnd(size_t len);
+
+    /**
+     * @param[in] offset
+     * @param[in] len
+     * @return a buffer which shares the range of bytes with this buffer
+     */
+    IOBuf Slice(size_t offset, size_t len) const;
+    /**
+     * @param[in] offset
+     * @param[out] buf
+     * @param[in] len
+     * @return the number of bytes copied, which is less than len at the end of the buffer
+     */
+    size_t CopyTo(size_t offset, char* buf, size_t len) const;
+    /**
+     * Copy the chain into a single block if it has more than one.
+     *
+     * @return the first byte, or nullptr if the buffer is empty
+     */
+    const char* Coalesce();
+    /**
+     * Append a buffer per segment for Writer::WriteFullV. Valid while this buffer is unchanged.
+     *
+     * @param[out] iov
+     */
+    void ToIOVecs(std::vector<IOVec>* iov) const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> Data;
+        size_t Capacity;
+    };
+    struct Segment {
+        std::shared_ptr<Block> Memory;
+        size_t Offset;
+        size_t Length;
+    };
+
+    std::deque<Segment> m_segments;
+    size_t m_length;
+
+    static Segment newSegment(size_t capacity, size_t offset);
+};
+
+} // namespace net
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "netlib/error.h"
+#include "netlib/event_loop.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+#include "netlib/timer.h"
+
+namespace net {
+
+/**
+ * Called once on the loop thread when the relay has finished: with error::nil after both
+ * directions have reached end of file, error::timedout after the idle timeout,
+ * ECANCELED on Close, or the error of either socket.
+ */
+using RelayHandler = std::function<void(const error& err)>;
+
+struct RelayConfig {
+    /** Finish the relay when no byte has been moved in either direction for this long. Never if 0 is specified. */
+    int64_t IdleTimeoutMilliseconds;
+    /** The capacity of each pipe, set with F_SETPIPE_SZ. The system default (64 KB) if 0 is specified. */
+    size_t PipeSize;
+};
+
+/**
+ * Moves bytes between two TCP sockets in both directions on an EventLoop.
+ * Each direction splices the bytes through a pipe, so that they never enter user space.
+ * End of file is passed on to the other socket by CloseWrite,
+ * while the opposite direction goes on until its end of file.
+ *
+ * The relay keeps itself alive until it finishes, and then closes both sockets.
+ * Close must be called on the loop thread.
+ */
+class Relay final : public Closer, public std::enable_shared_from_this<Relay> {
+public:
+    Relay(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& a,
+            const std::shared_ptr<TCPSocket>& b, const RelayConfig& config, const RelayHandler& handler);
+    ~Relay();
+    Relay(const Relay&) = delete;
+    Relay& operator=(const Relay&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Stop relaying, close both sockets, and call the handler with ECANCELED.
+     */
+    error Close();
+    /**
+     * @return the number of bytes which have been written to b. May be called from any thread.
+     */
+    uint64_t BytesAToB() { return m_aToB.Bytes; }
+    /**
+     * @return the number of bytes which have been written to a. May be called from any thread.
+     */
+    uint64_t BytesBToA() { return m_bToA.Bytes; }
+
+private:
+    friend error NewRelay(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& a,
+            const std::shared_ptr<TCPSocket>& b, const RelayConfig& config, const RelayHandler& handler,
+            std::shared_ptr<Relay>* relay);
+
+    struct Direction {
+        std::shared_ptr<TCPSocket> Src;
+        std::shared_ptr<TCPSocket> Dst;
+        int Pipe[2];
+        size_t Buffered; // in the pipe
+        bool SrcEOF;
+        bool Done;
+        std::atomic<uint64_t> Bytes;
+    };
+
+    const std::shared_ptr<EventLoop> m_loop;
+    const RelayConfig m_config;
+    const RelayHandler m_handler;
+    std::atomic<bool> m_closed;
+    std::shared_ptr<Relay> m_self; // held until the relay finishes
+    Direction m_aToB;
+    Direction m_bToA;
+    size_t m_pipeSize;
+    int64_t m_lastActive;
+    TimerID m_idleTimer;
+
+    error openPipe(Direction* dir);
+    error pump(Direction* dir);
+    void onReady(Direction* dir);
+    void checkIdle();
+    void finish(const error& err);
+};
+
+/**
+ * Start relaying between a and b, which are switched to non-blocking mode and registered to loop.
+ *
+ * @param[in] loop
+ * @param[in] a
+ * @param[in] b
+ * @param[in] config
+ * @param[in] handler Called when the relay has finished
+ * @param[out] relay
+ */
+error NewRelay(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& a,
+        const std::shared_ptr<TCPSocket>& b, const RelayConfig& config, const RelayHandler& handler,
+        std::shared_ptr<Relay>* relay);
+
+} // namespace net
@@ -0,0 +1,257 @@
+#include "netlib/relay.h"
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include "netlib/internal/init.h"
+
+namespace net {
+
+static const size_t kDefaultPipeSize = 64 * 1024;
+
+static int64_t monotonicMilliseconds() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void closePipe(int pipe[2]) {
+    for (int i = 0; i < 2; i++) {
+        if (pipe[i] != -1) {
+            close(pipe[i]);
+            pipe[i] = -1;
+        }
+    }
+}
+
+Relay::Relay(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& a,
+        const std::shared_ptr<TCPSocket>& b, const RelayConfig& config, const RelayHandler& handler)
+        : m_loop(loop), m_config(config), m_handler(handler), m_closed(false),
+          m_pipeSize(kDefaultPipeSize), m_lastActive(monotonicMilliseconds()), m_idleTimer(0) {
+    Direction* dirs[] = {&m_aToB, &m_bToA};
+    for (Direction* dir : dirs) {
+        dir->Pipe[0] = dir->Pipe[1] = -1;
+        dir->Buffered = 0;
+        dir->SrcEOF = false;
+        dir->Done = false;
+        dir->Bytes = 0;
+    }
+    m_aToB.Src = m_bToA.Dst = a;
+    m_aToB.Dst = m_bToA.Src = b;
+}
+
+Relay::~Relay() {
+    closePipe(m_aToB.Pipe);
+    closePipe(m_bToA.Pipe);
+}
+
+error Relay::Close() {
+    finish(error::wrap(etype::os, ECANCELED));
+    return error::nil;
+}
+
+error Relay::openPipe(Direction* dir) {
+    if (pipe2(dir->Pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (m_config.PipeSize > 0 && fcntl(dir->Pipe[1], F_SETPIPE_SZ, (int) m_config.PipeSize) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    int size = fcntl(dir->Pipe[1], F_GETPIPE_SZ);
+    if (size > 0) {
+        m_pipeSize = size;
+    }
+    return error::nil;
+}
+
+error Relay::pump(Direction* dir) {
+    const unsigned int flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+    while (!dir->Done) {
+        // drain the pipe first, so that an empty socket is told apart from a full pipe
+        while (dir->Buffered > 0) {
+            ssize_t size = splice(dir->Pipe[0], nullptr, dir->Dst->FD(), nullptr, dir->Buffered, flags);
+            if (size == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) { // wait until Dst becomes writable
+                    return error::nil;
+                }
+                return error::wrap(etype::os, errno);
+            }
+            dir->Buffered -= size;
+            dir->Bytes += size;
+            m_lastActive = monotonicMilliseconds();
+        }
+        if (dir->SrcEOF) {
+            dir->Done = true;
+            return dir->Dst->CloseWrite();
+        }
+
+        ssize_t size = splice(dir->Src->FD(), nullptr, dir->Pipe[1], nullptr, m_pipeSize, flags);
+        if (size == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) { // wait until Src becomes readable
+                return error::nil;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        if (size == 0) {
+            dir->SrcEOF = true;
+            continue;
+        }
+        dir->Buffered += size;
+    }
+    return error::nil;
+}
+
+void Relay::onReady(Direction* dir) {
+    if (m_closed) {
+        return;
+    }
+    error err = pump(dir);
+    if (err != error::nil) {
+        finish(err);
+        return;
+    }
+    if (m_aToB.Done && m_bToA.Done) {
+        finish(error::nil);
+    }
+}
+
+void Relay::checkIdle() {
+    m_idleTimer = 0;
+    int64_t idle = monotonicMilliseconds() - m_lastActive;
+    if (idle >= m_config.IdleTimeoutMilliseconds) {
+        finish(error::timedout);
+        return;
+    }
+    std::weak_ptr<Relay> weak = shared_from_this();
+    m_idleTimer = m_loop->RunAfter(m_config.IdleTimeoutMilliseconds - idle, [weak]() {
+        std::shared_ptr<Relay> self = weak.lock();
+        if (self != nullptr && !self->m_closed) {
+            self->checkIdle();
+        }
+    });
+}
+
+void Relay::finish(const error& err) {
+    if (m_closed.exchange(true)) {
+        return;
+    }
+    std::shared_ptr<Relay> self = std::move(m_self); // released on return
+
+    if (m_idleTimer != 0) {
+        m_loop->CancelTimer(m_idleTimer);
+        m_idleTimer = 0;
+    }
+    if (!m_loop->IsClosed()) {
+        m_loop->Remove(m_aToB.Src->FD()); // error::not_found if the loop has dropped the fd
+        m_loop->Remove(m_bToA.Src->FD());
+    }
+    closePipe(m_aToB.Pipe);
+    closePipe(m_bToA.Pipe);
+    m_aToB.Src->Close();
+    m_bToA.Src->Close();
+    if (m_handler) {
+        m_handler(err);
+    }
+}
+
+error NewRelay(const std::shared_ptr<EventLoop>& loop, const std::shared_ptr<TCPSocket>& a,
+        const std::shared_ptr<TCPSocket>& b, const RelayConfig& config, const RelayHandler& handler,
+        std::shared_ptr<Relay>* relay) {
+    if (loop == nullptr) {
+        assert(0 && "loop must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (a == nullptr || b == nullptr) {
+        assert(0 && "a and b must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (relay == nullptr) {
+        assert(0 && "relay must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    std::shared_ptr<Relay> r = std::make_shared<Relay>(loop, a, b, config, handler);
+    r->m_closed = true; // the sockets are left open to the caller until registered
+    error err = r->openPipe(&r->m_aToB);
+    if (err != error::nil) {
+        return err;
+    }
+    err = r->openPipe(&r->m_bToA);
+    if (err != error::nil) {
+        return err;
+    }
+    err = a->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+    err = b->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+
+    std::weak_ptr<Relay> weak = r;
+    auto onReady = [weak](bool aToB) {
+        std::shared_ptr<Relay> self = weak.lock();
+        if (self != nullptr) {
+            self->onReady(aToB ? &self->m_aToB : &self->m_bToA);
+        }
+    };
+    auto onClosed = [weak](const error& err) {
+        std::shared_ptr<Relay> self = weak.lock();
+        if (self == nullptr) {
+            return;
+        }
+        if (err != error::nil) {
+            self->finish(err);
+            return;
+        }
+        // hung up after both ends have shut down; the other socket may still wait for the rest
+        self->onReady(&self->m_aToB);
+        self->onReady(&self->m_bToA);
+    };
+    EventHandler handlerA;
+    handlerA.OnReadable = std::bind(onReady, true);
+    handlerA.OnWritable = std::bind(onReady, false);
+    handlerA.OnClosed = onClosed;
+    EventHandler handlerB;
+    handlerB.OnReadable = std::bind(onReady, false);
+    handlerB.OnWritable = std::bind(onReady, true);
+    handlerB.OnClosed = onClosed;
+
+    r->m_closed = false;
+    r->m_self = r;
+    err = loop->Add(a->FD(), handlerA);
+    if (err != error::nil) {
+        r->m_closed = true;
+        r->m_self = nullptr;
+        return err;
+    }
+    err = loop->Add(b->FD(), handlerB);
+    if (err != error::nil) {
+        loop->Remove(a->FD());
+        r->m_closed = true;
+        r->m_self = nullptr;
+        return err;
+    }
+
+    if (config.IdleTimeoutMilliseconds > 0) {
+        loop->Post([weak]() { // timers are managed on the loop thread
+            std::shared_ptr<Relay> self = weak.lock();
+            if (self != nullptr && !self->m_closed) {
+                self->checkIdle();
+            }
+        });
+    }
+    *relay = std::move(r);
+    return error::nil;
+}
+
+} // namespace net
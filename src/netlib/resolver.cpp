@@ -1,4 +1,5 @@
 #include "netlib/resolver.h"
+#include <algorithm>
 #include <cassert>
 #if defined(_WIN32) || defined(_WIN64)
  #include <winsock2.h>
@@ -38,6 +39,56 @@ error LookupAddress(const std::string& host, std::string* addr) {
     return error::nil;
 }
 
+error LookupAddresses(const std::string& host, std::vector<std::string>* addrs) {
+    if (addrs == nullptr) {
+        assert(0 && "addrs must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    struct addrinfo* result;
+    struct addrinfo hints = {0};
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_family = AF_UNSPEC;
+
+    int err = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (err != 0) {
+        return error::wrap(etype::netdb, err);
+    }
+    std::vector<std::string> families[2]; // in the order of the family of the first result
+    int firstFamily = result->ai_family;
+    for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        char buf[INET6_ADDRSTRLEN] = {0};
+        if (ai->ai_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in*) ai->ai_addr)->sin_addr, buf, sizeof(buf));
+        } else if (ai->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6*) ai->ai_addr)->sin6_addr, buf, sizeof(buf));
+        } else {
+            continue;
+        }
+        std::vector<std::string>& list = families[(ai->ai_family == firstFamily) ? 0 : 1];
+        if (std::find(list.begin(), list.end(), buf) == list.end()) {
+            list.push_back(buf);
+        }
+    }
+    freeaddrinfo(result);
+
+    addrs->clear();
+    for (size_t i = 0; i < families[0].size() || i < families[1].size(); i++) {
+        if (i < families[0].size()) {
+            addrs->push_back(families[0][i]);
+        }
+        if (i < families[1].size()) {
+            addrs->push_back(families[1][i]);
+        }
+    }
+    if (addrs->empty()) {
+        return error::not_found;
+    }
+    return error::nil;
+}
+
 error LookupPort(const SocketFD& fd, uint16_t* port) {
     if (port == nullptr) {
         assert(0 && "port must not be nullptr");
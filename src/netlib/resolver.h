@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 #include "netlib/error.h"
 #include "netlib/fd.h"
 
@@ -13,6 +14,15 @@ namespace net {
  */
 error LookupAddress(const std::string& host, std::string* addr);
 
+/**
+ * Look up all IPv4 and IPv6 addresses of host.
+ * The families are interleaved, starting with the one preferred by the system.
+ *
+ * @param[in] host
+ * @param[out] addrs
+ */
+error LookupAddresses(const std::string& host, std::vector<std::string>* addrs);
+
 /**
  * @param[in] fd
  * @param[out] port
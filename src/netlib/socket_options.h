@@ -0,0 +1,62 @@
+#pragma once
+
+namespace net {
+
+/**
+ * Options set on a socket right after it is created, before it is bound or connected,
+ * so that the options which only matter at the handshake take effect.
+ * A value-initialized SocketOptions{} keeps the system defaults.
+ * The options which the platform lacks are ignored, and the TCP ones on a UDP socket.
+ * Accepted sockets inherit most of the options of their listener.
+ */
+struct SocketOptions {
+    /** TCP_NODELAY */
+    bool NoDelay;
+    /** SO_RCVBUF in bytes. Kept if 0, which leaves the buffer autotuned on Linux. */
+    int ReceiveBufferSize;
+    /** SO_SNDBUF in bytes. Kept if 0. */
+    int SendBufferSize;
+    /** TCP_QUICKACK (Linux) */
+    bool QuickAck;
+    /** TCP_NOTSENT_LOWAT in bytes (Linux, macOS). Kept if 0. */
+    int NotSentLowWatermark;
+    /** SO_BUSY_POLL in microseconds (Linux), which requires CAP_NET_ADMIN. Kept if 0. */
+    int BusyPollMicroseconds;
+    /** The backlog of a listener. SOMAXCONN if 0. */
+    int Backlog;
+    /**
+     * The queue length of TCP_FASTOPEN on a listener (Linux, macOS), which accepts data in a SYN
+     * from the clients holding a cookie. Disabled if 0. The server bit of
+     * the net.ipv4.tcp_fastopen sysctl is required on Linux.
+     */
+    int FastOpenQueueLength;
+    /** SO_REUSEPORT, by which sockets bound to the same port share its traffic (Linux, BSD) */
+    bool ReusePort;
+
+    /**
+     * For request/response traffic: segments are sent and acknowledged without delay,
+     * and little unsent data is queued in the kernel.
+     */
+    static SocketOptions LowLatency() {
+        SocketOptions options = SocketOptions();
+        options.NoDelay = true;
+        options.QuickAck = true;
+        options.NotSentLowWatermark = 16 * 1024;
+        return options;
+    }
+
+    /**
+     * For bulk transfers: segments are coalesced, and the buffers are large.
+     * The buffers are left to autotuning on Linux, which grows them further than SO_RCVBUF may.
+     */
+    static SocketOptions BulkThroughput() {
+        SocketOptions options = SocketOptions();
+#ifndef __linux__
+        options.ReceiveBufferSize = 4 * 1024 * 1024;
+        options.SendBufferSize = 4 * 1024 * 1024;
+#endif // __linux__
+        return options;
+    }
+};
+
+} // namespace net
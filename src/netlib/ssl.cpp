@@ -1,5 +1,6 @@
 #include "netlib/ssl.h"
 #include <cassert>
+#include <cerrno>
 #include <mutex>
 #include <openssl/crypto.h>
 #include <openssl/err.h>
@@ -76,6 +77,12 @@ exit:
 error ConnectSSL(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
         const SSLConfig& config,
         std::shared_ptr<SSLSocket>* clientSock) {
+    return ConnectSSL(host, port, timeoutMilliseconds, config, SocketOptions(), clientSock);
+}
+
+error ConnectSSL(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SSLConfig& config, const SocketOptions& options,
+        std::shared_ptr<SSLSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
         return error::illegal_argument;
@@ -90,7 +97,7 @@ error ConnectSSL(const std::string& host, uint16_t port, int64_t timeoutMillisec
     }
 
     std::shared_ptr<TCPSocket> tcp;
-    error tcpErr = ConnectTCP(host, port, timeoutMilliseconds, &tcp);
+    error tcpErr = ConnectTCP(host, port, timeoutMilliseconds, options, &tcp);
     if (tcpErr != error::nil) {
         return tcpErr;
     }
@@ -162,6 +169,12 @@ exit:
 error ListenSSL(uint16_t port,
         const SSLConfig& config,
         std::shared_ptr<SSLListener>* serverSock) {
+    return ListenSSL(port, config, SocketOptions(), serverSock);
+}
+
+error ListenSSL(uint16_t port,
+        const SSLConfig& config, const SocketOptions& options,
+        std::shared_ptr<SSLListener>* serverSock) {
     if (serverSock == nullptr) {
         assert(0 && "serverSock must not be nullptr");
         return error::illegal_argument;
@@ -176,7 +189,7 @@ error ListenSSL(uint16_t port,
     }
 
     std::shared_ptr<TCPListener> tcp;
-    error tcpErr = ListenTCP(port, &tcp);
+    error tcpErr = ListenTCP(port, options, &tcp);
     if (tcpErr != error::nil) {
         return tcpErr;
     }
@@ -201,6 +214,23 @@ error SSLSocket::Close() {
     return error::nil;
 }
 
+// a record may need the other direction of the socket in non-blocking mode,
+// so that either way is reported as error::wouldblock
+static error sslError(int err) {
+    switch (err) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return error::wouldblock;
+        case SSL_ERROR_SYSCALL:
+            if (errno == 0) {
+                return error::eof; // unexpected EOF
+            }
+            return error::wrap(etype::os, errno);
+        default:
+            return error::wrap(etype::ssl, ERR_get_error());
+    }
+}
+
 error SSLSocket::Read(char* buf, size_t len, int* nbytes) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -208,11 +238,12 @@ error SSLSocket::Read(char* buf, size_t len, int* nbytes) {
     }
 
     int size = SSL_read(m_ssl, buf, len);
-    if (size == -1) {
-        return error::wrap(etype::os, errno);
-    }
-    if (size == 0) {
-        return error::eof;
+    if (size <= 0) {
+        int err = SSL_get_error(m_ssl, size);
+        if (err == SSL_ERROR_ZERO_RETURN) {
+            return error::eof;
+        }
+        return sslError(err);
     }
     if (nbytes != nullptr) {
         *nbytes = size;
@@ -227,8 +258,8 @@ error SSLSocket::Write(const char* buf, size_t len, int* nbytes) {
     }
 
     int size = SSL_write(m_ssl, buf, len);
-    if (size == -1) {
-        return error::wrap(etype::os, errno);
+    if (size <= 0) {
+        return sslError(SSL_get_error(m_ssl, size));
     }
     if (nbytes != nullptr) {
         *nbytes = size;
@@ -245,7 +276,12 @@ bool SSLListener::IsClosed() {
 }
 
 error SSLListener::Close() {
-    SSL_CTX_free(m_ctx);
+    if (m_ctx == nullptr) {
+        return error::nil;
+    }
+
+    SSL_CTX_free(m_ctx); // the accepted sockets hold references of their own
+    m_ctx = nullptr;
     return m_tcp->Close();
 }
 
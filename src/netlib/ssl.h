@@ -35,6 +35,11 @@ public:
      */
     error SetTimeout(int64_t timeoutMilliseconds) { return m_tcp->SetTimeout(timeoutMilliseconds); }
     error SetKeepAlive(bool on) { return m_tcp->SetKeepAlive(on); }
+    /**
+     * In non-blocking mode, Read and Write return error::wouldblock
+     * when a record has to wait for either direction of the socket.
+     */
+    error SetNonBlocking(bool on) { return m_tcp->SetNonBlocking(on); }
     error SetKeepAlivePeriod(int periodSeconds) { return m_tcp->SetKeepAlivePeriod(periodSeconds); }
     SocketFD FD() { return m_tcp->FD(); }
     std::string RemoteAddress() { return m_tcp->RemoteAddress(); }
@@ -82,6 +87,18 @@ error ConnectSSL(const std::string& host, uint16_t port, int64_t timeoutMillisec
         const SSLConfig& config,
         std::shared_ptr<SSLSocket>* clientSock);
 
+/**
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
+ * @param[in] config
+ * @param[in] options Set on the TCP socket before connecting
+ * @param[out] clientSock
+ */
+error ConnectSSL(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SSLConfig& config, const SocketOptions& options,
+        std::shared_ptr<SSLSocket>* clientSock);
+
 /**
  * @param[in] port
  * @param[in] config
@@ -91,4 +108,14 @@ error ListenSSL(uint16_t port,
         const SSLConfig& config,
         std::shared_ptr<SSLListener>* serverSock);
 
+/**
+ * @param[in] port
+ * @param[in] config
+ * @param[in] options Set on the TCP listener before binding
+ * @param[out] serverSock
+ */
+error ListenSSL(uint16_t port,
+        const SSLConfig& config, const SocketOptions& options,
+        std::shared_ptr<SSLListener>* serverSock);
+
 } // namespace net
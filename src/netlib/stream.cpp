@@ -1,28 +1,56 @@
 #include "netlib/stream.h"
 #include <cassert>
+#include <vector>
 
 namespace net {
 
 error Reader::ReadFull(char* buf, size_t len) {
+    return ReadFull(buf, len, nullptr);
+}
+
+error Reader::ReadFull(char* buf, size_t len, size_t* nbytes) {
     if (buf == nullptr) {
         assert(0 && "buf must not be nullptr");
         return error::illegal_argument;
     }
 
     size_t offset = 0;
-    int nbytes;
+    int n;
     while (true) {
-        error err = Read(&buf[offset], len - offset, &nbytes);
+        error err = Read(&buf[offset], len - offset, &n);
         if (err != error::nil) {
+            if (nbytes != nullptr) {
+                *nbytes = offset;
+            }
             return err;
         }
-        offset += nbytes;
+        offset += n;
         if (offset >= len) {
+            if (nbytes != nullptr) {
+                *nbytes = offset;
+            }
             return error::nil;
         }
     }
 }
 
+error Reader::ReadV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (iov[i].Len > 0) {
+            return Read(iov[i].Base, iov[i].Len, nbytes);
+        }
+    }
+    if (nbytes != nullptr) {
+        *nbytes = 0;
+    }
+    return error::nil;
+}
+
 error Reader::ReadLine(char* buf, size_t len) {
     if (buf == nullptr) {
         assert(0 && "buf must not be nullptr");
@@ -49,23 +77,104 @@ error Reader::ReadLine(char* buf, size_t len) {
 }
 
 error Writer::WriteFull(const char* buf, size_t len) {
+    return WriteFull(buf, len, nullptr);
+}
+
+error Writer::WriteFull(const char* buf, size_t len, size_t* nbytes) {
     if (buf == nullptr) {
         assert(0 && "buf must not be nullptr");
         return error::illegal_argument;
     }
 
     size_t offset = 0;
-    int nbytes;
+    int n;
     while (true) {
-        error err = Write(&buf[offset], len - offset, &nbytes);
+        error err = Write(&buf[offset], len - offset, &n);
         if (err != error::nil) {
+            if (nbytes != nullptr) {
+                *nbytes = offset;
+            }
             return err;
         }
-        offset += nbytes;
+        offset += n;
         if (offset >= len) {
+            if (nbytes != nullptr) {
+                *nbytes = offset;
+            }
             return error::nil;
         }
     }
 }
 
+error Writer::WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (iov[i].Len > 0) {
+            return Write(iov[i].Base, iov[i].Len, nbytes);
+        }
+    }
+    if (nbytes != nullptr) {
+        *nbytes = 0;
+    }
+    return error::nil;
+}
+
+error Writer::WriteFullV(const IOVec* iov, size_t iovcnt) {
+    return WriteFullV(iov, iovcnt, nullptr);
+}
+
+error Writer::WriteFullV(const IOVec* iov, size_t iovcnt, size_t* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    std::vector<IOVec> rest; // a copy of iov, made only when a buffer is written partially
+    const IOVec* head = iov;
+    size_t count = iovcnt;
+    size_t total = 0;
+    while (true) {
+        while (count > 0 && head->Len == 0) {
+            head++;
+            count--;
+        }
+        if (count == 0) {
+            if (nbytes != nullptr) {
+                *nbytes = total;
+            }
+            return error::nil;
+        }
+
+        int n;
+        error err = WriteV(head, count, &n);
+        if (err != error::nil) {
+            if (nbytes != nullptr) {
+                *nbytes = total;
+            }
+            return err;
+        }
+        total += n;
+
+        size_t written = n;
+        while (count > 0 && written >= head->Len) {
+            written -= head->Len;
+            head++;
+            count--;
+        }
+        if (written > 0) {
+            if (rest.empty()) { // iov itself must not be modified
+                rest.assign(head, head + count);
+                head = rest.data();
+            }
+            IOVec* partial = &rest[rest.size() - count];
+            partial->Base += written;
+            partial->Len -= written;
+        }
+    }
+}
+
 } // namespace net
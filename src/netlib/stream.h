@@ -5,6 +5,14 @@
 
 namespace net {
 
+/**
+ * A buffer of a scatter/gather operation, laid out as struct iovec.
+ */
+struct IOVec {
+    char* Base;
+    size_t Len;
+};
+
 struct Closer {
     virtual ~Closer() {}
     virtual error Close() = 0;
@@ -19,6 +27,22 @@ struct Reader {
      */
     virtual error Read(char* buf, size_t len, int* nbytes) = 0;
     error ReadFull(char* buf, size_t len);
+    /**
+     * @param[in] buf
+     * @param[in] len
+     * @param[out] nbytes The number of bytes read even if an error is returned,
+     *                    e.g. error::wouldblock in non-blocking mode
+     */
+    virtual error ReadFull(char* buf, size_t len, size_t* nbytes);
+    /**
+     * Read into the buffers in order with a single call.
+     * The default implementation reads into the first non-empty buffer only.
+     *
+     * @param[in] iov
+     * @param[in] iovcnt
+     * @param[out] nbytes
+     */
+    virtual error ReadV(const IOVec* iov, size_t iovcnt, int* nbytes);
     /**
      * Read a single line including the line end ('\n').
      * Read a len-1 bytes if the line end is not found,
@@ -28,7 +52,7 @@ struct Reader {
      * @param[in] buf
      * @param[in] len
      */
-    error ReadLine(char* buf, size_t len);
+    virtual error ReadLine(char* buf, size_t len);
 };
 
 struct Writer {
@@ -40,6 +64,31 @@ struct Writer {
      */
     virtual error Write(const char* buf, size_t len, int* nbytes) = 0;
     error WriteFull(const char* buf, size_t len);
+    /**
+     * @param[in] buf
+     * @param[in] len
+     * @param[out] nbytes The number of bytes written even if an error is returned,
+     *                    e.g. error::wouldblock in non-blocking mode
+     */
+    error WriteFull(const char* buf, size_t len, size_t* nbytes);
+    /**
+     * Write the buffers in order with a single call, which may write fewer bytes than their total.
+     * The default implementation writes the first non-empty buffer only.
+     *
+     * @param[in] iov
+     * @param[in] iovcnt
+     * @param[out] nbytes
+     */
+    virtual error WriteV(const IOVec* iov, size_t iovcnt, int* nbytes);
+    error WriteFullV(const IOVec* iov, size_t iovcnt);
+    /**
+     * Write all of the buffers, resuming from the middle of a buffer after a partial write.
+     *
+     * @param[in] iov
+     * @param[in] iovcnt
+     * @param[out] nbytes The number of bytes written even if an error is returned
+     */
+    error WriteFullV(const IOVec* iov, size_t iovcnt, size_t* nbytes);
 };
 
 struct ReadWriter : public Reader, public Writer {};
@@ -3,66 +3,190 @@
 #include <cstdint>
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "netlib/error.h"
 #include "netlib/fd.h"
+#include "netlib/socket_options.h"
 #include "netlib/stream.h"
 
 namespace net {
 
+/**
+ * The ids of the zero-copy sends from First to Last inclusive, whose buffers may be reused.
+ */
+struct ZeroCopyCompletion {
+    uint32_t First;
+    uint32_t Last;
+    /** true if the kernel has copied the data after all, e.g. over loopback */
+    bool Copied;
+};
+
 class TCPSocket final : public ReadWriteCloser {
 public:
     TCPSocket(const SocketFD& fd, const std::string& addr, uint16_t port)
-            : m_fd(fd), m_remoteAddr(addr), m_remotePort(port), m_closed(false), m_timeoutMilliseconds(0) {}
+            : m_fd(fd), m_remoteAddr(addr), m_remoteIPv4(0), m_remotePort(port), m_closed(false), m_nonBlocking(false),
+              m_timeoutMilliseconds(0), m_zeroCopy(false), m_zeroCopyID(0) {}
+    /**
+     * The remote address is formatted when RemoteAddress is called first.
+     *
+     * @param[in] fd
+     * @param[in] addr An IPv4 address in network byte order
+     * @param[in] port
+     * @param[in] nonBlocking true if fd is already in non-blocking mode
+     */
+    TCPSocket(const SocketFD& fd, uint32_t addr, uint16_t port, bool nonBlocking)
+            : m_fd(fd), m_remoteIPv4(addr), m_remotePort(port), m_closed(false), m_nonBlocking(nonBlocking),
+              m_timeoutMilliseconds(0), m_zeroCopy(false), m_zeroCopyID(0) {}
     ~TCPSocket();
     TCPSocket(const TCPSocket&) = delete;
     TCPSocket& operator=(const TCPSocket&) = delete;
 
     bool IsClosed() { return m_closed; }
     error Close();
+    /**
+     * Shut down the writing side, so that the peer reads end of file while this socket can still read.
+     */
+    error CloseWrite();
     error Read(char* buf, size_t len, int* nbytes);
+    error ReadV(const IOVec* iov, size_t iovcnt, int* nbytes);
     error Write(const char* buf, size_t len, int* nbytes);
+    error WriteV(const IOVec* iov, size_t iovcnt, int* nbytes);
+    /**
+     * Send length bytes of a file from offset with sendfile(2), without copying them to user space.
+     * The file offset of fd is left unchanged. Only supported on Linux, error::opnotsupp otherwise.
+     *
+     * @param[in] fd A file descriptor of a regular file
+     * @param[in] offset
+     * @param[in] length
+     * @param[out] sent The number of bytes sent even if an error is returned,
+     *                  e.g. error::wouldblock in non-blocking mode, or error::eof if the file ends early
+     */
+    error SendFile(int fd, int64_t offset, size_t length, size_t* sent);
+    /**
+     * Move length bytes from a pipe with splice(2), without copying them to user space.
+     * Only supported on Linux, error::opnotsupp otherwise.
+     *
+     * @param[in] pipeFD The read end of a pipe
+     * @param[in] length
+     * @param[out] sent The number of bytes sent even if an error is returned,
+     *                  e.g. error::wouldblock in non-blocking mode, or error::eof if the pipe is closed early
+     */
+    error Splice(int pipeFD, size_t length, size_t* sent);
+    /**
+     * Enable SO_ZEROCOPY, which WriteZeroCopy requires.
+     * Only supported on Linux 4.14 or later, error::opnotsupp otherwise.
+     *
+     * @param[in] on
+     */
+    error SetZeroCopy(bool on);
+    bool IsZeroCopy() { return m_zeroCopy; }
+    /**
+     * Send buf with MSG_ZEROCOPY, by which the kernel pins buf instead of copying it.
+     * buf must not be modified until the completion of id is read by ReadZeroCopyCompletions.
+     * Zero-copy pays off for writes of about 10 KB or more.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[out] nbytes
+     * @param[out] id The id of this send, which counts up from 0 per socket
+     */
+    error WriteZeroCopy(const char* buf, size_t len, int* nbytes, uint32_t* id);
+    /**
+     * Read the pending completions of zero-copy sends without blocking.
+     * Completions are signaled by POLLERR on FD,
+     * which EventLoop reports as EventHandler::OnErrorQueue if it is set, or as OnClosed otherwise.
+     *
+     * @param[out] completions The completions are appended
+     * @return error::wouldblock if no completion is pending
+     */
+    error ReadZeroCopyCompletions(std::vector<ZeroCopyCompletion>* completions);
     /**
      * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
      */
     error SetTimeout(int64_t timeoutMilliseconds);
+    /**
+     * In non-blocking mode, Read and Write return error::wouldblock instead of blocking,
+     * and Write may write fewer than len bytes, as reported by nbytes.
+     *
+     * @param[in] on
+     */
+    error SetNonBlocking(bool on);
+    bool IsNonBlocking() { return m_nonBlocking; }
     error SetKeepAlive(bool on);
     error SetKeepAlivePeriod(int periodSeconds);
+    /**
+     * While corked, only full segments are sent, and the rest is sent when uncorked
+     * (TCP_CORK on Linux, TCP_NOPUSH on BSD, error::opnotsupp otherwise).
+     *
+     * @param[in] on
+     */
+    error SetCork(bool on);
     SocketFD FD() { return m_fd; }
-    std::string RemoteAddress() { return m_remoteAddr; }
+    std::string RemoteAddress();
     uint16_t RemotePort() { return m_remotePort; }
 
 private:
     const SocketFD m_fd;
-    const std::string m_remoteAddr;
+    std::once_flag m_formatted;
+    std::string m_remoteAddr; // formatted from m_remoteIPv4 if empty
+    const uint32_t m_remoteIPv4;
     const uint16_t m_remotePort;
     std::atomic<bool> m_closed;
+    bool m_nonBlocking;
     int64_t m_timeoutMilliseconds;
+    bool m_zeroCopy;
+    uint32_t m_zeroCopyID; // the id of the next zero-copy send
 };
 
 class TCPListener final : public Closer {
 public:
     explicit TCPListener(const SocketFD& fd)
-            : m_fd(fd), m_closed(false), m_timeoutMilliseconds(0) {}
+            : m_fd(fd), m_closed(false), m_nonBlocking(false), m_timeoutMilliseconds(0) {}
     ~TCPListener();
     TCPListener(const TCPListener&) = delete;
     TCPListener& operator=(const TCPListener&) = delete;
 
     bool IsClosed() { return m_closed; }
     error Close();
+    /**
+     * Wake up the threads blocked in Accept, which then fails, without closing the listener.
+     * @return error::opnotsupp where a listener cannot be shut down (Windows)
+     */
+    error Shutdown();
     /**
      * @param[out] clientSock
      */
     error Accept(std::shared_ptr<TCPSocket>* clientSock);
+    /**
+     * Accept the pending connections up to maxCount at once.
+     * The accepted sockets are always in non-blocking mode and close-on-exec.
+     * In blocking mode, this waits for the first connection only, as Accept does.
+     *
+     * @param[out] clientSocks The accepted sockets are appended, even if an error is returned
+     * @param[in] maxCount
+     * @return error::wouldblock in non-blocking mode if the backlog has been drained
+     */
+    error AcceptMany(std::vector<std::shared_ptr<TCPSocket>>* clientSocks, size_t maxCount);
     /**
      * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
      */
     error SetTimeout(int64_t timeoutMilliseconds);
+    /**
+     * In non-blocking mode, Accept returns error::wouldblock instead of blocking
+     * when no connection is pending, and the accepted sockets are non-blocking as well.
+     *
+     * @param[in] on
+     */
+    error SetNonBlocking(bool on);
+    bool IsNonBlocking() { return m_nonBlocking; }
     SocketFD FD() { return m_fd; }
 
 private:
     const SocketFD m_fd;
     std::atomic<bool> m_closed;
+    bool m_nonBlocking;
     int64_t m_timeoutMilliseconds;
 };
 
@@ -75,10 +199,61 @@ private:
 error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
         std::shared_ptr<TCPSocket>* clientSock);
 
+/**
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
+ * @param[in] options Set before connecting, e.g. SocketOptions::LowLatency()
+ * @param[out] clientSock
+ */
+error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, std::shared_ptr<TCPSocket>* clientSock);
+
+/**
+ * Connect to every address of host in parallel ("Happy Eyeballs", RFC 8305),
+ * and keep the first connection established.
+ * The attempts are started 250 ms apart, or as soon as the previous one fails,
+ * with the addresses which have connected fastest before tried first.
+ *
+ * @param[in] host A hostname, IPv4 or IPv6
+ * @param[in] port
+ * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
+ * @param[out] clientSock
+ */
+error ConnectTCPHappyEyeballs(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        std::shared_ptr<TCPSocket>* clientSock);
+
+/**
+ * Connect with TCP Fast Open (RFC 7413), by which data is sent in the SYN
+ * if a cookie of the server is cached from an earlier connection.
+ * Otherwise the SYN requests a cookie, and data is sent after the handshake,
+ * which is also the fallback on the platforms without Fast Open.
+ * Only data which is safe to be received twice should go in the SYN.
+ *
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
+ * @param[in] options
+ * @param[in] data Written in full unless an error is returned
+ * @param[in] len
+ * @param[out] sentWithSYN true if the server has acknowledged the data in the SYN. May be nullptr.
+ * @param[out] clientSock
+ */
+error ConnectTCPFastOpen(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, const char* data, size_t len,
+        bool* sentWithSYN, std::shared_ptr<TCPSocket>* clientSock);
+
 /**
  * @param[in] port
  * @param[out] serverSock
  */
 error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock);
 
+/**
+ * @param[in] port
+ * @param[in] options Set before binding, and inherited by the accepted sockets
+ * @param[out] serverSock
+ */
+error ListenTCP(uint16_t port, const SocketOptions& options, std::shared_ptr<TCPListener>* serverSock);
+
 } // namespace net
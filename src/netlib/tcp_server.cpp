@@ -0,0 +1,234 @@
+#include "netlib/tcp_server.h"
+#include <cassert>
+#include <chrono>
+#include "netlib/internal/init.h"
+
+namespace net {
+
+static const size_t kDefaultQueueCapacity = 1024;
+static const int64_t kAcceptRetryDelay = 100; // ms
+
+TCPServer::TCPServer(const std::shared_ptr<TCPListener>& listener, const TCPServerConfig& config, const TCPHandler& handler)
+        : m_listener(listener),
+          m_handler(handler),
+          m_capacity(config.QueueCapacity > 0 ? config.QueueCapacity : kDefaultQueueCapacity),
+          m_closed(false),
+          m_serving(false),
+          m_pending(0),
+          m_maxPending(0),
+          m_next(0),
+          m_accepted(0),
+          m_handled(0),
+          m_stolen(0) {
+    int nWorkers = config.Workers;
+    if (nWorkers <= 0) {
+        nWorkers = (int) std::thread::hardware_concurrency();
+        if (nWorkers <= 0) {
+            nWorkers = 1;
+        }
+    }
+    for (int i = 0; i < nWorkers; i++) {
+        m_workers.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        m_workers[i]->Thread = std::thread([this, i]() {
+            work(i);
+        });
+    }
+}
+
+TCPServer::~TCPServer() {
+    Close();
+}
+
+error TCPServer::Close() {
+    if (m_closed.exchange(true)) {
+        return error::nil;
+    }
+
+    error result = error::nil;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workCond.notify_all();
+        m_spaceCond.notify_all();
+        // Serve may be about to call Accept, so the listener is only shut down
+        // and is closed once Serve has returned
+        if (m_serving && m_listener->Shutdown() != error::nil) {
+            result = m_listener->Close();
+        }
+        m_servedCond.wait(lock, [this]() {
+            return !m_serving;
+        });
+    }
+    if (!m_listener->IsClosed()) {
+        result = m_listener->Close();
+    }
+    for (auto& worker : m_workers) {
+        if (worker->Thread.joinable()) {
+            worker->Thread.join();
+        }
+    }
+    for (auto& worker : m_workers) { // connections which no worker has taken
+        for (auto& sock : worker->Queue) {
+            sock->Close();
+        }
+        worker->Queue.clear();
+    }
+    return result;
+}
+
+error TCPServer::Serve() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed) {
+            return error::nil;
+        }
+        if (m_serving) {
+            assert(0 && "Already serving");
+            return error::illegal_state;
+        }
+        m_serving = true;
+    }
+    error err = accept();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_serving = false;
+    m_servedCond.notify_all();
+    return err;
+}
+
+error TCPServer::accept() {
+    while (!m_closed) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_spaceCond.wait(lock, [this]() {
+                return m_pending < m_capacity || m_closed;
+            });
+        }
+        if (m_closed) {
+            break;
+        }
+
+        std::shared_ptr<TCPSocket> sock;
+        error err = m_listener->Accept(&sock);
+        if (err != error::nil) {
+            if (m_closed) {
+                break;
+            }
+            if (err == error::badf || err == error::inval || err == error::notsock) {
+                return err;
+            }
+            if (err == error::mfile || err == error::nfile || err == error::nobufs || err == error::nomem) {
+                // the connection stays in the backlog, so wait for a handler to release its resources
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_spaceCond.wait_for(lock, std::chrono::milliseconds(kAcceptRetryDelay), [this]() {
+                    return m_closed.load();
+                });
+            }
+            // the other errors concern a single connection only
+            continue;
+        }
+        if (m_closed) { // accepted while closing, after which no worker takes connections
+            sock->Close();
+            break;
+        }
+        m_accepted++;
+        push(sock);
+    }
+    return error::nil;
+}
+
+TCPServerStats TCPServer::Stats() {
+    TCPServerStats stats = {};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stats.QueueDepth = m_pending;
+        stats.MaxQueueDepth = m_maxPending;
+    }
+    stats.Accepted = m_accepted;
+    stats.Handled = m_handled;
+    stats.Stolen = m_stolen;
+    return stats;
+}
+
+void TCPServer::push(const std::shared_ptr<TCPSocket>& sock) {
+    Worker* worker = m_workers[m_next++ % m_workers.size()].get();
+    // count the connection along with queueing it, so that a worker cannot take it before it is counted
+    std::lock_guard<std::mutex> lock(m_mutex);
+    {
+        std::lock_guard<std::mutex> queueLock(worker->Mutex);
+        worker->Queue.push_back(sock);
+    }
+    m_pending++;
+    if (m_pending > m_maxPending) {
+        m_maxPending = m_pending;
+    }
+    m_workCond.notify_one();
+}
+
+std::shared_ptr<TCPSocket> TCPServer::pop(size_t self) {
+    std::shared_ptr<TCPSocket> sock;
+    {
+        Worker* worker = m_workers[self].get();
+        std::lock_guard<std::mutex> lock(worker->Mutex);
+        if (!worker->Queue.empty()) {
+            sock = std::move(worker->Queue.front());
+            worker->Queue.pop_front();
+        }
+    }
+    // steal the most recently queued connection of another worker,
+    // which leaves the oldest ones to their owner
+    for (size_t i = 1; sock == nullptr && i < m_workers.size(); i++) {
+        Worker* victim = m_workers[(self + i) % m_workers.size()].get();
+        std::lock_guard<std::mutex> lock(victim->Mutex);
+        if (!victim->Queue.empty()) {
+            sock = std::move(victim->Queue.back());
+            victim->Queue.pop_back();
+            m_stolen++;
+        }
+    }
+    if (sock != nullptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending--;
+        m_spaceCond.notify_one();
+    }
+    return sock;
+}
+
+void TCPServer::work(size_t self) {
+    while (!m_closed) { // the connections still waiting are closed by Close
+        std::shared_ptr<TCPSocket> sock = pop(self);
+        if (sock != nullptr) {
+            m_handler(sock);
+            m_handled++;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workCond.wait(lock, [this]() {
+            return m_pending > 0 || m_closed;
+        });
+    }
+}
+
+error NewTCPServer(const std::shared_ptr<TCPListener>& listener, const TCPServerConfig& config,
+        const TCPHandler& handler, std::shared_ptr<TCPServer>* server) {
+    if (listener == nullptr) {
+        assert(0 && "listener must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (!handler) {
+        assert(0 && "handler must not be empty");
+        return error::illegal_argument;
+    }
+    if (server == nullptr) {
+        assert(0 && "server must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    *server = std::make_shared<TCPServer>(listener, config, handler);
+    return error::nil;
+}
+
+} // namespace net
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "netlib/error.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+
+namespace net {
+
+using TCPHandler = std::function<void(const std::shared_ptr<TCPSocket>& sock)>;
+
+struct TCPServerConfig {
+    /** The number of worker threads. The number of hardware threads if 0 is specified. */
+    int Workers;
+    /** The maximum number of accepted connections waiting for a worker. 1024 if 0 is specified. */
+    size_t QueueCapacity;
+};
+
+struct TCPServerStats {
+    size_t QueueDepth;    // connections waiting for a worker
+    size_t MaxQueueDepth; // high-water mark of QueueDepth
+    uint64_t Accepted;
+    uint64_t Handled;
+    uint64_t Stolen;      // connections taken from the queue of another worker
+};
+
+/**
+ * A TCP server which serves connections on a fixed pool of worker threads.
+ * Each worker has its own queue, and an idle worker steals connections
+ * from the queues of busy workers.
+ * Accepting blocks while QueueCapacity connections are waiting,
+ * which leaves further connections in the backlog of the listener.
+ */
+class TCPServer final : public Closer {
+public:
+    TCPServer(const std::shared_ptr<TCPListener>& listener, const TCPServerConfig& config, const TCPHandler& handler);
+    ~TCPServer();
+    TCPServer(const TCPServer&) = delete;
+    TCPServer& operator=(const TCPServer&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Stop accepting, close the connections which are still waiting,
+     * and wait for the running handlers to return.
+     * Must not be called from a handler.
+     */
+    error Close();
+    /**
+     * Accept connections on the calling thread until Close is called.
+     */
+    error Serve();
+    TCPServerStats Stats();
+
+private:
+    struct Worker {
+        std::mutex Mutex;
+        std::deque<std::shared_ptr<TCPSocket>> Queue;
+        std::thread Thread;
+    };
+
+    std::shared_ptr<TCPListener> m_listener;
+    const TCPHandler m_handler;
+    const size_t m_capacity;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_closed;
+    std::mutex m_mutex;
+    std::condition_variable m_workCond;
+    std::condition_variable m_spaceCond;
+    std::condition_variable m_servedCond;
+    bool m_serving; // Serve is running, which owns the listener until it returns
+    size_t m_pending;
+    size_t m_maxPending;
+    size_t m_next;
+    std::atomic<uint64_t> m_accepted;
+    std::atomic<uint64_t> m_handled;
+    std::atomic<uint64_t> m_stolen;
+
+    error accept();
+    void push(const std::shared_ptr<TCPSocket>& sock);
+    std::shared_ptr<TCPSocket> pop(size_t self);
+    void work(size_t self);
+};
+
+/**
+ * @param[in] listener
+ * @param[in] config
+ * @param[in] handler Called on a worker thread for each accepted connection
+ * @param[out] server
+ */
+error NewTCPServer(const std::shared_ptr<TCPListener>& listener, const TCPServerConfig& config,
+        const TCPHandler& handler, std::shared_ptr<TCPServer>* server);
+
+} // namespace net
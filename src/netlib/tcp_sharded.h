@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "netlib/error.h"
+#include "netlib/event_loop.h"
+#include "netlib/stream.h"
+#include "netlib/tcp.h"
+
+namespace net {
+
+/**
+ * Called on the worker thread which has accepted sock.
+ * Register sock to loop to serve it on the same thread.
+ */
+using ShardedAcceptHandler = std::function<void(EventLoop* loop, const std::shared_ptr<TCPSocket>& sock)>;
+
+/**
+ * A set of SO_REUSEPORT listeners bound to the same port,
+ * each of which is served by its own worker thread and event loop.
+ * The kernel spreads incoming connections across the listeners.
+ */
+class ShardedTCPListener final : public Closer {
+public:
+    struct Shard {
+        std::shared_ptr<TCPListener> Listener;
+        std::shared_ptr<EventLoop> Loop;
+        std::thread Worker;
+        std::atomic<uint64_t> Accepted;
+        bool RetryPending; // accepting again after an error such as emfile
+    };
+
+    ShardedTCPListener(std::vector<std::unique_ptr<Shard>>&& shards, uint16_t port)
+            : m_shards(std::move(shards)), m_port(port), m_closed(false) {}
+    ~ShardedTCPListener();
+    ShardedTCPListener(const ShardedTCPListener&) = delete;
+    ShardedTCPListener& operator=(const ShardedTCPListener&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Stop the workers and close the listeners.
+     * Must not be called from a worker thread.
+     */
+    error Close();
+    uint16_t Port() { return m_port; }
+    size_t Size() { return m_shards.size(); }
+    /**
+     * @param[in] shard
+     * @return the event loop of the shard
+     */
+    std::shared_ptr<EventLoop> Loop(size_t shard) { return m_shards[shard]->Loop; }
+    /**
+     * @param[in] shard
+     * @return the number of connections which have been accepted by the shard
+     */
+    uint64_t Accepted(size_t shard) { return m_shards[shard]->Accepted; }
+
+private:
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    const uint16_t m_port;
+    std::atomic<bool> m_closed;
+};
+
+/**
+ * @param[in] port A random port is chosen if 0 is specified
+ * @param[in] nThreads The number of listeners and worker threads
+ * @param[in] handler
+ * @param[out] serverSock
+ */
+error ListenTCPSharded(uint16_t port, int nThreads, const ShardedAcceptHandler& handler,
+        std::shared_ptr<ShardedTCPListener>* serverSock);
+
+} // namespace net
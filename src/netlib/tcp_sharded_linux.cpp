@@ -0,0 +1,137 @@
+#include "netlib/tcp_sharded.h"
+#include <cassert>
+#include "netlib/internal/init.h"
+#include "netlib/resolver.h"
+
+namespace net {
+
+static const size_t kAcceptBatch = 64;
+static const int64_t kAcceptRetryDelay = 100; // ms
+
+static error listenReusePort(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
+    SocketOptions options = SocketOptions();
+    options.ReusePort = true;
+    std::shared_ptr<TCPListener> listener;
+    error err = ListenTCP(port, options, &listener);
+    if (err != error::nil) {
+        return err;
+    }
+    err = listener->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+    *serverSock = std::move(listener);
+    return error::nil;
+}
+
+static void acceptAll(ShardedTCPListener::Shard* shard, const ShardedAcceptHandler& handler) {
+    std::vector<std::shared_ptr<TCPSocket>> socks;
+    while (true) {
+        socks.clear();
+        error err = shard->Listener->AcceptMany(&socks, kAcceptBatch);
+        for (auto& sock : socks) {
+            shard->Accepted++;
+            handler(shard->Loop.get(), sock);
+        }
+        if (err == error::nil) { // a full batch, behind which more may be queued
+            continue;
+        }
+        if (err == error::wouldblock || err == error::again) {
+            return;
+        }
+        // emfile and the like leave the backlog as it is, which raises no new edge,
+        // so retry after a while instead of spinning
+        if (!shard->RetryPending) {
+            shard->RetryPending = true;
+            shard->Loop->RunAfter(kAcceptRetryDelay, [shard, handler]() {
+                shard->RetryPending = false;
+                acceptAll(shard, handler);
+            });
+        }
+        return;
+    }
+}
+
+error ListenTCPSharded(uint16_t port, int nThreads, const ShardedAcceptHandler& handler,
+        std::shared_ptr<ShardedTCPListener>* serverSock) {
+    if (nThreads < 1) {
+        assert(0 && "nThreads must not be less than 1");
+        return error::illegal_argument;
+    }
+    if (serverSock == nullptr) {
+        assert(0 && "serverSock must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    std::vector<std::unique_ptr<ShardedTCPListener::Shard>> shards;
+    for (int i = 0; i < nThreads; i++) {
+        std::unique_ptr<ShardedTCPListener::Shard> shard(new ShardedTCPListener::Shard());
+        shard->Accepted = 0;
+        shard->RetryPending = false;
+        error err = listenReusePort(port, &shard->Listener);
+        if (err != error::nil) {
+            return err;
+        }
+        if (port == 0) { // bind the rest of the listeners to the port chosen by the first one
+            err = LookupPort(shard->Listener->FD(), &port);
+            if (err != error::nil) {
+                return err;
+            }
+        }
+        err = NewEventLoop(&shard->Loop);
+        if (err != error::nil) {
+            return err;
+        }
+        ShardedTCPListener::Shard* s = shard.get();
+        EventHandler listenerHandler;
+        listenerHandler.OnReadable = [s, handler]() {
+            acceptAll(s, handler);
+        };
+        err = shard->Loop->Add(shard->Listener->FD(), listenerHandler);
+        if (err != error::nil) {
+            return err;
+        }
+        shards.push_back(std::move(shard));
+    }
+
+    for (auto& shard : shards) {
+        std::shared_ptr<EventLoop> loop = shard->Loop;
+        shard->Worker = std::thread([loop]() {
+            loop->Run();
+        });
+    }
+
+    *serverSock = std::make_shared<ShardedTCPListener>(std::move(shards), port);
+    return error::nil;
+}
+
+ShardedTCPListener::~ShardedTCPListener() {
+    Close();
+}
+
+error ShardedTCPListener::Close() {
+    if (m_closed) {
+        return error::nil;
+    }
+
+    for (auto& shard : m_shards) {
+        shard->Loop->Stop();
+    }
+    error result = error::nil;
+    for (auto& shard : m_shards) {
+        if (shard->Worker.joinable()) {
+            shard->Worker.join();
+        }
+        shard->Loop->Close();
+        error err = shard->Listener->Close();
+        if (err != error::nil) {
+            result = err;
+        }
+    }
+    m_closed = true;
+    return result;
+}
+
+} // namespace net
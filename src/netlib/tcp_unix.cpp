@@ -1,15 +1,28 @@
 #include "netlib/tcp.h"
 #include <cassert>
 #include <cerrno>
+#include <climits>
+#include <cstring>
+#include <chrono>
+#include <vector>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
+#ifdef __linux__
+ #include <linux/errqueue.h>
+ #include <sys/sendfile.h>
+#endif // __linux__
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "netlib/internal/init.h"
+#include "netlib/internal/latency.h"
+#include "netlib/internal/socket.h"
 #include "netlib/resolver.h"
 
 namespace net {
@@ -23,25 +36,13 @@ static void toTimeval(int64_t milliseconds, struct timeval* dest) {
     dest->tv_usec = milliseconds % 1000 * 1000;
 }
 
-static error waitUntilReady(const int& fd,
-        fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
-        int64_t timeoutMilliseconds) {
-    if (readfds != nullptr) {
-        FD_ZERO(readfds);
-        FD_SET(fd, readfds);
-    }
-    if (writefds != nullptr) {
-        FD_ZERO(writefds);
-        FD_SET(fd, writefds);
-    }
-    if (exceptfds != nullptr) {
-        FD_ZERO(exceptfds);
-        FD_SET(fd, exceptfds);
-    }
-    struct timeval timeout;
-    toTimeval(timeoutMilliseconds, &timeout);
+static error waitUntilReady(const int& fd, short events, int64_t timeoutMilliseconds) {
+    struct pollfd pfd = {0};
+    pfd.fd = fd;
+    pfd.events = events;
+    int timeout = (int) ((timeoutMilliseconds > 0) ? timeoutMilliseconds : 0);
 
-    int result = select(fd + 1, readfds, writefds, exceptfds, &timeout);
+    int result = poll(&pfd, 1, timeout);
     if (result == -1) {
         return error::wrap(etype::os, errno);
     } else if (result == 0) {
@@ -57,8 +58,26 @@ static error waitUntilReady(const int& fd,
     }
 }
 
+// The socket is close-on-exec, set on creation where SOCK_CLOEXEC is available.
+static int newSocket(int family = AF_INET) {
+#ifdef SOCK_CLOEXEC
+    return socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    int fd = socket(family, SOCK_STREAM, 0);
+    if (fd != -1) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif // SOCK_CLOEXEC
+}
+
 error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
         std::shared_ptr<TCPSocket>* clientSock) {
+    return ConnectTCP(host, port, timeoutMilliseconds, SocketOptions(), clientSock);
+}
+
+error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, std::shared_ptr<TCPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
         return error::illegal_argument;
@@ -72,10 +91,15 @@ error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMillisec
         return addrErr;
     }
 
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = newSocket();
     if (fd == -1) {
         return error::wrap(etype::os, errno);
     }
+    error optErr = internal::applySocketOptions(fd, options, true);
+    if (optErr != error::nil) {
+        close(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -97,8 +121,7 @@ error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMillisec
                 return error::wrap(etype::os, connErr);
             }
         }
-        fd_set writefds;
-        error err = waitUntilReady(fd, nullptr, &writefds, nullptr, timeoutMilliseconds);
+        error err = waitUntilReady(fd, POLLOUT, timeoutMilliseconds);
         if (err != error::nil) {
             close(fd);
             return err;
@@ -110,7 +133,293 @@ error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMillisec
     return error::nil;
 }
 
+static error writeRest(const std::shared_ptr<TCPSocket>& sock, const char* data, size_t len, size_t sent) {
+    if (sent >= len) {
+        return error::nil;
+    }
+    error err = sock->WriteFull(&data[sent], len - sent);
+    if (err != error::nil) {
+        sock->Close();
+    }
+    return err;
+}
+
+error ConnectTCPFastOpen(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, const char* data, size_t len,
+        bool* sentWithSYN, std::shared_ptr<TCPSocket>* clientSock) {
+    if (data == nullptr && len > 0) {
+        assert(0 && "data must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (clientSock == nullptr) {
+        assert(0 && "clientSock must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (sentWithSYN != nullptr) {
+        *sentWithSYN = false;
+    }
+
+#ifdef MSG_FASTOPEN
+    internal::init();
+
+    std::string remoteAddr;
+    error addrErr = LookupAddress(host, &remoteAddr);
+    if (addrErr != error::nil) {
+        return addrErr;
+    }
+
+    int fd = newSocket();
+    if (fd == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    error optErr = internal::applySocketOptions(fd, options, true);
+    if (optErr != error::nil) {
+        close(fd);
+        return optErr;
+    }
+
+    struct sockaddr_in serverAddr = {0};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = inet_addr(remoteAddr.c_str());
+
+    if (timeoutMilliseconds > 0) {
+        ioctl(fd, FIONBIO, &kNonBlockingMode);
+    }
+    // connect, and put data in the SYN if a cookie is cached; blocks until connected in blocking mode
+    ssize_t size = sendto(fd, data, len, MSG_FASTOPEN, (struct sockaddr*) &serverAddr, sizeof(serverAddr));
+    if (size == -1) {
+        int sendErr = errno;
+        if (sendErr == EOPNOTSUPP) { // disabled by the sysctl
+            close(fd);
+            std::shared_ptr<TCPSocket> sock;
+            error err = ConnectTCP(host, port, timeoutMilliseconds, options, &sock);
+            if (err != error::nil) {
+                return err;
+            }
+            err = writeRest(sock, data, len, 0);
+            if (err != error::nil) {
+                return err;
+            }
+            *clientSock = std::move(sock);
+            return error::nil;
+        }
+        if (sendErr != EINPROGRESS) { // without a cookie, the SYN has gone without data
+            close(fd);
+            return error::wrap(etype::os, sendErr);
+        }
+        size = 0;
+    }
+    if (timeoutMilliseconds > 0) {
+        error err = waitUntilReady(fd, POLLOUT, timeoutMilliseconds);
+        if (err != error::nil) {
+            close(fd);
+            return err;
+        }
+        ioctl(fd, FIONBIO, &kBlockingMode);
+    }
+
+    if (sentWithSYN != nullptr) {
+        struct tcp_info info;
+        socklen_t infolen = sizeof(info);
+        if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &infolen) == 0) {
+            *sentWithSYN = (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+        }
+    }
+
+    std::shared_ptr<TCPSocket> sock = std::make_shared<TCPSocket>(fd, remoteAddr, port);
+    error err = writeRest(sock, data, len, size);
+    if (err != error::nil) {
+        return err;
+    }
+    *clientSock = std::move(sock);
+    return error::nil;
+#else
+    std::shared_ptr<TCPSocket> sock;
+    error err = ConnectTCP(host, port, timeoutMilliseconds, options, &sock);
+    if (err != error::nil) {
+        return err;
+    }
+    err = writeRest(sock, data, len, 0);
+    if (err != error::nil) {
+        return err;
+    }
+    *clientSock = std::move(sock);
+    return error::nil;
+#endif // MSG_FASTOPEN
+}
+
+static const int64_t kConnectionAttemptDelay = 250; // ms, as recommended by RFC 8305
+
+static int64_t monotonicMilliseconds() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool toSockaddr(const std::string& addr, uint16_t port,
+        struct sockaddr_storage* dest, socklen_t* destlen) {
+    memset(dest, 0, sizeof(*dest));
+    struct sockaddr_in* in4 = (struct sockaddr_in*) dest;
+    if (inet_pton(AF_INET, addr.c_str(), &in4->sin_addr) == 1) {
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        *destlen = sizeof(*in4);
+        return true;
+    }
+    struct sockaddr_in6* in6 = (struct sockaddr_in6*) dest;
+    if (inet_pton(AF_INET6, addr.c_str(), &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        *destlen = sizeof(*in6);
+        return true;
+    }
+    return false;
+}
+
+error ConnectTCPHappyEyeballs(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        std::shared_ptr<TCPSocket>* clientSock) {
+    if (clientSock == nullptr) {
+        assert(0 && "clientSock must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    std::vector<std::string> addrs;
+    error err = LookupAddresses(host, &addrs);
+    if (err != error::nil) {
+        return err;
+    }
+    internal::sortByLatency(&addrs);
+
+    struct Attempt {
+        int FD;
+        size_t Index;
+        int64_t Start;
+    };
+    std::vector<Attempt> attempts;
+    std::vector<struct pollfd> pfds;
+    auto closeAll = [&]() {
+        for (auto& attempt : attempts) {
+            close(attempt.FD);
+        }
+    };
+
+    const int64_t start = monotonicMilliseconds();
+    const int64_t deadline = (timeoutMilliseconds > 0) ? start + timeoutMilliseconds : INT64_MAX;
+    int64_t nextStart = start;
+    size_t next = 0;
+    error lastErr = error::timedout;
+    int winner = -1;
+    size_t winnerIndex = 0;
+    int64_t winnerStart = 0;
+    while (winner == -1) {
+        int64_t now = monotonicMilliseconds();
+        if (now >= deadline) {
+            closeAll();
+            return error::timedout;
+        }
+
+        // start the next attempt
+        if (next < addrs.size() && now >= nextStart) {
+            size_t index = next++;
+            nextStart = now + kConnectionAttemptDelay;
+            struct sockaddr_storage addr;
+            socklen_t addrlen;
+            if (!toSockaddr(addrs[index], port, &addr, &addrlen)) {
+                lastErr = error::inval;
+                nextStart = now;
+                continue;
+            }
+            int fd = newSocket(addr.ss_family);
+            if (fd == -1) {
+                lastErr = error::wrap(etype::os, errno);
+                nextStart = now;
+                continue;
+            }
+            ioctl(fd, FIONBIO, &kNonBlockingMode);
+            if (connect(fd, (struct sockaddr*) &addr, addrlen) == 0) {
+                winner = fd;
+                winnerIndex = index;
+                winnerStart = now;
+                break;
+            }
+            int connErr = errno;
+            if (connErr != EINPROGRESS) {
+                close(fd);
+                internal::recordLatency(addrs[index], -1);
+                lastErr = error::wrap(etype::os, connErr);
+                nextStart = now; // fail over at once
+                continue;
+            }
+            attempts.push_back({fd, index, now});
+        }
+        if (attempts.empty()) {
+            if (next >= addrs.size()) {
+                return lastErr;
+            }
+            continue;
+        }
+
+        // wait until an attempt completes, the next one is due, or the deadline passes
+        int64_t wakeup = deadline;
+        if (next < addrs.size() && nextStart < wakeup) {
+            wakeup = nextStart;
+        }
+        int64_t wait = wakeup - now;
+        int timeout = (wakeup == INT64_MAX) ? -1 : (int) ((wait > 0) ? wait : 0);
+        pfds.resize(attempts.size());
+        for (size_t i = 0; i < attempts.size(); i++) {
+            pfds[i].fd = attempts[i].FD;
+            pfds[i].events = POLLOUT;
+            pfds[i].revents = 0;
+        }
+        int result = poll(pfds.data(), pfds.size(), timeout);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int pollErr = errno;
+            closeAll();
+            return error::wrap(etype::os, pollErr);
+        }
+        now = monotonicMilliseconds();
+        for (size_t i = pfds.size(); i-- > 0;) { // backwards, to erase failed attempts in place
+            if (pfds[i].revents == 0) {
+                continue;
+            }
+            Attempt attempt = attempts[i];
+            int soErr = 0;
+            socklen_t optlen = sizeof(soErr);
+            getsockopt(attempt.FD, SOL_SOCKET, SO_ERROR, &soErr, &optlen);
+            attempts.erase(attempts.begin() + i);
+            if (soErr == 0 && winner == -1) {
+                winner = attempt.FD;
+                winnerIndex = attempt.Index;
+                winnerStart = attempt.Start;
+                continue;
+            }
+            close(attempt.FD);
+            if (soErr != 0) {
+                internal::recordLatency(addrs[attempt.Index], -1);
+                lastErr = error::wrap(etype::os, soErr);
+                nextStart = now; // fail over at once
+            }
+        }
+    }
+    closeAll();
+
+    internal::recordLatency(addrs[winnerIndex], monotonicMilliseconds() - winnerStart);
+    ioctl(winner, FIONBIO, &kBlockingMode);
+    *clientSock = std::make_shared<TCPSocket>(winner, addrs[winnerIndex], port);
+    return error::nil;
+}
+
 error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
+    return ListenTCP(port, SocketOptions(), serverSock);
+}
+
+error ListenTCP(uint16_t port, const SocketOptions& options, std::shared_ptr<TCPListener>* serverSock) {
     if (serverSock == nullptr) {
         assert(0 && "serverSock must not be nullptr");
         return error::illegal_argument;
@@ -118,7 +427,7 @@ error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
 
     internal::init();
 
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = newSocket();
     if (fd == -1) {
         return error::wrap(etype::os, errno);
     }
@@ -129,6 +438,11 @@ error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
         close(fd);
         return error::wrap(etype::os, err);
     }
+    error optErr = internal::applySocketOptions(fd, options, true);
+    if (optErr != error::nil) {
+        close(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -140,7 +454,18 @@ error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
         return error::wrap(etype::os, err);
     }
 
-    if (listen(fd, SOMAXCONN) == -1) {
+#ifdef TCP_FASTOPEN
+    if (options.FastOpenQueueLength > 0) {
+        int qlen = options.FastOpenQueueLength;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == -1) {
+            int err = errno;
+            close(fd);
+            return error::wrap(etype::os, err);
+        }
+    }
+#endif // TCP_FASTOPEN
+
+    if (listen(fd, (options.Backlog > 0) ? options.Backlog : SOMAXCONN) == -1) {
         int err = errno;
         close(fd);
         return error::wrap(etype::os, err);
@@ -166,6 +491,18 @@ error TCPSocket::Close() {
     return error::nil;
 }
 
+error TCPSocket::CloseWrite() {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (shutdown(m_fd, SHUT_WR) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
 error TCPSocket::Read(char* buf, size_t len, int* nbytes) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -185,6 +522,30 @@ error TCPSocket::Read(char* buf, size_t len, int* nbytes) {
     return error::nil;
 }
 
+error TCPSocket::ReadV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    int count = (int) ((iovcnt < IOV_MAX) ? iovcnt : IOV_MAX); // a short read is allowed
+    ssize_t size = readv(m_fd, internal::toIOVec(iov), count);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
 error TCPSocket::Write(const char* buf, size_t len, int* nbytes) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -201,12 +562,216 @@ error TCPSocket::Write(const char* buf, size_t len, int* nbytes) {
     return error::nil;
 }
 
+error TCPSocket::WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    int count = (int) ((iovcnt < IOV_MAX) ? iovcnt : IOV_MAX); // the rest is left to WriteFullV
+    ssize_t size = writev(m_fd, internal::toIOVec(iov), count);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
+error TCPSocket::SendFile(int fd, int64_t offset, size_t length, size_t* sent) {
+    if (offset < 0) {
+        assert(0 && "offset must not be negative");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    size_t total = 0;
+    error result = error::nil;
+#ifdef __linux__
+    off_t off = (off_t) offset;
+    while (total < length) {
+        ssize_t size = sendfile(m_fd, fd, &off, length - total);
+        if (size == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = error::wrap(etype::os, errno);
+            break;
+        }
+        if (size == 0) { // the file is shorter than length
+            result = error::eof;
+            break;
+        }
+        total += size;
+    }
+#else
+    result = error::opnotsupp;
+#endif // __linux__
+    if (sent != nullptr) {
+        *sent = total;
+    }
+    return result;
+}
+
+error TCPSocket::Splice(int pipeFD, size_t length, size_t* sent) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    size_t total = 0;
+    error result = error::nil;
+#ifdef __linux__
+    unsigned int flags = SPLICE_F_MOVE | (m_nonBlocking ? SPLICE_F_NONBLOCK : 0);
+    while (total < length) {
+        if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
+            // SO_SNDTIMEO bounds the socket side only, while the pipe may be empty
+            error err = waitUntilReady(pipeFD, POLLIN, m_timeoutMilliseconds);
+            if (err != error::nil) {
+                result = err;
+                break;
+            }
+        }
+        ssize_t size = splice(pipeFD, nullptr, m_fd, nullptr, length - total, flags);
+        if (size == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = error::wrap(etype::os, errno);
+            break;
+        }
+        if (size == 0) { // the write end of the pipe has been closed
+            result = error::eof;
+            break;
+        }
+        total += size;
+    }
+#else
+    result = error::opnotsupp;
+#endif // __linux__
+    if (sent != nullptr) {
+        *sent = total;
+    }
+    return result;
+}
+
+error TCPSocket::SetZeroCopy(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+#if defined(__linux__) && defined(SO_ZEROCOPY)
+    int enabled = on ? 1 : 0;
+    if (setsockopt(m_fd, SOL_SOCKET, SO_ZEROCOPY, &enabled, sizeof(enabled)) == -1) {
+        if (errno == ENOPROTOOPT) { // before Linux 4.14
+            return error::opnotsupp;
+        }
+        return error::wrap(etype::os, errno);
+    }
+    m_zeroCopy = on;
+    return error::nil;
+#else
+    return error::opnotsupp;
+#endif // defined(__linux__) && defined(SO_ZEROCOPY)
+}
+
+error TCPSocket::WriteZeroCopy(const char* buf, size_t len, int* nbytes, uint32_t* id) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (!m_zeroCopy) {
+        assert(0 && "SetZeroCopy has not been called");
+        return error::illegal_state;
+    }
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    int size = send(m_fd, buf, len, MSG_ZEROCOPY);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = size;
+    }
+    if (id != nullptr) {
+        *id = m_zeroCopyID;
+    }
+    m_zeroCopyID++; // the kernel counts the sends which have succeeded in the same way
+    return error::nil;
+#else
+    return error::opnotsupp;
+#endif // defined(__linux__) && defined(MSG_ZEROCOPY)
+}
+
+error TCPSocket::ReadZeroCopyCompletions(std::vector<ZeroCopyCompletion>* completions) {
+    if (completions == nullptr) {
+        assert(0 && "completions must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    size_t count = completions->size();
+    while (true) {
+        char control[128];
+        struct msghdr msg = {0};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(m_fd, &msg, MSG_ERRQUEUE) == -1) { // never blocks
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN && completions->size() > count) {
+                return error::nil;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                    || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr) {
+                continue;
+            }
+            struct sock_extended_err ee;
+            memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+            if (ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            ZeroCopyCompletion completion;
+            completion.First = ee.ee_info;
+            completion.Last = ee.ee_data;
+            completion.Copied = (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            completions->push_back(completion);
+        }
+    }
+#else
+    return error::opnotsupp;
+#endif // defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+}
+
 error TCPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     if (m_closed) {
         assert(0 && "Already closed");
         return error::illegal_state;
     }
 
+    timeoutMilliseconds = (timeoutMilliseconds > 0) ? timeoutMilliseconds : 0;
+    if (timeoutMilliseconds == m_timeoutMilliseconds) {
+        return error::nil; // spare the syscalls below
+    }
+
     struct timeval soTimeout;
     toTimeval(timeoutMilliseconds, &soTimeout);
     if (setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &soTimeout, sizeof(soTimeout)) == -1) {
@@ -227,6 +792,20 @@ error TCPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     return error::nil;
 }
 
+error TCPSocket::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 error TCPSocket::SetKeepAlive(bool on) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -240,6 +819,29 @@ error TCPSocket::SetKeepAlive(bool on) {
     return error::nil;
 }
 
+error TCPSocket::SetCork(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+#if defined(TCP_CORK)
+    int enabled = on;
+    if (setsockopt(m_fd, IPPROTO_TCP, TCP_CORK, &enabled, sizeof(enabled)) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+#elif defined(TCP_NOPUSH)
+    int enabled = on;
+    if (setsockopt(m_fd, IPPROTO_TCP, TCP_NOPUSH, &enabled, sizeof(enabled)) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+#else
+    return error::opnotsupp;
+#endif // defined(TCP_CORK)
+}
+
 error TCPSocket::SetKeepAlivePeriod(int periodSeconds) {
     if (periodSeconds < 1) {
         assert(0 && "periodSeconds must not be less than 1");
@@ -272,6 +874,19 @@ error TCPSocket::SetKeepAlivePeriod(int periodSeconds) {
     return error::nil;
 }
 
+std::string TCPSocket::RemoteAddress() {
+    std::call_once(m_formatted, [this]() {
+        if (m_remoteAddr.empty()) {
+            struct in_addr addr = {0};
+            addr.s_addr = m_remoteIPv4;
+            char buf[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+            m_remoteAddr = buf;
+        }
+    });
+    return m_remoteAddr;
+}
+
 TCPListener::~TCPListener() {
     Close();
 }
@@ -281,6 +896,7 @@ error TCPListener::Close() {
         return error::nil;
     }
 
+    shutdown(m_fd, SHUT_RDWR); // wake up a thread blocked in Accept
     if (close(m_fd) == -1) {
         return error::wrap(etype::os, errno);
     }
@@ -288,6 +904,40 @@ error TCPListener::Close() {
     return error::nil;
 }
 
+error TCPListener::Shutdown() {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (shutdown(m_fd, SHUT_RDWR) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+}
+
+// The flags of the socket are set on accept where accept4 is available.
+static int acceptSocket(int fd, bool nonBlocking, struct sockaddr_in* addr) {
+    socklen_t addrlen = sizeof(*addr);
+#ifdef __linux__
+    int flags = SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0);
+    return accept4(fd, (struct sockaddr*) addr, &addrlen, flags);
+#else
+    int clientFD = accept(fd, (struct sockaddr*) addr, &addrlen);
+    if (clientFD == -1) {
+        return -1;
+    }
+    fcntl(clientFD, F_SETFD, FD_CLOEXEC);
+    if (nonBlocking && internal::setNonBlocking(clientFD, true) != error::nil) {
+        int err = errno;
+        close(clientFD);
+        errno = err;
+        return -1;
+    }
+    return clientFD;
+#endif // __linux__
+}
+
 error TCPListener::Accept(std::shared_ptr<TCPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
@@ -298,24 +948,62 @@ error TCPListener::Accept(std::shared_ptr<TCPSocket>* clientSock) {
         return error::illegal_state;
     }
 
-    if (m_timeoutMilliseconds > 0) {
-        fd_set readfds;
-        error err = waitUntilReady(m_fd, &readfds, nullptr, nullptr, m_timeoutMilliseconds);
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
+        error err = waitUntilReady(m_fd, POLLIN, m_timeoutMilliseconds);
         if (err != error::nil) {
             return err;
         }
     }
 
     struct sockaddr_in clientAddr = {0};
-    socklen_t addrlen = sizeof(clientAddr);
-    int clientFD = accept(m_fd, (struct sockaddr*) &clientAddr, &addrlen);
+    int clientFD = acceptSocket(m_fd, m_nonBlocking, &clientAddr);
     if (clientFD == -1) {
         return error::wrap(etype::os, errno);
     }
+    *clientSock = std::make_shared<TCPSocket>(clientFD, clientAddr.sin_addr.s_addr, ntohs(clientAddr.sin_port),
+            m_nonBlocking);
+    return error::nil;
+}
+
+error TCPListener::AcceptMany(std::vector<std::shared_ptr<TCPSocket>>* clientSocks, size_t maxCount) {
+    if (clientSocks == nullptr) {
+        assert(0 && "clientSocks must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    size_t count = 0;
+    while (count < maxCount) {
+        if (!m_nonBlocking) {
+            // wait for the first connection only; poll the backlog for the rest
+            int64_t timeout = (count == 0) ? m_timeoutMilliseconds : 0;
+            if (count > 0 || timeout > 0) {
+                error err = waitUntilReady(m_fd, POLLIN, timeout);
+                if (err == error::timedout && count > 0) {
+                    return error::nil;
+                }
+                if (err != error::nil) {
+                    return err;
+                }
+            }
+        }
 
-    std::string remoteAddr = inet_ntoa(clientAddr.sin_addr);
-    uint16_t remotePort = ntohs(clientAddr.sin_port);
-    *clientSock = std::make_shared<TCPSocket>(clientFD, std::move(remoteAddr), remotePort);
+        struct sockaddr_in clientAddr = {0};
+        int clientFD = acceptSocket(m_fd, true, &clientAddr);
+        if (clientFD == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        // leave the address unformatted, which is not needed by most servers
+        clientSocks->push_back(std::make_shared<TCPSocket>(clientFD, clientAddr.sin_addr.s_addr,
+                ntohs(clientAddr.sin_port), true));
+        count++;
+    }
     return error::nil;
 }
 
@@ -329,4 +1017,18 @@ error TCPListener::SetTimeout(int64_t timeoutMilliseconds) {
     return error::nil;
 }
 
+error TCPListener::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 } // namespace net
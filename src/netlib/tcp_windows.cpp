@@ -1,8 +1,14 @@
 #include "netlib/tcp.h"
 #include <cassert>
+#include <cstring>
+#include <chrono>
+#include <vector>
 #include <mstcpip.h>
 #include <winsock2.h>
+#include <ws2tcpip.h>
 #include "netlib/internal/init.h"
+#include "netlib/internal/latency.h"
+#include "netlib/internal/socket.h"
 #include "netlib/resolver.h"
 
 namespace net {
@@ -52,6 +58,11 @@ static error waitUntilReady(const SocketFD& fd,
 
 error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
         std::shared_ptr<TCPSocket>* clientSock) {
+    return ConnectTCP(host, port, timeoutMilliseconds, SocketOptions(), clientSock);
+}
+
+error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, std::shared_ptr<TCPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
         return error::illegal_argument;
@@ -69,6 +80,11 @@ error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMillisec
     if (fd == INVALID_SOCKET) {
         return error::wrap(etype::os, WSAGetLastError());
     }
+    error optErr = internal::applySocketOptions(fd, options, true);
+    if (optErr != error::nil) {
+        closesocket(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -103,7 +119,210 @@ error ConnectTCP(const std::string& host, uint16_t port, int64_t timeoutMillisec
     return error::nil;
 }
 
+error ConnectTCPFastOpen(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        const SocketOptions& options, const char* data, size_t len,
+        bool* sentWithSYN, std::shared_ptr<TCPSocket>* clientSock) {
+    if (data == nullptr && len > 0) {
+        assert(0 && "data must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (clientSock == nullptr) {
+        assert(0 && "clientSock must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (sentWithSYN != nullptr) {
+        *sentWithSYN = false;
+    }
+
+    // Fast Open requires ConnectEx on Windows, so that data is sent after the handshake
+    std::shared_ptr<TCPSocket> sock;
+    error err = ConnectTCP(host, port, timeoutMilliseconds, options, &sock);
+    if (err != error::nil) {
+        return err;
+    }
+    if (len > 0) {
+        err = sock->WriteFull(data, len);
+        if (err != error::nil) {
+            sock->Close();
+            return err;
+        }
+    }
+    *clientSock = std::move(sock);
+    return error::nil;
+}
+
+static const int64_t kConnectionAttemptDelay = 250; // ms, as recommended by RFC 8305
+
+static int64_t monotonicMilliseconds() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool toSockaddr(const std::string& addr, uint16_t port,
+        struct sockaddr_storage* dest, int* destlen) {
+    memset(dest, 0, sizeof(*dest));
+    struct sockaddr_in* in4 = (struct sockaddr_in*) dest;
+    if (inet_pton(AF_INET, addr.c_str(), &in4->sin_addr) == 1) {
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        *destlen = sizeof(*in4);
+        return true;
+    }
+    struct sockaddr_in6* in6 = (struct sockaddr_in6*) dest;
+    if (inet_pton(AF_INET6, addr.c_str(), &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        *destlen = sizeof(*in6);
+        return true;
+    }
+    return false;
+}
+
+error ConnectTCPHappyEyeballs(const std::string& host, uint16_t port, int64_t timeoutMilliseconds,
+        std::shared_ptr<TCPSocket>* clientSock) {
+    if (clientSock == nullptr) {
+        assert(0 && "clientSock must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    std::vector<std::string> addrs;
+    error err = LookupAddresses(host, &addrs);
+    if (err != error::nil) {
+        return err;
+    }
+    internal::sortByLatency(&addrs);
+    if (addrs.size() > FD_SETSIZE) {
+        addrs.resize(FD_SETSIZE);
+    }
+
+    struct Attempt {
+        SOCKET FD;
+        size_t Index;
+        int64_t Start;
+    };
+    std::vector<Attempt> attempts;
+    auto closeAll = [&]() {
+        for (auto& attempt : attempts) {
+            closesocket(attempt.FD);
+        }
+    };
+
+    const int64_t start = monotonicMilliseconds();
+    const int64_t deadline = (timeoutMilliseconds > 0) ? start + timeoutMilliseconds : INT64_MAX;
+    int64_t nextStart = start;
+    size_t next = 0;
+    error lastErr = error::timedout;
+    SOCKET winner = INVALID_SOCKET;
+    size_t winnerIndex = 0;
+    int64_t winnerStart = 0;
+    while (winner == INVALID_SOCKET) {
+        int64_t now = monotonicMilliseconds();
+        if (now >= deadline) {
+            closeAll();
+            return error::timedout;
+        }
+
+        // start the next attempt
+        if (next < addrs.size() && now >= nextStart) {
+            size_t index = next++;
+            nextStart = now + kConnectionAttemptDelay;
+            struct sockaddr_storage addr;
+            int addrlen;
+            if (!toSockaddr(addrs[index], port, &addr, &addrlen)) {
+                lastErr = error::inval;
+                nextStart = now;
+                continue;
+            }
+            SOCKET fd = socket(addr.ss_family, SOCK_STREAM, 0);
+            if (fd == INVALID_SOCKET) {
+                lastErr = error::wrap(etype::os, WSAGetLastError());
+                nextStart = now;
+                continue;
+            }
+            ioctlsocket(fd, FIONBIO, &kNonBlockingMode);
+            if (connect(fd, (struct sockaddr*) &addr, addrlen) == 0) {
+                winner = fd;
+                winnerIndex = index;
+                winnerStart = now;
+                break;
+            }
+            int connErr = WSAGetLastError();
+            if (connErr != WSAEWOULDBLOCK) {
+                closesocket(fd);
+                internal::recordLatency(addrs[index], -1);
+                lastErr = error::wrap(etype::os, connErr);
+                nextStart = now; // fail over at once
+                continue;
+            }
+            attempts.push_back({fd, index, now});
+        }
+        if (attempts.empty()) {
+            if (next >= addrs.size()) {
+                return lastErr;
+            }
+            continue;
+        }
+
+        // wait until an attempt completes, the next one is due, or the deadline passes
+        int64_t wakeup = deadline;
+        if (next < addrs.size() && nextStart < wakeup) {
+            wakeup = nextStart;
+        }
+        fd_set writefds, exceptfds;
+        FD_ZERO(&writefds);
+        FD_ZERO(&exceptfds);
+        for (auto& attempt : attempts) {
+            FD_SET(attempt.FD, &writefds);
+            FD_SET(attempt.FD, &exceptfds);
+        }
+        struct timeval timeout;
+        toTimeval(wakeup - now, &timeout);
+        int result = select(0, nullptr, &writefds, &exceptfds, (wakeup == INT64_MAX) ? nullptr : &timeout);
+        if (result == SOCKET_ERROR) {
+            int selectErr = WSAGetLastError();
+            closeAll();
+            return error::wrap(etype::os, selectErr);
+        }
+        now = monotonicMilliseconds();
+        for (size_t i = attempts.size(); i-- > 0;) { // backwards, to erase failed attempts in place
+            Attempt attempt = attempts[i];
+            bool failed = FD_ISSET(attempt.FD, &exceptfds) != 0;
+            if (!failed && !FD_ISSET(attempt.FD, &writefds)) {
+                continue;
+            }
+            attempts.erase(attempts.begin() + i);
+            if (!failed && winner == INVALID_SOCKET) {
+                winner = attempt.FD;
+                winnerIndex = attempt.Index;
+                winnerStart = attempt.Start;
+                continue;
+            }
+            if (failed) {
+                int soErr = 0;
+                int optlen = sizeof(soErr);
+                getsockopt(attempt.FD, SOL_SOCKET, SO_ERROR, (char*) &soErr, &optlen);
+                internal::recordLatency(addrs[attempt.Index], -1);
+                lastErr = error::wrap(etype::os, soErr);
+                nextStart = now; // fail over at once
+            }
+            closesocket(attempt.FD);
+        }
+    }
+    closeAll();
+
+    internal::recordLatency(addrs[winnerIndex], monotonicMilliseconds() - winnerStart);
+    ioctlsocket(winner, FIONBIO, &kBlockingMode);
+    *clientSock = std::make_shared<TCPSocket>(winner, addrs[winnerIndex], port);
+    return error::nil;
+}
+
 error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
+    return ListenTCP(port, SocketOptions(), serverSock);
+}
+
+error ListenTCP(uint16_t port, const SocketOptions& options, std::shared_ptr<TCPListener>* serverSock) {
     if (serverSock == nullptr) {
         assert(0 && "serverSock must not be nullptr");
         return error::illegal_argument;
@@ -122,6 +341,11 @@ error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
         closesocket(fd);
         return error::wrap(etype::os, err);
     }
+    error optErr = internal::applySocketOptions(fd, options, true);
+    if (optErr != error::nil) {
+        closesocket(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -133,7 +357,7 @@ error ListenTCP(uint16_t port, std::shared_ptr<TCPListener>* serverSock) {
         return error::wrap(etype::os, err);
     }
 
-    if (listen(fd, SOMAXCONN) == SOCKET_ERROR) {
+    if (listen(fd, (options.Backlog > 0) ? options.Backlog : SOMAXCONN) == SOCKET_ERROR) {
         int err = WSAGetLastError();
         closesocket(fd);
         return error::wrap(etype::os, err);
@@ -159,6 +383,18 @@ error TCPSocket::Close() {
     return error::nil;
 }
 
+error TCPSocket::CloseWrite() {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (shutdown(m_fd, SD_SEND) == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    return error::nil;
+}
+
 static error read(const SocketFD& fd, char* buf, size_t len, int* nbytes) {
     int size = recv(fd, buf, len, 0);
     if (size == SOCKET_ERROR) {
@@ -179,7 +415,7 @@ error TCPSocket::Read(char* buf, size_t len, int* nbytes) {
         return error::illegal_state;
     }
 
-    if (m_timeoutMilliseconds > 0) {
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
         fd_set readfds;
         error err = waitUntilReady(m_fd, &readfds, nullptr, nullptr, m_timeoutMilliseconds);
         if (err != error::nil) {
@@ -189,6 +425,38 @@ error TCPSocket::Read(char* buf, size_t len, int* nbytes) {
     return read(m_fd, buf, len, nbytes);
 }
 
+error TCPSocket::ReadV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
+        fd_set readfds;
+        error err = waitUntilReady(m_fd, &readfds, nullptr, nullptr, m_timeoutMilliseconds);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    std::vector<WSABUF> bufs = internal::toWSABufs(iov, iovcnt);
+    DWORD size = 0;
+    DWORD flags = 0;
+    if (WSARecv(m_fd, bufs.data(), (DWORD) bufs.size(), &size, &flags, nullptr, nullptr) == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
 static error write(const SocketFD& fd, const char* buf, size_t len, int* nbytes) {
     int size = send(fd, buf, len, 0);
     if (size == SOCKET_ERROR) {
@@ -206,7 +474,7 @@ error TCPSocket::Write(const char* buf, size_t len, int* nbytes) {
         return error::illegal_state;
     }
 
-    if (m_timeoutMilliseconds > 0) {
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
         fd_set writefds;
         error err = waitUntilReady(m_fd, nullptr, &writefds, nullptr, m_timeoutMilliseconds);
         if (err != error::nil) {
@@ -216,21 +484,91 @@ error TCPSocket::Write(const char* buf, size_t len, int* nbytes) {
     return write(m_fd, buf, len, nbytes);
 }
 
+error TCPSocket::WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
+        fd_set writefds;
+        error err = waitUntilReady(m_fd, nullptr, &writefds, nullptr, m_timeoutMilliseconds);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+    std::vector<WSABUF> bufs = internal::toWSABufs(iov, iovcnt);
+    DWORD size = 0;
+    if (WSASend(m_fd, bufs.data(), (DWORD) bufs.size(), &size, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
+error TCPSocket::SendFile(int fd, int64_t offset, size_t length, size_t* sent) {
+    if (sent != nullptr) {
+        *sent = 0;
+    }
+    return error::opnotsupp;
+}
+
+error TCPSocket::Splice(int pipeFD, size_t length, size_t* sent) {
+    if (sent != nullptr) {
+        *sent = 0;
+    }
+    return error::opnotsupp;
+}
+
+error TCPSocket::SetZeroCopy(bool on) {
+    return error::opnotsupp;
+}
+
+error TCPSocket::WriteZeroCopy(const char* buf, size_t len, int* nbytes, uint32_t* id) {
+    return error::opnotsupp;
+}
+
+error TCPSocket::ReadZeroCopyCompletions(std::vector<ZeroCopyCompletion>* completions) {
+    return error::opnotsupp;
+}
+
 error TCPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     if (m_closed) {
         assert(0 && "Already closed");
         return error::illegal_state;
     }
 
-    if (timeoutMilliseconds > 0) {
-        ioctlsocket(m_fd, FIONBIO, &kNonBlockingMode);
-    } else {
-        ioctlsocket(m_fd, FIONBIO, &kBlockingMode);
+    if (!m_nonBlocking) { // the timeout is emulated by select() on a non-blocking socket
+        if (timeoutMilliseconds > 0) {
+            ioctlsocket(m_fd, FIONBIO, &kNonBlockingMode);
+        } else {
+            ioctlsocket(m_fd, FIONBIO, &kBlockingMode);
+        }
     }
     m_timeoutMilliseconds = timeoutMilliseconds;
     return error::nil;
 }
 
+error TCPSocket::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on || m_timeoutMilliseconds > 0);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 error TCPSocket::SetKeepAlive(bool on) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -244,6 +582,10 @@ error TCPSocket::SetKeepAlive(bool on) {
     return error::nil;
 }
 
+error TCPSocket::SetCork(bool on) {
+    return error::opnotsupp;
+}
+
 error TCPSocket::SetKeepAlivePeriod(int periodSeconds) {
     if (periodSeconds < 1) {
         assert(0 && "periodSeconds must not be less than 1");
@@ -265,6 +607,17 @@ error TCPSocket::SetKeepAlivePeriod(int periodSeconds) {
     return error::nil;
 }
 
+std::string TCPSocket::RemoteAddress() {
+    std::call_once(m_formatted, [this]() {
+        if (m_remoteAddr.empty()) {
+            struct in_addr addr = {0};
+            addr.s_addr = m_remoteIPv4;
+            m_remoteAddr = inet_ntoa(addr);
+        }
+    });
+    return m_remoteAddr;
+}
+
 TCPListener::~TCPListener() {
     Close();
 }
@@ -281,6 +634,32 @@ error TCPListener::Close() {
     return error::nil;
 }
 
+error TCPListener::Shutdown() {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    // shutdown does not apply to a listening socket; only closesocket wakes up accept
+    return error::opnotsupp;
+}
+
+static error acceptSocket(const SocketFD& fd, bool nonBlocking, struct sockaddr_in* addr, SOCKET* clientFD) {
+    int addrlen = sizeof(*addr);
+    *clientFD = accept(fd, (struct sockaddr*) addr, &addrlen);
+    if (*clientFD == INVALID_SOCKET) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    if (nonBlocking) {
+        error err = internal::setNonBlocking(*clientFD, true);
+        if (err != error::nil) {
+            closesocket(*clientFD);
+            return err;
+        }
+    }
+    return error::nil;
+}
+
 error TCPListener::Accept(std::shared_ptr<TCPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
@@ -291,7 +670,7 @@ error TCPListener::Accept(std::shared_ptr<TCPSocket>* clientSock) {
         return error::illegal_state;
     }
 
-    if (m_timeoutMilliseconds > 0) {
+    if (m_timeoutMilliseconds > 0 && !m_nonBlocking) {
         fd_set readfds;
         error err = waitUntilReady(m_fd, &readfds, nullptr, nullptr, m_timeoutMilliseconds);
         if (err != error::nil) {
@@ -300,15 +679,57 @@ error TCPListener::Accept(std::shared_ptr<TCPSocket>* clientSock) {
     }
 
     struct sockaddr_in clientAddr = {0};
-    int addrlen = sizeof(clientAddr);
-    SOCKET clientFD = accept(m_fd, (struct sockaddr*) &clientAddr, &addrlen);
-    if (clientFD == INVALID_SOCKET) {
-        return error::wrap(etype::os, WSAGetLastError());
+    SOCKET clientFD = INVALID_SOCKET;
+    error err = acceptSocket(m_fd, m_nonBlocking, &clientAddr, &clientFD);
+    if (err != error::nil) {
+        return err;
     }
+    *clientSock = std::make_shared<TCPSocket>(clientFD, clientAddr.sin_addr.s_addr, ntohs(clientAddr.sin_port),
+            m_nonBlocking);
+    return error::nil;
+}
 
-    std::string remoteAddr = inet_ntoa(clientAddr.sin_addr);
-    uint16_t remotePort = ntohs(clientAddr.sin_port);
-    *clientSock = std::make_shared<TCPSocket>(clientFD, std::move(remoteAddr), remotePort);
+error TCPListener::AcceptMany(std::vector<std::shared_ptr<TCPSocket>>* clientSocks, size_t maxCount) {
+    if (clientSocks == nullptr) {
+        assert(0 && "clientSocks must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    size_t count = 0;
+    while (count < maxCount) {
+        if (!m_nonBlocking) {
+            // wait for the first connection only; poll the backlog for the rest
+            int64_t timeout = (count == 0) ? m_timeoutMilliseconds : 0;
+            if (count > 0 || timeout > 0) {
+                fd_set readfds;
+                error err = waitUntilReady(m_fd, &readfds, nullptr, nullptr, timeout);
+                if (err == error::timedout && count > 0) {
+                    return error::nil;
+                }
+                if (err != error::nil) {
+                    return err;
+                }
+            }
+        }
+
+        struct sockaddr_in clientAddr = {0};
+        SOCKET clientFD = INVALID_SOCKET;
+        error err = acceptSocket(m_fd, true, &clientAddr, &clientFD);
+        if (err == error::intr || err == error::connaborted) {
+            continue;
+        }
+        if (err != error::nil) {
+            return err;
+        }
+        // leave the address unformatted, which is not needed by most servers
+        clientSocks->push_back(std::make_shared<TCPSocket>(clientFD, clientAddr.sin_addr.s_addr,
+                ntohs(clientAddr.sin_port), true));
+        count++;
+    }
     return error::nil;
 }
 
@@ -322,4 +743,18 @@ error TCPListener::SetTimeout(int64_t timeoutMilliseconds) {
     return error::nil;
 }
 
+error TCPListener::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 } // namespace net
@@ -0,0 +1,144 @@
+#include "netlib/timer.h"
+#include <cassert>
+
+namespace net {
+
+TimerWheel::TimerWheel(int64_t nowMilliseconds, int64_t tickMilliseconds)
+        : m_tick(tickMilliseconds > 0 ? tickMilliseconds : 1),
+          m_current(nowMilliseconds > 0 ? (uint64_t) (nowMilliseconds / m_tick) : 0),
+          m_nextID(1),
+          m_counts() {}
+
+TimerID TimerWheel::Schedule(int64_t expiresAtMilliseconds, const std::function<void()>& task) {
+    // round up, so that a timer never fires before its time
+    uint64_t expires = (expiresAtMilliseconds > 0) ? (uint64_t) ((expiresAtMilliseconds + m_tick - 1) / m_tick) : 0;
+    if (expires <= m_current) {
+        expires = m_current + 1;
+    }
+
+    TimerID id = m_nextID++;
+    Timer& timer = m_timers[id];
+    timer.Expires = expires;
+    timer.Task = task;
+    insert(id, &timer);
+    return id;
+}
+
+bool TimerWheel::Cancel(TimerID id) {
+    auto it = m_timers.find(id);
+    if (it == m_timers.end()) {
+        return false;
+    }
+    m_counts[it->second.Level]--;
+    m_timers.erase(it);
+    return true;
+}
+
+void TimerWheel::insert(TimerID id, Timer* timer) {
+    uint64_t delta = timer->Expires - m_current;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= ((uint64_t) 1 << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+    uint64_t expires = timer->Expires;
+    uint64_t limit = (uint64_t) 1 << (kSlotBits * kLevels);
+    if (delta >= limit) { // out of range; cascaded again when the slot comes around
+        expires = m_current + limit - 1;
+    }
+    int slot = (int) ((expires >> (kSlotBits * level)) & (kSlots - 1));
+    timer->Level = level;
+    m_slots[level][slot].push_back(id);
+    m_counts[level]++;
+}
+
+void TimerWheel::cascade(int level) {
+    int slot = (int) ((m_current >> (kSlotBits * level)) & (kSlots - 1));
+    std::vector<TimerID> ids;
+    ids.swap(m_slots[level][slot]);
+    for (TimerID id : ids) {
+        auto it = m_timers.find(id);
+        if (it == m_timers.end() || it->second.Level != level) {
+            continue; // cancelled
+        }
+        m_counts[level]--;
+        insert(id, &it->second);
+    }
+}
+
+size_t TimerWheel::Advance(int64_t nowMilliseconds) {
+    uint64_t target = (nowMilliseconds > 0) ? (uint64_t) (nowMilliseconds / m_tick) : 0;
+    size_t fired = 0;
+    while (m_current < target) {
+        if (m_timers.empty()) {
+            m_current = target;
+            break;
+        }
+        int lowest = 0;
+        while (m_counts[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest > 0) { // skip to the tick before the next cascade of the lowest level in use
+            int shift = kSlotBits * lowest;
+            uint64_t boundary = ((m_current >> shift) + 1) << shift;
+            m_current = (boundary - 1 < target) ? boundary - 1 : target;
+            if (m_current == target) {
+                break;
+            }
+        }
+        m_current++;
+        for (int level = 1; level < kLevels; level++) {
+            if ((m_current & (((uint64_t) 1 << (kSlotBits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::vector<TimerID> ids;
+        ids.swap(m_slots[0][m_current & (kSlots - 1)]);
+        for (TimerID id : ids) {
+            auto it = m_timers.find(id);
+            if (it == m_timers.end() || it->second.Level != 0) {
+                continue; // cancelled
+            }
+            assert(it->second.Expires <= m_current);
+            std::function<void()> task = std::move(it->second.Task);
+            m_counts[0]--;
+            m_timers.erase(it);
+            task();
+            fired++;
+        }
+    }
+    return fired;
+}
+
+int64_t TimerWheel::NextTimeout(int64_t nowMilliseconds) {
+    if (m_timers.empty()) {
+        return -1;
+    }
+
+    // the earliest tick when a slot in use is processed; a lower bound of the next expiry
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < kLevels; level++) {
+        if (m_counts[level] == 0) {
+            continue;
+        }
+        int shift = kSlotBits * level;
+        for (uint64_t i = 1; i <= (uint64_t) kSlots; i++) {
+            uint64_t tick = ((m_current >> shift) + i) << shift;
+            if (tick >= next) {
+                break;
+            }
+            if (!m_slots[level][tick >> shift & (kSlots - 1)].empty()) {
+                next = tick;
+                break;
+            }
+        }
+    }
+    if (next == UINT64_MAX) {
+        return -1;
+    }
+    int64_t timeout = (int64_t) next * m_tick - nowMilliseconds;
+    return (timeout > 0) ? timeout : 0;
+}
+
+} // namespace net
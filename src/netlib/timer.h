@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace net {
+
+using TimerID = uint64_t;
+
+/**
+ * A hierarchical timing wheel, which schedules and cancels a timer in O(1).
+ * Four levels of 64 slots cover 2^24 ticks, and a timer beyond that range
+ * is kept in the last level until it comes into range.
+ *
+ * Time is given by the caller in milliseconds of any monotonic clock.
+ * Not thread-safe.
+ */
+class TimerWheel final {
+public:
+    /**
+     * @param[in] nowMilliseconds The current time
+     * @param[in] tickMilliseconds The resolution of timers
+     */
+    explicit TimerWheel(int64_t nowMilliseconds, int64_t tickMilliseconds = 1);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @param[in] expiresAtMilliseconds The time when task is run. A past time fires at the next tick.
+     * @param[in] task
+     * @return the id of the timer, which is never 0
+     */
+    TimerID Schedule(int64_t expiresAtMilliseconds, const std::function<void()>& task);
+    /**
+     * @param[in] id
+     * @return false if the timer has already fired or been cancelled
+     */
+    bool Cancel(TimerID id);
+    /**
+     * Run the tasks of the timers which have expired by nowMilliseconds.
+     * Tasks may schedule and cancel timers.
+     *
+     * @param[in] nowMilliseconds
+     * @return the number of tasks run
+     */
+    size_t Advance(int64_t nowMilliseconds);
+    /**
+     * @param[in] nowMilliseconds
+     * @return milliseconds until Advance should be called next, or -1 if no timer is scheduled
+     */
+    int64_t NextTimeout(int64_t nowMilliseconds);
+    /**
+     * @return the number of scheduled timers
+     */
+    size_t Size() { return m_timers.size(); }
+
+private:
+    static const int kLevels = 4;
+    static const int kSlotBits = 6;
+    static const int kSlots = 1 << kSlotBits;
+
+    struct Timer {
+        uint64_t Expires; // in ticks
+        int Level;
+        std::function<void()> Task;
+    };
+
+    const int64_t m_tick;
+    uint64_t m_current; // the last tick which has been processed
+    TimerID m_nextID;
+    std::unordered_map<TimerID, Timer> m_timers;
+    // cancelled timers are only dropped from m_timers, and skipped when their slot is processed
+    std::vector<TimerID> m_slots[kLevels][kSlots];
+    size_t m_counts[kLevels];
+
+    void insert(TimerID id, Timer* timer);
+    void cascade(int level);
+};
+
+} // namespace net
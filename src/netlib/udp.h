@@ -1,21 +1,47 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <atomic>
 #include <memory>
 #include <string>
+#include "netlib/endpoint.h"
 #include "netlib/error.h"
 #include "netlib/fd.h"
+#include "netlib/socket_options.h"
 #include "netlib/stream.h"
 
 namespace net {
 
+/**
+ * A datagram of a batch, whose buffer is owned by the caller.
+ */
+struct Datagram {
+    /** The payload */
+    char* Buf;
+    /** The capacity of Buf on read, or the length of the payload on write */
+    size_t Len;
+    /** The length of the payload read */
+    size_t Size;
+    /** The peer. On write, the datagram is sent to the remote of ConnectUDP if unspecified. */
+    Endpoint Peer;
+    /** true if the datagram was larger than Len, and the rest has been discarded */
+    bool Truncated;
+};
+
 class UDPSocket final : public ReadWriteCloser {
 public:
+    static const size_t kMaxSegments = 64;            // per WriteSegmented
+    static const size_t kMaxSegmentedLength = 65507;  // the largest UDP payload over IPv4
+
     UDPSocket(const SocketFD& fd)
-            : m_fd(fd), m_remoteAddr(""), m_remotePort(0), m_closed(false) {}
-    UDPSocket(const SocketFD& fd, const std::string& addr, uint16_t port)
-            : m_fd(fd), m_remoteAddr(addr), m_remotePort(port), m_closed(false) {}
+            : m_fd(fd), m_remoteAddr(""), m_remotePort(0), m_connected(false),
+              m_closed(false), m_nonBlocking(false), m_noSegmentation(false) {}
+    UDPSocket(const SocketFD& fd, const std::string& addr, uint16_t port, bool connected = false)
+            : m_fd(fd), m_remoteAddr(addr), m_remotePort(port), m_connected(connected),
+              m_closed(false), m_nonBlocking(false), m_noSegmentation(false) {
+        Endpoint::Parse(addr, port, &m_remote);
+    }
     ~UDPSocket();
     UDPSocket(const UDPSocket&) = delete;
     UDPSocket& operator=(const UDPSocket&) = delete;
@@ -23,24 +49,112 @@ public:
     bool IsClosed() { return m_closed; }
     error Close();
     error Read(char* buf, size_t len, int* nbytes);
+    /**
+     * Scatter a single datagram into the buffers.
+     */
+    error ReadV(const IOVec* iov, size_t iovcnt, int* nbytes);
     error ReadFrom(char* buf, size_t len, int* nbytes,
             std::string* addr, uint16_t* port);
+    /**
+     * Receive a datagram without formatting the address of the peer.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[out] nbytes
+     * @param[out] from
+     */
+    error ReadFrom(char* buf, size_t len, int* nbytes, Endpoint* from);
     error Write(const char* buf, size_t len, int* nbytes);
+    /**
+     * Gather the buffers into a single datagram.
+     */
+    error WriteV(const IOVec* iov, size_t iovcnt, int* nbytes);
     error WriteTo(const char* buf, size_t len,
             const std::string& addr, uint16_t port, int* nbytes);
+    /**
+     * Send a datagram without parsing the address of the peer.
+     *
+     * @param[in] buf
+     * @param[in] len
+     * @param[in] to
+     * @param[out] nbytes
+     */
+    error WriteTo(const char* buf, size_t len, const Endpoint& to, int* nbytes);
+    /**
+     * Receive up to count datagrams with a single system call where supported (recvmmsg).
+     * Blocks until the first datagram arrives, and then takes only the datagrams already queued.
+     *
+     * @param[in,out] msgs Buf and Len are read, and the rest are set for each datagram received
+     * @param[in] count
+     * @param[out] nmsgs The number of datagrams received
+     */
+    error ReadBatch(Datagram* msgs, size_t count, size_t* nmsgs);
+    /**
+     * Send the datagrams with as few system calls as possible (sendmmsg).
+     *
+     * @param[in] msgs
+     * @param[in] count
+     * @param[out] nmsgs The number of datagrams sent, which are less than count on error
+     */
+    error WriteBatch(const Datagram* msgs, size_t count, size_t* nmsgs);
+    /**
+     * Send msg as datagrams of segmentSize bytes each, of which only the last may be shorter.
+     * With UDP generic segmentation offload (UDP_SEGMENT, Linux), the kernel or the NIC splits
+     * the payload, so that a single system call and a single trip through the stack serve
+     * every datagram. Otherwise, or once the kernel or the device has refused segmentation
+     * on this socket, the datagrams are sent one by one.
+     *
+     * @param[in] msg Up to kMaxSegmentedLength bytes in total
+     * @param[in] segmentSize Up to 65535, and at least the total length divided by kMaxSegments
+     * @param[out] nbytes The number of bytes sent, including those before a failure of the sends one by one
+     * @return error::illegal_argument if msg or segmentSize exceeds the limits
+     */
+    error WriteSegmented(const Datagram& msg, size_t segmentSize, int* nbytes);
+    /**
+     * Let the kernel coalesce the datagrams of a flow into a single read (UDP_GRO, Linux),
+     * which are split at the segment size reported by ReadCoalesced.
+     *
+     * @param[in] on
+     * @return error::opnotsupp if the platform lacks UDP_GRO
+     */
+    error SetReceiveCoalescing(bool on);
+    /**
+     * Receive a datagram, or the datagrams coalesced by SetReceiveCoalescing,
+     * which are of segmentSize bytes each except the last.
+     * Len should be 64 KB not to truncate them.
+     *
+     * @param[in,out] msg Buf and Len are read, and the rest are set
+     * @param[out] segmentSize msg->Size if the datagram has not been coalesced
+     */
+    error ReadCoalesced(Datagram* msg, size_t* segmentSize);
     /**
      * @param[in] timeoutMilliseconds Set the timeout in milliseconds. Block if 0 or a negative integer is specified.
      */
     error SetTimeout(int64_t timeoutMilliseconds);
+    /**
+     * In non-blocking mode, the reads and the writes return error::wouldblock instead of blocking.
+     *
+     * @param[in] on
+     */
+    error SetNonBlocking(bool on);
+    bool IsNonBlocking() { return m_nonBlocking; }
     SocketFD FD() { return m_fd; }
     std::string RemoteAddress() { return m_remoteAddr; }
     uint16_t RemotePort() { return m_remotePort; }
+    /**
+     * @return true if the socket is connected to the remote by ConnectUDP
+     */
+    bool IsConnected() { return m_connected; }
 
 private:
     const SocketFD m_fd;
     const std::string m_remoteAddr;
     const uint16_t m_remotePort;
+    Endpoint m_remote; // parsed once for the writes
+    const bool m_connected;
     std::atomic<bool> m_closed;
+    bool m_nonBlocking;
+    std::atomic<bool> m_noSegmentation; // UDP_SEGMENT has been refused, so the segments are sent one by one
 };
 
 /**
@@ -50,10 +164,40 @@ private:
  */
 error ConnectUDP(const std::string& host, uint16_t port, std::shared_ptr<UDPSocket>* clientSock);
 
+/**
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[in] options
+ * @param[out] clientSock
+ */
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options,
+        std::shared_ptr<UDPSocket>* clientSock);
+
+/**
+ * With connect, the socket is connected to the remote, so that the kernel caches the route,
+ * the datagrams from the other peers are dropped, and Write and Read go straight to send and recv.
+ * An ICMP port unreachable from the remote fails a later read or write with error::connrefused.
+ *
+ * @param[in] host A hostname or IPv4
+ * @param[in] port
+ * @param[in] options
+ * @param[in] connect
+ * @param[out] clientSock
+ */
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options, bool connect,
+        std::shared_ptr<UDPSocket>* clientSock);
+
 /**
  * @param[in] port
  * @param[out] serverSock
  */
 error ListenUDP(uint16_t port, std::shared_ptr<UDPSocket>* serverSock);
 
+/**
+ * @param[in] port
+ * @param[in] options Set before binding
+ * @param[out] serverSock
+ */
+error ListenUDP(uint16_t port, const SocketOptions& options, std::shared_ptr<UDPSocket>* serverSock);
+
 } // namespace net
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "netlib/error.h"
+#include "netlib/event_loop.h"
+#include "netlib/stream.h"
+#include "netlib/udp.h"
+
+namespace net {
+
+/**
+ * Called on the worker thread which has received the datagrams, which are valid until it returns.
+ * Reply through sock, the socket of the shard.
+ */
+using ShardedDatagramHandler = std::function<void(UDPSocket* sock, Datagram* msgs, size_t count)>;
+
+struct ShardedUDPConfig {
+    /**
+     * Pin the worker of each shard to the CPUs which MapCPUsToShards maps to it
+     * out of the affinity mask of the calling thread, or to one of its own if there are more shards than CPUs.
+     */
+    bool PinCPUs;
+    /**
+     * Attach a classic BPF program to the SO_REUSEPORT group (SO_ATTACH_REUSEPORT_CBPF),
+     * which hands each datagram to the shard which MapCPUsToShards maps the receiving CPU to.
+     * With RSS or RPS, the datagrams of a flow then stay on a single core, the one of the worker with PinCPUs.
+     */
+    bool SteerByCPU;
+    /** The buffer size for each datagram. Longer datagrams are truncated. 2048 if 0 is specified. */
+    size_t DatagramSize;
+    /** The number of datagrams read at once. 64 if 0 is specified. */
+    size_t BatchSize;
+};
+
+/**
+ * A set of SO_REUSEPORT UDP sockets bound to the same port,
+ * each of which is drained by its own worker thread and event loop.
+ * The kernel spreads incoming datagrams across the sockets by the hash of the flow,
+ * or by the CPU with ShardedUDPConfig::SteerByCPU.
+ */
+class ShardedUDPListener final : public Closer {
+public:
+    struct Shard {
+        std::shared_ptr<UDPSocket> Socket;
+        std::shared_ptr<EventLoop> Loop;
+        std::thread Worker;
+        std::vector<char> Buffer;
+        std::vector<Datagram> Msgs;
+        std::atomic<uint64_t> Received;
+    };
+
+    ShardedUDPListener(std::vector<std::unique_ptr<Shard>>&& shards, uint16_t port)
+            : m_shards(std::move(shards)), m_port(port), m_closed(false) {}
+    ~ShardedUDPListener();
+    ShardedUDPListener(const ShardedUDPListener&) = delete;
+    ShardedUDPListener& operator=(const ShardedUDPListener&) = delete;
+
+    bool IsClosed() { return m_closed; }
+    /**
+     * Stop the workers and close the sockets.
+     * Must not be called from a worker thread.
+     */
+    error Close();
+    uint16_t Port() { return m_port; }
+    size_t Size() { return m_shards.size(); }
+    /**
+     * @param[in] shard
+     * @return the event loop of the shard
+     */
+    std::shared_ptr<EventLoop> Loop(size_t shard) { return m_shards[shard]->Loop; }
+    /**
+     * @param[in] shard
+     * @return the number of datagrams which have been received by the shard
+     */
+    uint64_t Received(size_t shard) { return m_shards[shard]->Received; }
+
+private:
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    const uint16_t m_port;
+    std::atomic<bool> m_closed;
+};
+
+/**
+ * Map the i-th CPU to the shard i modulo nShards.
+ *
+ * @param[in] cpus The CPUs in ascending order, e.g. those of an affinity mask
+ * @param[in] nShards
+ * @return the shard of each CPU, indexed by the CPU; -1 for the CPUs which are not listed
+ */
+std::vector<int> MapCPUsToShards(const std::vector<int>& cpus, int nShards);
+
+/**
+ * Listen with ShardedUDPConfig::PinCPUs on and the defaults for the rest.
+ *
+ * @param[in] port A random port is chosen if 0 is specified
+ * @param[in] nThreads The number of sockets and worker threads
+ * @param[in] handler
+ * @param[out] serverSock
+ */
+error ListenUDPSharded(uint16_t port, int nThreads, const ShardedDatagramHandler& handler,
+        std::shared_ptr<ShardedUDPListener>* serverSock);
+
+/**
+ * @param[in] port A random port is chosen if 0 is specified
+ * @param[in] nThreads The number of sockets and worker threads
+ * @param[in] config
+ * @param[in] handler
+ * @param[out] serverSock
+ */
+error ListenUDPSharded(uint16_t port, int nThreads, const ShardedUDPConfig& config,
+        const ShardedDatagramHandler& handler, std::shared_ptr<ShardedUDPListener>* serverSock);
+
+} // namespace net
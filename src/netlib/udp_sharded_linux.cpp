@@ -0,0 +1,245 @@
+#include "netlib/udp_sharded.h"
+#include <cassert>
+#include <cerrno>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include "netlib/internal/init.h"
+#include "netlib/resolver.h"
+
+namespace net {
+
+static const size_t kDefaultDatagramSize = 2048;
+static const size_t kDefaultBatchSize = 64;
+
+static error listenReusePort(uint16_t port, std::shared_ptr<UDPSocket>* serverSock) {
+    SocketOptions options = SocketOptions();
+    options.ReusePort = true;
+    std::shared_ptr<UDPSocket> sock;
+    error err = ListenUDP(port, options, &sock);
+    if (err != error::nil) {
+        return err;
+    }
+    err = sock->SetNonBlocking(true);
+    if (err != error::nil) {
+        return err;
+    }
+    *serverSock = std::move(sock);
+    return error::nil;
+}
+
+static error allowedCPUs(std::vector<int>* cpus) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus->push_back(cpu);
+        }
+    }
+    if (cpus->empty()) {
+        return error::illegal_state;
+    }
+    return error::nil;
+}
+
+static error steerByCPU(int fd, const std::vector<int>& shardOfCPU, uint32_t nShards) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    // the index of the socket in the group, in the order of binding, is looked up by the CPU
+    std::vector<struct sock_filter> code;
+    code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU)});
+    for (size_t cpu = 0; cpu < shardOfCPU.size(); cpu++) {
+        if (shardOfCPU[cpu] >= 0) {
+            code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1, (uint32_t) cpu});
+            code.push_back({BPF_RET | BPF_K, 0, 0, (uint32_t) shardOfCPU[cpu]});
+        }
+    }
+    // a CPU outside of the table, e.g. one which the affinity mask has left out, goes modulo the shards
+    code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, nShards});
+    code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+    struct sock_fprog prog = {(unsigned short) code.size(), code.data()};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+#else
+    return error::opnotsupp;
+#endif // SO_ATTACH_REUSEPORT_CBPF
+}
+
+static error pinCPUs(std::vector<std::unique_ptr<ShardedUDPListener::Shard>>& shards,
+        const std::vector<int>& cpus, const std::vector<int>& shardOfCPU) {
+    for (size_t i = 0; i < shards.size(); i++) {
+        // the CPUs which are steered to the shard, or one of its own if there are more shards than CPUs
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t cpu = 0; cpu < shardOfCPU.size(); cpu++) {
+            if (shardOfCPU[cpu] == (int) i) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (CPU_COUNT(&set) == 0) {
+            CPU_SET(cpus[i % cpus.size()], &set);
+        }
+        int err = pthread_setaffinity_np(shards[i]->Worker.native_handle(), sizeof(set), &set);
+        if (err != 0) {
+            return error::wrap(etype::os, err);
+        }
+    }
+    return error::nil;
+}
+
+static void receiveAll(ShardedUDPListener::Shard* shard, size_t datagramSize,
+        const ShardedDatagramHandler& handler) {
+    while (true) {
+        for (size_t i = 0; i < shard->Msgs.size(); i++) {
+            shard->Msgs[i].Buf = &shard->Buffer[i * datagramSize];
+            shard->Msgs[i].Len = datagramSize;
+        }
+        size_t nmsgs = 0;
+        error err = shard->Socket->ReadBatch(shard->Msgs.data(), shard->Msgs.size(), &nmsgs);
+        if (err == error::connrefused || err == error::hostunreach || err == error::netunreach) {
+            continue; // an ICMP error queued by a reply, which concerns that datagram only
+        }
+        if (err != error::nil) { // wouldblock once drained; return on the others so as not to spin
+            return;
+        }
+        shard->Received += nmsgs;
+        handler(shard->Socket.get(), shard->Msgs.data(), nmsgs);
+    }
+}
+
+std::vector<int> MapCPUsToShards(const std::vector<int>& cpus, int nShards) {
+    std::vector<int> shardOfCPU;
+    if (nShards < 1) {
+        assert(0 && "nShards must not be less than 1");
+        return shardOfCPU;
+    }
+
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] >= (int) shardOfCPU.size()) {
+            shardOfCPU.resize(cpus[i] + 1, -1);
+        }
+        shardOfCPU[cpus[i]] = (int) (i % nShards);
+    }
+    return shardOfCPU;
+}
+
+error ListenUDPSharded(uint16_t port, int nThreads, const ShardedDatagramHandler& handler,
+        std::shared_ptr<ShardedUDPListener>* serverSock) {
+    ShardedUDPConfig config = ShardedUDPConfig();
+    config.PinCPUs = true;
+    return ListenUDPSharded(port, nThreads, config, handler, serverSock);
+}
+
+error ListenUDPSharded(uint16_t port, int nThreads, const ShardedUDPConfig& config,
+        const ShardedDatagramHandler& handler, std::shared_ptr<ShardedUDPListener>* serverSock) {
+    if (nThreads < 1) {
+        assert(0 && "nThreads must not be less than 1");
+        return error::illegal_argument;
+    }
+    if (serverSock == nullptr) {
+        assert(0 && "serverSock must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    internal::init();
+
+    size_t datagramSize = (config.DatagramSize > 0) ? config.DatagramSize : kDefaultDatagramSize;
+    size_t batchSize = (config.BatchSize > 0) ? config.BatchSize : kDefaultBatchSize;
+    std::vector<std::unique_ptr<ShardedUDPListener::Shard>> shards;
+    for (int i = 0; i < nThreads; i++) {
+        std::unique_ptr<ShardedUDPListener::Shard> shard(new ShardedUDPListener::Shard());
+        shard->Received = 0;
+        shard->Buffer.resize(datagramSize * batchSize);
+        shard->Msgs.resize(batchSize);
+        error err = listenReusePort(port, &shard->Socket);
+        if (err != error::nil) {
+            return err;
+        }
+        if (port == 0) { // bind the rest of the sockets to the port chosen by the first one
+            err = LookupPort(shard->Socket->FD(), &port);
+            if (err != error::nil) {
+                return err;
+            }
+        }
+        err = NewEventLoop(&shard->Loop);
+        if (err != error::nil) {
+            return err;
+        }
+        ShardedUDPListener::Shard* s = shard.get();
+        EventHandler socketHandler;
+        socketHandler.OnReadable = [s, datagramSize, handler]() {
+            receiveAll(s, datagramSize, handler);
+        };
+        err = shard->Loop->Add(shard->Socket->FD(), socketHandler);
+        if (err != error::nil) {
+            return err;
+        }
+        shards.push_back(std::move(shard));
+    }
+    // steering and pinning share the table, so that a datagram is handled on the CPU it has been received on
+    std::vector<int> cpus;
+    std::vector<int> shardOfCPU;
+    if (config.PinCPUs || config.SteerByCPU) {
+        error err = allowedCPUs(&cpus);
+        if (err != error::nil) {
+            return err;
+        }
+        shardOfCPU = MapCPUsToShards(cpus, nThreads);
+    }
+    if (config.SteerByCPU) { // applies to the whole group
+        error err = steerByCPU(shards[0]->Socket->FD(), shardOfCPU, (uint32_t) nThreads);
+        if (err != error::nil) {
+            return err;
+        }
+    }
+
+    for (auto& shard : shards) {
+        std::shared_ptr<EventLoop> loop = shard->Loop;
+        shard->Worker = std::thread([loop]() {
+            loop->Run();
+        });
+    }
+    error err = config.PinCPUs ? pinCPUs(shards, cpus, shardOfCPU) : error::nil;
+
+    std::shared_ptr<ShardedUDPListener> listener = std::make_shared<ShardedUDPListener>(std::move(shards), port);
+    if (err != error::nil) {
+        listener->Close();
+        return err;
+    }
+    *serverSock = std::move(listener);
+    return error::nil;
+}
+
+ShardedUDPListener::~ShardedUDPListener() {
+    Close();
+}
+
+error ShardedUDPListener::Close() {
+    if (m_closed) {
+        return error::nil;
+    }
+
+    for (auto& shard : m_shards) {
+        shard->Loop->Stop();
+    }
+    error result = error::nil;
+    for (auto& shard : m_shards) {
+        if (shard->Worker.joinable()) {
+            shard->Worker.join();
+        }
+        shard->Loop->Close();
+        error err = shard->Socket->Close();
+        if (err != error::nil) {
+            result = err;
+        }
+    }
+    m_closed = true;
+    return result;
+}
+
+} // namespace net
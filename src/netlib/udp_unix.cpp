@@ -1,14 +1,36 @@
 #include "netlib/udp.h"
 #include <cassert>
 #include <cerrno>
+#include <cstring>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#ifdef __linux__
+ #include <netinet/udp.h>
+#endif // __linux__
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "netlib/internal/init.h"
+#include "netlib/internal/socket.h"
 #include "netlib/resolver.h"
 
 namespace net {
 
+#ifdef __linux__
+static const size_t kMaxBatchSize = 64; // datagrams per system call, held on the stack
+#endif // __linux__
+
+// nullptr for a connected socket to send to its peer, whose address the kernel keeps
+static struct sockaddr* toSockAddr(const Datagram& msg, const Endpoint& remote, bool connected,
+        struct sockaddr_storage* to, socklen_t* tolen) {
+    if (!msg.Peer.IsSpecified() && connected) {
+        *tolen = 0;
+        return nullptr;
+    }
+    *tolen = (socklen_t) (msg.Peer.IsSpecified() ? msg.Peer : remote).ToSockAddr(to);
+    return (struct sockaddr*) to;
+}
+
 static void toTimeval(int64_t milliseconds, struct timeval* dest) {
     milliseconds = (milliseconds > 0) ? milliseconds : 0;
     dest->tv_sec = milliseconds / 1000;
@@ -16,6 +38,16 @@ static void toTimeval(int64_t milliseconds, struct timeval* dest) {
 }
 
 error ConnectUDP(const std::string& host, uint16_t port, std::shared_ptr<UDPSocket>* clientSock) {
+    return ConnectUDP(host, port, SocketOptions(), clientSock);
+}
+
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options,
+        std::shared_ptr<UDPSocket>* clientSock) {
+    return ConnectUDP(host, port, options, false, clientSock);
+}
+
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options, bool connect,
+        std::shared_ptr<UDPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
         return error::illegal_argument;
@@ -33,12 +65,33 @@ error ConnectUDP(const std::string& host, uint16_t port, std::shared_ptr<UDPSock
     if (fd == -1) {
         return error::wrap(etype::os, errno);
     }
+    err = internal::applySocketOptions(fd, options, false);
+    if (err != error::nil) {
+        close(fd);
+        return err;
+    }
 
-    *clientSock = std::make_shared<UDPSocket>(fd, std::move(remoteAddr), port);
+    if (connect) {
+        struct sockaddr_in serverAddr = {0};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(port);
+        serverAddr.sin_addr.s_addr = inet_addr(remoteAddr.c_str());
+        if (::connect(fd, (struct sockaddr*) &serverAddr, sizeof(serverAddr)) == -1) {
+            int connectErr = errno;
+            close(fd);
+            return error::wrap(etype::os, connectErr);
+        }
+    }
+
+    *clientSock = std::make_shared<UDPSocket>(fd, std::move(remoteAddr), port, connect);
     return error::nil;
 }
 
 error ListenUDP(uint16_t port, std::shared_ptr<UDPSocket>* serverSock) {
+    return ListenUDP(port, SocketOptions(), serverSock);
+}
+
+error ListenUDP(uint16_t port, const SocketOptions& options, std::shared_ptr<UDPSocket>* serverSock) {
     if (serverSock == nullptr) {
         assert(0 && "serverSock must not be nullptr");
         return error::illegal_argument;
@@ -50,6 +103,11 @@ error ListenUDP(uint16_t port, std::shared_ptr<UDPSocket>* serverSock) {
     if (fd == -1) {
         return error::wrap(etype::os, errno);
     }
+    error optErr = internal::applySocketOptions(fd, options, false);
+    if (optErr != error::nil) {
+        close(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -101,6 +159,32 @@ error UDPSocket::Read(char* buf, size_t len, int* nbytes) {
     return error::nil;
 }
 
+error UDPSocket::ReadV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct msghdr msg = {0};
+    msg.msg_iov = internal::toIOVec(iov);
+    msg.msg_iovlen = iovcnt;
+    ssize_t size = recvmsg(m_fd, &msg, 0);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
 error UDPSocket::ReadFrom(char* buf, size_t len, int* nbytes,
             std::string* addr, uint16_t* port) {
     if (m_closed) {
@@ -133,8 +217,49 @@ error UDPSocket::Write(const char* buf, size_t len, int* nbytes) {
     if (m_remoteAddr.empty() && m_remotePort == 0) {
         return error::illegal_state;
     }
+    if (!m_connected) {
+        return WriteTo(buf, len, m_remote, nbytes);
+    }
 
-    return WriteTo(buf, len, m_remoteAddr, m_remotePort, nbytes);
+    ssize_t size = send(m_fd, buf, len, 0);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (m_remoteAddr.empty() && m_remotePort == 0) {
+        return error::illegal_state;
+    }
+
+    struct sockaddr_storage to;
+    struct msghdr msg = {0};
+    if (!m_connected) {
+        msg.msg_name = &to;
+        msg.msg_namelen = m_remote.ToSockAddr(&to);
+    }
+    msg.msg_iov = internal::toIOVec(iov);
+    msg.msg_iovlen = iovcnt;
+    ssize_t size = sendmsg(m_fd, &msg, 0);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
 }
 
 error UDPSocket::WriteTo(const char* buf, size_t len,
@@ -159,6 +284,314 @@ error UDPSocket::WriteTo(const char* buf, size_t len,
     return error::nil;
 }
 
+error UDPSocket::ReadFrom(char* buf, size_t len, int* nbytes, Endpoint* from) {
+    if (from == nullptr) {
+        assert(0 && "from must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    ssize_t size = recvfrom(m_fd, buf, len, 0, (struct sockaddr*) &addr, &addrlen);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    Endpoint::FromSockAddr((struct sockaddr*) &addr, addrlen, from);
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::WriteTo(const char* buf, size_t len, const Endpoint& to, int* nbytes) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (!to.IsSpecified()) {
+        return error::illegal_argument;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addrlen = to.ToSockAddr(&addr);
+    ssize_t size = sendto(m_fd, buf, len, 0, (struct sockaddr*) &addr, addrlen);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::ReadBatch(Datagram* msgs, size_t count, size_t* nmsgs) {
+    if (msgs == nullptr && count > 0) {
+        assert(0 && "msgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (nmsgs == nullptr) {
+        assert(0 && "nmsgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    *nmsgs = 0;
+    if (count == 0) {
+        return error::nil;
+    }
+#ifdef __linux__
+    count = (count < kMaxBatchSize) ? count : kMaxBatchSize;
+    struct mmsghdr hdrs[kMaxBatchSize];
+    struct iovec iov[kMaxBatchSize];
+    struct sockaddr_in from[kMaxBatchSize];
+    memset(hdrs, 0, sizeof(hdrs[0]) * count);
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = msgs[i].Buf;
+        iov[i].iov_len = msgs[i].Len;
+        hdrs[i].msg_hdr.msg_name = &from[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        hdrs[i].msg_hdr.msg_iov = &iov[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = recvmmsg(m_fd, hdrs, count, MSG_WAITFORONE, nullptr);
+    if (n == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    for (int i = 0; i < n; i++) {
+        msgs[i].Size = hdrs[i].msg_len;
+        Endpoint::FromSockAddr((struct sockaddr*) &from[i], hdrs[i].msg_hdr.msg_namelen, &msgs[i].Peer);
+        msgs[i].Truncated = (hdrs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    }
+    *nmsgs = n;
+#else
+    struct sockaddr_in from = {0};
+    struct iovec iov = {msgs[0].Buf, msgs[0].Len};
+    struct msghdr msg = {0};
+    msg.msg_name = &from;
+    msg.msg_namelen = sizeof(from);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    ssize_t size = recvmsg(m_fd, &msg, 0);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    msgs[0].Size = size;
+    Endpoint::FromSockAddr((struct sockaddr*) &from, msg.msg_namelen, &msgs[0].Peer);
+    msgs[0].Truncated = (msg.msg_flags & MSG_TRUNC) != 0;
+    *nmsgs = 1;
+#endif // __linux__
+    return error::nil;
+}
+
+error UDPSocket::WriteBatch(const Datagram* msgs, size_t count, size_t* nmsgs) {
+    if (msgs == nullptr && count > 0) {
+        assert(0 && "msgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (nmsgs == nullptr) {
+        assert(0 && "nmsgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!msgs[i].Peer.IsSpecified() && !m_remote.IsSpecified()) {
+            return error::illegal_state;
+        }
+    }
+
+    *nmsgs = 0;
+#ifdef __linux__
+    struct mmsghdr hdrs[kMaxBatchSize];
+    struct iovec iov[kMaxBatchSize];
+    struct sockaddr_storage to[kMaxBatchSize];
+    while (*nmsgs < count) {
+        const Datagram* batch = &msgs[*nmsgs];
+        size_t n = count - *nmsgs;
+        n = (n < kMaxBatchSize) ? n : kMaxBatchSize;
+        memset(hdrs, 0, sizeof(hdrs[0]) * n);
+        for (size_t i = 0; i < n; i++) {
+            iov[i].iov_base = batch[i].Buf;
+            iov[i].iov_len = batch[i].Len;
+            hdrs[i].msg_hdr.msg_name = toSockAddr(batch[i], m_remote, m_connected,
+                    &to[i], &hdrs[i].msg_hdr.msg_namelen);
+            hdrs[i].msg_hdr.msg_iov = &iov[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int sent = sendmmsg(m_fd, hdrs, n, 0);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        *nmsgs += sent;
+    }
+#else
+    for (; *nmsgs < count; (*nmsgs)++) {
+        const Datagram& msg = msgs[*nmsgs];
+        struct sockaddr_storage to;
+        socklen_t tolen = 0;
+        struct sockaddr* name = toSockAddr(msg, m_remote, m_connected, &to, &tolen);
+        if (sendto(m_fd, msg.Buf, msg.Len, 0, name, tolen) == -1) {
+            return error::wrap(etype::os, errno);
+        }
+    }
+#endif // __linux__
+    return error::nil;
+}
+
+error UDPSocket::WriteSegmented(const Datagram& msg, size_t segmentSize, int* nbytes) {
+    if (msg.Buf == nullptr && msg.Len > 0) {
+        assert(0 && "msg.Buf must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (segmentSize == 0) {
+        assert(0 && "segmentSize must be positive");
+        return error::illegal_argument;
+    }
+    if (segmentSize > UINT16_MAX || msg.Len > kMaxSegmentedLength
+            || (msg.Len + segmentSize - 1) / segmentSize > kMaxSegments) {
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (!msg.Peer.IsSpecified() && !m_remote.IsSpecified()) {
+        return error::illegal_state;
+    }
+
+    struct sockaddr_storage to;
+    socklen_t tolen = 0;
+    struct sockaddr* name = toSockAddr(msg, m_remote, m_connected, &to, &tolen);
+#ifdef UDP_SEGMENT
+    if (msg.Len > segmentSize && !m_noSegmentation) {
+        struct iovec iov = {msg.Buf, msg.Len};
+        char control[CMSG_SPACE(sizeof(uint16_t))] = {0};
+        struct msghdr hdr = {0};
+        hdr.msg_name = name;
+        hdr.msg_namelen = tolen;
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gsoSize = (uint16_t) segmentSize;
+        memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof(gsoSize));
+        ssize_t size = sendmsg(m_fd, &hdr, 0);
+        if (size != -1) {
+            if (nbytes != nullptr) {
+                *nbytes = (int) size;
+            }
+            return error::nil;
+        }
+        // refused by an older kernel, or by a device without checksum offload (EIO);
+        // nothing has been sent. The other errors, EINVAL among them, concern this call only.
+        if (errno != ENOPROTOOPT && errno != EOPNOTSUPP && errno != EIO) {
+            if (nbytes != nullptr) {
+                *nbytes = 0;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        m_noSegmentation = true;
+    }
+#endif // UDP_SEGMENT
+    size_t sent = 0;
+    do {
+        size_t len = (msg.Len - sent < segmentSize) ? msg.Len - sent : segmentSize;
+        if (sendto(m_fd, &msg.Buf[sent], len, 0, name, tolen) == -1) {
+            if (nbytes != nullptr) {
+                *nbytes = (int) sent;
+            }
+            return error::wrap(etype::os, errno);
+        }
+        sent += len;
+    } while (sent < msg.Len);
+    if (nbytes != nullptr) {
+        *nbytes = (int) sent;
+    }
+    return error::nil;
+}
+
+error UDPSocket::SetReceiveCoalescing(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+#ifdef UDP_GRO
+    int value = on ? 1 : 0;
+    if (setsockopt(m_fd, SOL_UDP, UDP_GRO, &value, sizeof(value)) == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    return error::nil;
+#else
+    return on ? error::opnotsupp : error::nil;
+#endif // UDP_GRO
+}
+
+error UDPSocket::ReadCoalesced(Datagram* msg, size_t* segmentSize) {
+    if (msg == nullptr) {
+        assert(0 && "msg must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (segmentSize == nullptr) {
+        assert(0 && "segmentSize must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct sockaddr_in from = {0};
+    struct iovec iov = {msg->Buf, msg->Len};
+    struct msghdr hdr = {0};
+    hdr.msg_name = &from;
+    hdr.msg_namelen = sizeof(from);
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+#ifdef UDP_GRO
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+#endif // UDP_GRO
+    ssize_t size = recvmsg(m_fd, &hdr, 0);
+    if (size == -1) {
+        return error::wrap(etype::os, errno);
+    }
+    msg->Size = size;
+    Endpoint::FromSockAddr((struct sockaddr*) &from, hdr.msg_namelen, &msg->Peer);
+    msg->Truncated = (hdr.msg_flags & MSG_TRUNC) != 0;
+    *segmentSize = size;
+#ifdef UDP_GRO
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gsoSize = 0;
+            memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+            *segmentSize = gsoSize;
+        }
+    }
+#endif // UDP_GRO
+    return error::nil;
+}
+
 error UDPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -176,4 +609,18 @@ error UDPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     return error::nil;
 }
 
+error UDPSocket::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 } // namespace net
@@ -1,12 +1,44 @@
 #include "netlib/udp.h"
 #include <cassert>
+#include <vector>
 #include <winsock2.h>
+#include <ws2tcpip.h>
 #include "netlib/internal/init.h"
+#include "netlib/internal/socket.h"
 #include "netlib/resolver.h"
 
 namespace net {
 
+// nullptr for a connected socket to send to its peer, whose address the kernel keeps
+static struct sockaddr* toSockAddr(const Datagram& msg, const Endpoint& remote, bool connected,
+        struct sockaddr_storage* to, int* tolen) {
+    if (!msg.Peer.IsSpecified() && connected) {
+        *tolen = 0;
+        return nullptr;
+    }
+    *tolen = (int) (msg.Peer.IsSpecified() ? msg.Peer : remote).ToSockAddr(to);
+    return (struct sockaddr*) to;
+}
+
+// an ICMP port unreachable is reported as WSAECONNRESET on Windows
+static error toError(int err, bool connected) {
+    if (connected && err == WSAECONNRESET) {
+        return error::connrefused;
+    }
+    return error::wrap(etype::os, err);
+}
+
 error ConnectUDP(const std::string& host, uint16_t port, std::shared_ptr<UDPSocket>* clientSock) {
+    return ConnectUDP(host, port, SocketOptions(), clientSock);
+}
+
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options,
+        std::shared_ptr<UDPSocket>* clientSock) {
+    return ConnectUDP(host, port, options, false, clientSock);
+}
+
+error ConnectUDP(const std::string& host, uint16_t port, const SocketOptions& options, bool connect,
+        std::shared_ptr<UDPSocket>* clientSock) {
     if (clientSock == nullptr) {
         assert(0 && "clientSock must not be nullptr");
         return error::illegal_argument;
@@ -24,12 +56,33 @@ error ConnectUDP(const std::string& host, uint16_t port, std::shared_ptr<UDPSock
     if (fd == INVALID_SOCKET) {
         return error::wrap(etype::os, WSAGetLastError());
     }
+    err = internal::applySocketOptions(fd, options, false);
+    if (err != error::nil) {
+        closesocket(fd);
+        return err;
+    }
 
-    *clientSock = std::make_shared<UDPSocket>(fd, std::move(remoteAddr), port);
+    if (connect) {
+        struct sockaddr_in serverAddr = {0};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(port);
+        serverAddr.sin_addr.S_un.S_addr = inet_addr(remoteAddr.c_str());
+        if (::connect(fd, (struct sockaddr*) &serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+            int connectErr = WSAGetLastError();
+            closesocket(fd);
+            return error::wrap(etype::os, connectErr);
+        }
+    }
+
+    *clientSock = std::make_shared<UDPSocket>(fd, std::move(remoteAddr), port, connect);
     return error::nil;
 }
 
 error ListenUDP(uint16_t port, std::shared_ptr<UDPSocket>* serverSock) {
+    return ListenUDP(port, SocketOptions(), serverSock);
+}
+
+error ListenUDP(uint16_t port, const SocketOptions& options, std::shared_ptr<UDPSocket>* serverSock) {
     if (serverSock == nullptr) {
         assert(0 && "serverSock must not be nullptr");
         return error::illegal_argument;
@@ -41,6 +94,11 @@ error ListenUDP(uint16_t port, std::shared_ptr<UDPSocket>* serverSock) {
     if (fd == INVALID_SOCKET) {
         return error::wrap(etype::os, WSAGetLastError());
     }
+    error optErr = internal::applySocketOptions(fd, options, false);
+    if (optErr != error::nil) {
+        closesocket(fd);
+        return optErr;
+    }
 
     struct sockaddr_in serverAddr = {0};
     serverAddr.sin_family = AF_INET;
@@ -80,7 +138,7 @@ error UDPSocket::Read(char* buf, size_t len, int* nbytes) {
 
     int size = recv(m_fd, buf, len, 0);
     if (size == SOCKET_ERROR) {
-        return error::wrap(etype::os, WSAGetLastError());
+        return toError(WSAGetLastError(), m_connected);
     }
     if (size == 0) {
         return error::eof;
@@ -91,6 +149,31 @@ error UDPSocket::Read(char* buf, size_t len, int* nbytes) {
     return error::nil;
 }
 
+error UDPSocket::ReadV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    std::vector<WSABUF> bufs = internal::toWSABufs(iov, iovcnt);
+    DWORD size = 0;
+    DWORD flags = 0;
+    if (WSARecv(m_fd, bufs.data(), (DWORD) bufs.size(), &size, &flags, nullptr, nullptr) == SOCKET_ERROR) {
+        return toError(WSAGetLastError(), m_connected);
+    }
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
+}
+
 error UDPSocket::ReadFrom(char* buf, size_t len, int* nbytes,
             std::string* addr, uint16_t* port) {
     if (m_closed) {
@@ -123,8 +206,45 @@ error UDPSocket::Write(const char* buf, size_t len, int* nbytes) {
     if (m_remoteAddr.empty() && m_remotePort == 0) {
         return error::illegal_state;
     }
+    if (!m_connected) {
+        return WriteTo(buf, len, m_remote, nbytes);
+    }
+
+    int size = send(m_fd, buf, (int) len, 0);
+    if (size == SOCKET_ERROR) {
+        return toError(WSAGetLastError(), m_connected);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+    if (iov == nullptr && iovcnt > 0) {
+        assert(0 && "iov must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (m_remoteAddr.empty() && m_remotePort == 0) {
+        return error::illegal_state;
+    }
 
-    return WriteTo(buf, len, m_remoteAddr, m_remotePort, nbytes);
+    struct sockaddr_storage to;
+    int tolen = m_connected ? 0 : (int) m_remote.ToSockAddr(&to);
+    std::vector<WSABUF> bufs = internal::toWSABufs(iov, iovcnt);
+    DWORD size = 0;
+    if (WSASendTo(m_fd, bufs.data(), (DWORD) bufs.size(), &size, 0,
+            m_connected ? nullptr : (struct sockaddr*) &to, tolen, nullptr, nullptr) == SOCKET_ERROR) {
+        return toError(WSAGetLastError(), m_connected);
+    }
+    if (nbytes != nullptr) {
+        *nbytes = (int) size;
+    }
+    return error::nil;
 }
 
 error UDPSocket::WriteTo(const char* buf, size_t len,
@@ -148,6 +268,186 @@ error UDPSocket::WriteTo(const char* buf, size_t len,
     return error::nil;
 }
 
+error UDPSocket::ReadFrom(char* buf, size_t len, int* nbytes, Endpoint* from) {
+    if (from == nullptr) {
+        assert(0 && "from must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    struct sockaddr_storage addr;
+    int addrlen = sizeof(addr);
+    int size = recvfrom(m_fd, buf, (int) len, 0, (struct sockaddr*) &addr, &addrlen);
+    if (size == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    Endpoint::FromSockAddr((struct sockaddr*) &addr, addrlen, from);
+    if (size == 0) {
+        return error::eof;
+    }
+    if (nbytes != nullptr) {
+        *nbytes = size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::WriteTo(const char* buf, size_t len, const Endpoint& to, int* nbytes) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (!to.IsSpecified()) {
+        return error::illegal_argument;
+    }
+
+    struct sockaddr_storage addr;
+    int addrlen = (int) to.ToSockAddr(&addr);
+    int size = sendto(m_fd, buf, (int) len, 0, (struct sockaddr*) &addr, addrlen);
+    if (size == SOCKET_ERROR) {
+        return error::wrap(etype::os, WSAGetLastError());
+    }
+    if (nbytes != nullptr) {
+        *nbytes = size;
+    }
+    return error::nil;
+}
+
+error UDPSocket::ReadBatch(Datagram* msgs, size_t count, size_t* nmsgs) {
+    if (msgs == nullptr && count > 0) {
+        assert(0 && "msgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (nmsgs == nullptr) {
+        assert(0 && "nmsgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    *nmsgs = 0;
+    if (count == 0) {
+        return error::nil;
+    }
+    // no batched receive on Windows
+    struct sockaddr_in from = {0};
+    int fromlen = sizeof(from);
+    bool truncated = false;
+    int size = recvfrom(m_fd, msgs[0].Buf, (int) msgs[0].Len, 0, (struct sockaddr*) &from, &fromlen);
+    if (size == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (err != WSAEMSGSIZE) {
+            return error::wrap(etype::os, err);
+        }
+        truncated = true;
+        size = (int) msgs[0].Len;
+    }
+    msgs[0].Size = size;
+    Endpoint::FromSockAddr((struct sockaddr*) &from, fromlen, &msgs[0].Peer);
+    msgs[0].Truncated = truncated;
+    *nmsgs = 1;
+    return error::nil;
+}
+
+error UDPSocket::WriteBatch(const Datagram* msgs, size_t count, size_t* nmsgs) {
+    if (msgs == nullptr && count > 0) {
+        assert(0 && "msgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (nmsgs == nullptr) {
+        assert(0 && "nmsgs must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!msgs[i].Peer.IsSpecified() && !m_remote.IsSpecified()) {
+            return error::illegal_state;
+        }
+    }
+
+    for (*nmsgs = 0; *nmsgs < count; (*nmsgs)++) {
+        const Datagram& msg = msgs[*nmsgs];
+        struct sockaddr_storage to;
+        int tolen = 0;
+        struct sockaddr* name = toSockAddr(msg, m_remote, m_connected, &to, &tolen);
+        if (sendto(m_fd, msg.Buf, (int) msg.Len, 0, name, tolen) == SOCKET_ERROR) {
+            return error::wrap(etype::os, WSAGetLastError());
+        }
+    }
+    return error::nil;
+}
+
+error UDPSocket::WriteSegmented(const Datagram& msg, size_t segmentSize, int* nbytes) {
+    if (msg.Buf == nullptr && msg.Len > 0) {
+        assert(0 && "msg.Buf must not be nullptr");
+        return error::illegal_argument;
+    }
+    if (segmentSize == 0) {
+        assert(0 && "segmentSize must be positive");
+        return error::illegal_argument;
+    }
+    if (segmentSize > UINT16_MAX || msg.Len > kMaxSegmentedLength
+            || (msg.Len + segmentSize - 1) / segmentSize > kMaxSegments) {
+        return error::illegal_argument;
+    }
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    if (!msg.Peer.IsSpecified() && !m_remote.IsSpecified()) {
+        return error::illegal_state;
+    }
+
+    struct sockaddr_storage to;
+    int tolen = 0;
+    struct sockaddr* name = toSockAddr(msg, m_remote, m_connected, &to, &tolen);
+    size_t sent = 0;
+    do {
+        size_t len = (msg.Len - sent < segmentSize) ? msg.Len - sent : segmentSize;
+        if (sendto(m_fd, &msg.Buf[sent], (int) len, 0, name, tolen) == SOCKET_ERROR) {
+            if (nbytes != nullptr) {
+                *nbytes = (int) sent;
+            }
+            return error::wrap(etype::os, WSAGetLastError());
+        }
+        sent += len;
+    } while (sent < msg.Len);
+    if (nbytes != nullptr) {
+        *nbytes = (int) sent;
+    }
+    return error::nil;
+}
+
+error UDPSocket::SetReceiveCoalescing(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+    return on ? error::opnotsupp : error::nil;
+}
+
+error UDPSocket::ReadCoalesced(Datagram* msg, size_t* segmentSize) {
+    if (segmentSize == nullptr) {
+        assert(0 && "segmentSize must not be nullptr");
+        return error::illegal_argument;
+    }
+
+    size_t nmsgs = 0;
+    error err = ReadBatch(msg, 1, &nmsgs);
+    if (err != error::nil) {
+        return err;
+    }
+    *segmentSize = msg->Size;
+    return error::nil;
+}
+
 error UDPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     if (m_closed) {
         assert(0 && "Already closed");
@@ -164,4 +464,18 @@ error UDPSocket::SetTimeout(int64_t timeoutMilliseconds) {
     return error::nil;
 }
 
+error UDPSocket::SetNonBlocking(bool on) {
+    if (m_closed) {
+        assert(0 && "Already closed");
+        return error::illegal_state;
+    }
+
+    error err = internal::setNonBlocking(m_fd, on);
+    if (err != error::nil) {
+        return err;
+    }
+    m_nonBlocking = on;
+    return error::nil;
+}
+
 } // namespace net
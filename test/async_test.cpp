@@ -0,0 +1,289 @@
+#include "netlib/async.h"
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "netlib/tcp.h"
+#include "netlib/udp.h"
+#ifdef NETLIB_USE_OPENSSL
+ #include <cstdio>
+ #include <openssl/evp.h>
+ #include <openssl/pem.h>
+ #include <openssl/x509.h>
+ #include "netlib/ssl.h"
+#endif // NETLIB_USE_OPENSSL
+
+using namespace net;
+
+TEST(AsyncStream, TCPEcho) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const std::string message(256 * 1024, 'x'); // larger than the socket buffers
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> clientSock;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &clientSock));
+    std::shared_ptr<TCPSocket> serverSock;
+    ASSERT_EQ(error::nil, listener->Accept(&serverSock));
+
+    std::shared_ptr<AsyncStream> client;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, clientSock, &client));
+    std::shared_ptr<AsyncStream> server;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, serverSock, &server));
+
+    // when: the server echoes back everything until end of file
+    char serverBuf[4096];
+    std::promise<error> serverDone;
+    std::function<void()> echo = [&]() {
+        server->AsyncRead(serverBuf, sizeof(serverBuf), [&](const error& err, int nbytes) {
+            if (err != error::nil) {
+                serverDone.set_value(err);
+                return;
+            }
+            server->AsyncWriteFull(serverBuf, nbytes, [&](const error& err, int) {
+                if (err != error::nil) {
+                    serverDone.set_value(err);
+                    return;
+                }
+                echo();
+            });
+        });
+    };
+    loop->Post(echo);
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+
+    // when: the client writes and reads through futures on another thread
+    std::string received(message.size(), '\0');
+    auto writeFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return client->AsyncWriteFull(message.data(), message.size(), callback);
+    });
+    auto readFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return client->AsyncReadFull(&received[0], received.size(), callback);
+    });
+
+    // then: the whole message is echoed back
+    AsyncResult written = writeFuture.get();
+    EXPECT_EQ(error::nil, written.Err);
+    EXPECT_EQ((int) message.size(), written.NBytes);
+    AsyncResult read = readFuture.get();
+    EXPECT_EQ(error::nil, read.Err);
+    EXPECT_EQ((int) message.size(), read.NBytes);
+    EXPECT_TRUE(message == received);
+
+    // when: the client closes
+    loop->Post([&]() {
+        client->Close();
+    });
+
+    // then: the server reads end of file
+    EXPECT_EQ(error::eof, serverDone.get_future().get());
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    server->Close();
+}
+
+TEST(AsyncStream, CloseCancelsPending) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> clientSock;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &clientSock));
+    std::shared_ptr<TCPSocket> serverSock;
+    ASSERT_EQ(error::nil, listener->Accept(&serverSock));
+    std::shared_ptr<AsyncStream> client;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, clientSock, &client));
+
+    // when: close while a read is waiting for data
+    char buf[16];
+    error result = error::nil;
+    ASSERT_EQ(error::nil, client->AsyncRead(buf, sizeof(buf), [&](const error& err, int) {
+        result = err;
+    }));
+    EXPECT_EQ(error::nil, loop->RunOnce(0));
+    EXPECT_EQ(error::nil, result);
+    EXPECT_EQ(error::nil, client->Close());
+
+    // then: the read is cancelled, and no more operations can be started
+    EXPECT_EQ(error::wrap(etype::os, ECANCELED), result);
+    EXPECT_TRUE(clientSock->IsClosed());
+    EXPECT_EQ(0u, loop->Size());
+}
+
+TEST(AsyncStream, UDP) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<UDPSocket> serverSock;
+    ASSERT_EQ(error::nil, ListenUDP(port, &serverSock));
+    std::shared_ptr<UDPSocket> clientSock;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &clientSock));
+
+    std::shared_ptr<AsyncStream> server;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, serverSock, &server));
+    std::shared_ptr<AsyncStream> client;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, clientSock, &client));
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+
+    // when: the server waits for a datagram before the client sends it
+    char buf[256] = {0};
+    auto readFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return server->AsyncRead(buf, sizeof(buf), callback);
+    });
+    auto writeFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return client->AsyncWrite(message, sizeof(message), callback);
+    });
+
+    // then: the datagram is received as a whole
+    AsyncResult written = writeFuture.get();
+    EXPECT_EQ(error::nil, written.Err);
+    EXPECT_EQ((int) sizeof(message), written.NBytes);
+    AsyncResult read = readFuture.get();
+    EXPECT_EQ(error::nil, read.Err);
+    EXPECT_EQ((int) sizeof(message), read.NBytes);
+    EXPECT_STREQ(message, buf);
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    client->Close();
+    server->Close();
+}
+
+#ifdef NETLIB_USE_OPENSSL
+// Writes a self-signed certificate for localhost and its key as PEM files.
+static bool writeSelfSignedCert(const std::string& certFile, const std::string& keyFile) {
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    EVP_PKEY* pkey = nullptr;
+    bool ok = pctx != nullptr
+            && EVP_PKEY_keygen_init(pctx) == 1
+            && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) == 1
+            && EVP_PKEY_keygen(pctx, &pkey) == 1;
+    EVP_PKEY_CTX_free(pctx);
+    X509* cert = ok ? X509_new() : nullptr;
+    if (cert != nullptr) {
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_get_notBefore(cert), 0);
+        X509_gmtime_adj(X509_get_notAfter(cert), 60 * 60);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*) "localhost", -1, -1, 0);
+        ok = X509_set_issuer_name(cert, name) == 1
+                && X509_set_pubkey(cert, pkey) == 1
+                && X509_sign(cert, pkey, EVP_sha256()) > 0;
+    }
+    FILE* fp = ok ? fopen(certFile.c_str(), "w") : nullptr;
+    if (fp != nullptr) {
+        ok = PEM_write_X509(fp, cert) == 1;
+        fclose(fp);
+    }
+    fp = ok ? fopen(keyFile.c_str(), "w") : nullptr;
+    if (fp != nullptr) {
+        ok = PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+        fclose(fp);
+    }
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ok && fp != nullptr;
+}
+
+TEST(AsyncStream, SSLEcho) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const std::string message(256 * 1024, 'x'); // many records, larger than the socket buffers
+    const std::string certFile = testing::TempDir() + "async_test_cert.pem";
+    const std::string keyFile = testing::TempDir() + "async_test_key.pem";
+    ASSERT_TRUE(writeSelfSignedCert(certFile, keyFile));
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    SSLConfig serverConfig = {nullptr, certFile, keyFile, false};
+    std::shared_ptr<SSLListener> listener;
+    ASSERT_EQ(error::nil, ListenSSL(port, serverConfig, &listener));
+    std::shared_ptr<SSLSocket> serverSock;
+    std::thread acceptor([&]() {
+        EXPECT_EQ(error::nil, listener->Accept(&serverSock));
+    });
+    SSLConfig clientConfig = {nullptr, "", "", true};
+    std::shared_ptr<SSLSocket> clientSock;
+    ASSERT_EQ(error::nil, ConnectSSL(host, port, connectionTimeout, clientConfig, &clientSock));
+    acceptor.join();
+    ASSERT_NE(nullptr, serverSock);
+
+    // when: register the SSL sockets by their fds in non-blocking mode
+    ASSERT_EQ(error::nil, clientSock->SetNonBlocking(true));
+    ASSERT_EQ(error::nil, serverSock->SetNonBlocking(true));
+    std::shared_ptr<AsyncStream> client;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, clientSock->FD(), clientSock, &client));
+    std::shared_ptr<AsyncStream> server;
+    ASSERT_EQ(error::nil, NewAsyncStream(loop, serverSock->FD(), serverSock, &server));
+
+    // when: the server echoes back everything
+    char serverBuf[4096];
+    std::function<void()> echo = [&]() {
+        server->AsyncRead(serverBuf, sizeof(serverBuf), [&](const error& err, int nbytes) {
+            if (err != error::nil) {
+                return;
+            }
+            server->AsyncWriteFull(serverBuf, nbytes, [&](const error& err, int) {
+                if (err == error::nil) {
+                    echo();
+                }
+            });
+        });
+    };
+    loop->Post(echo);
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+    std::string received(message.size(), '\0');
+    auto writeFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return client->AsyncWriteFull(message.data(), message.size(), callback);
+    });
+    auto readFuture = MakeFuture([&](const AsyncCallback& callback) {
+        return client->AsyncReadFull(&received[0], received.size(), callback);
+    });
+
+    // then: the whole message is echoed back through the records
+    AsyncResult written = writeFuture.get();
+    EXPECT_EQ(error::nil, written.Err);
+    EXPECT_EQ((int) message.size(), written.NBytes);
+    AsyncResult read = readFuture.get();
+    EXPECT_EQ(error::nil, read.Err);
+    EXPECT_EQ((int) message.size(), read.NBytes);
+    EXPECT_TRUE(message == received);
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    client->Close();
+    server->Close();
+    listener->Close();
+    remove(certFile.c_str());
+    remove(keyFile.c_str());
+}
+#endif // NETLIB_USE_OPENSSL
@@ -1,6 +1,7 @@
 #include "netlib/binary.h"
 #include <string>
 #include <gtest/gtest.h>
+#include "netlib/iobuf.h"
 
 using namespace net;
 
@@ -101,3 +102,26 @@ TEST(ByteBuffer, PutInt32_LittleEndian) {
     EXPECT_EQ(0x00, buf[2]);
     EXPECT_EQ(0x00, buf[3]);
 }
+
+TEST(ByteBuffer, PutAndGetIOBuf) {
+    char buf[12];
+
+    // write: a chain of two segments and a length
+    IOBuf src("abc", 3);
+    src.Append(IOBuf("def", 3));
+    ByteBuffer w(buf, sizeof(buf), ByteOrder::BigEndian);
+    w.PutUint16(6);
+    w.Put(src);
+
+    // read: the length prefixed bytes into a buffer with a header prepended
+    ByteBuffer r(buf, sizeof(buf), ByteOrder::BigEndian);
+    uint16_t len = r.GetUint16();
+    IOBuf dst(16, 4);
+    r.Get(&dst, len);
+    ByteBuffer header(dst.PrependSpace(4), 4, ByteOrder::BigEndian);
+    header.PutUint32(len);
+
+    std::string s(dst.Length(), '\0');
+    dst.CopyTo(0, &s[0], s.size());
+    EXPECT_EQ(std::string("\0\0\0\6abcdef", 10), s);
+}
@@ -0,0 +1,345 @@
+#include "netlib/bufio.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+namespace {
+
+// Returns the given chunks one per Read, and error::eof after them.
+class ChunkReader final : public Reader {
+public:
+    explicit ChunkReader(const std::vector<std::string>& chunks) : Chunks(chunks) {}
+
+    std::vector<std::string> Chunks;
+    int Calls = 0;
+
+    error Read(char* buf, size_t len, int* nbytes) {
+        Calls++;
+        if (Chunks.empty()) {
+            return error::eof;
+        }
+        std::string& chunk = Chunks.front();
+        size_t n = (len < chunk.size()) ? len : chunk.size();
+        memcpy(buf, chunk.data(), n);
+        chunk.erase(0, n);
+        if (chunk.empty()) {
+            Chunks.erase(Chunks.begin());
+        }
+        *nbytes = (int) n;
+        return error::nil;
+    }
+};
+
+} // namespace
+
+TEST(BufferedReader, ReadLine) {
+    // setup:
+    std::shared_ptr<ChunkReader> source = std::make_shared<ChunkReader>(
+            std::vector<std::string>{"first\nsec", "ond\nthird"});
+    BufferedReader reader(source);
+    char buf[64];
+
+    // when: read lines which span the chunks
+    // then: each line is read with the line end, at one Read per chunk
+    ASSERT_EQ(error::nil, reader.ReadLine(buf, sizeof(buf)));
+    EXPECT_STREQ("first\n", buf);
+    ASSERT_EQ(error::nil, reader.ReadLine(buf, sizeof(buf)));
+    EXPECT_STREQ("second\n", buf);
+    EXPECT_EQ(2, source->Calls);
+
+    // then: the last line without the line end ends with end of file
+    EXPECT_EQ(error::eof, reader.ReadLine(buf, sizeof(buf)));
+}
+
+TEST(BufferedReader, ReadLineLongerThanBuf) {
+    // setup:
+    std::shared_ptr<ChunkReader> source = std::make_shared<ChunkReader>(
+            std::vector<std::string>{"abcdef\n"});
+    BufferedReader reader(source);
+    char buf[4];
+
+    // when: read a line longer than buf
+    // then: len-1 bytes are read with a null-character, and the rest is left
+    ASSERT_EQ(error::nil, reader.ReadLine(buf, sizeof(buf)));
+    EXPECT_STREQ("abc", buf);
+    ASSERT_EQ(error::nil, reader.ReadLine(buf, sizeof(buf)));
+    EXPECT_STREQ("def", buf);
+    ASSERT_EQ(error::nil, reader.ReadLine(buf, sizeof(buf)));
+    EXPECT_STREQ("\n", buf);
+}
+
+TEST(BufferedReader, ReadUntil) {
+    // setup:
+    std::shared_ptr<ChunkReader> source = std::make_shared<ChunkReader>(
+            std::vector<std::string>{"key=va", "lue;rest"});
+    BufferedReader reader(source, 4); // smaller than the data
+    std::string data;
+
+    // when: read until the delimiters
+    // then: the data includes the delimiter
+    ASSERT_EQ(error::nil, reader.ReadUntil('=', &data));
+    EXPECT_EQ("key=", data);
+    ASSERT_EQ(error::nil, reader.ReadUntil(';', &data));
+    EXPECT_EQ("value;", data);
+
+    // then: the data before end of file is returned with the error
+    EXPECT_EQ(error::eof, reader.ReadUntil(';', &data));
+    EXPECT_EQ("rest", data);
+}
+
+TEST(BufferedReader, PeekAndDiscard) {
+    // setup:
+    std::shared_ptr<ChunkReader> source = std::make_shared<ChunkReader>(
+            std::vector<std::string>{"he", "ader", "body"});
+    BufferedReader reader(source, 8);
+    const char* data = nullptr;
+
+    // when: peek across the chunks
+    ASSERT_EQ(error::nil, reader.Peek(6, &data));
+
+    // then: the bytes are not consumed
+    EXPECT_EQ(0, memcmp("header", data, 6));
+    EXPECT_EQ(6u, reader.Buffered());
+
+    // when: discard the header
+    size_t discarded = 0;
+    ASSERT_EQ(error::nil, reader.Discard(6, &discarded));
+    EXPECT_EQ(6u, discarded);
+
+    // then: the rest follows
+    char buf[8] = {0};
+    ASSERT_EQ(error::nil, reader.ReadFull(buf, 4));
+    EXPECT_STREQ("body", buf);
+
+    // when: discard beyond end of file
+    // then: nothing is left
+    EXPECT_EQ(error::eof, reader.Discard(1, &discarded));
+    EXPECT_EQ(0u, discarded);
+}
+
+TEST(BufferedReader, ReadFullBypassesBuffer) {
+    // setup:
+    std::string large(1024, 'x');
+    std::shared_ptr<ChunkReader> source = std::make_shared<ChunkReader>(
+            std::vector<std::string>{"ab", large});
+    BufferedReader reader(source, 16);
+    char c;
+    ASSERT_EQ(error::nil, reader.ReadFull(&c, 1));
+
+    // when: read more than the buffer holds
+    std::string buf(1 + large.size(), '\0');
+    size_t nbytes = 0;
+    error err = reader.ReadFull(&buf[0], buf.size(), &nbytes);
+
+    // then: the buffered byte and the rest are read, the rest in a single Read
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(buf.size(), nbytes);
+    EXPECT_EQ("b" + large, buf);
+    EXPECT_EQ(2, source->Calls);
+}
+
+namespace {
+
+// Records each call, and accepts at most Limit bytes per call if Limit is not 0.
+class RecordingWriter final : public Writer {
+public:
+    std::vector<std::string> Writes;
+    size_t Limit = 0;
+
+    error Write(const char* buf, size_t len, int* nbytes) {
+        IOVec iov = {const_cast<char*>(buf), len};
+        return WriteV(&iov, 1, nbytes);
+    }
+
+    error WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+        std::string data;
+        for (size_t i = 0; i < iovcnt; i++) {
+            data.append(iov[i].Base, iov[i].Len);
+        }
+        if (Limit > 0 && data.size() > Limit) {
+            data.resize(Limit);
+        }
+        Writes.push_back(data);
+        *nbytes = (int) data.size();
+        return error::nil;
+    }
+
+    std::string All() {
+        std::string all;
+        for (auto& w : Writes) {
+            all += w;
+        }
+        return all;
+    }
+};
+
+} // namespace
+
+TEST(BufferedWriter, CoalesceAndFlush) {
+    // setup:
+    std::shared_ptr<RecordingWriter> dest = std::make_shared<RecordingWriter>();
+    BufferedWriter writer(dest, BufferedWriterConfig{16, 0, false});
+
+    // when: write small pieces
+    ASSERT_EQ(error::nil, writer.WriteFull("abc", 3));
+    ASSERT_EQ(error::nil, writer.WriteFull("def", 3));
+
+    // then: nothing is written until Flush
+    EXPECT_EQ(0u, dest->Writes.size());
+    EXPECT_EQ(6u, writer.Buffered());
+    ASSERT_EQ(error::nil, writer.Flush());
+    ASSERT_EQ(1u, dest->Writes.size());
+    EXPECT_EQ("abcdef", dest->Writes[0]);
+    EXPECT_EQ(0u, writer.Buffered());
+
+    // then: flushing an empty buffer writes nothing
+    ASSERT_EQ(error::nil, writer.Flush());
+    EXPECT_EQ(1u, dest->Writes.size());
+}
+
+TEST(BufferedWriter, FlushOnSize) {
+    // setup:
+    std::shared_ptr<RecordingWriter> dest = std::make_shared<RecordingWriter>();
+    BufferedWriter writer(dest, BufferedWriterConfig{8, 0, false});
+
+    // when: write more than the buffer holds in pieces
+    ASSERT_EQ(error::nil, writer.WriteFull("12345", 5));
+    ASSERT_EQ(error::nil, writer.WriteFull("678", 3)); // fills the buffer
+    ASSERT_EQ(error::nil, writer.WriteFull("abcde", 5));
+    ASSERT_EQ(error::nil, writer.WriteFull("fghi", 4)); // does not fit
+
+    // then: the buffer is written whenever it fills up, or before it overflows
+    ASSERT_EQ(2u, dest->Writes.size());
+    EXPECT_EQ("12345678", dest->Writes[0]);
+    EXPECT_EQ("abcde", dest->Writes[1]);
+    EXPECT_EQ(4u, writer.Buffered());
+}
+
+TEST(BufferedWriter, LargeWriteIsGathered) {
+    // setup:
+    std::shared_ptr<RecordingWriter> dest = std::make_shared<RecordingWriter>();
+    BufferedWriter writer(dest, BufferedWriterConfig{8, 0, false});
+    ASSERT_EQ(error::nil, writer.WriteFull("head", 4));
+
+    // when: write more than the buffer size
+    std::string body(32, 'x');
+    ASSERT_EQ(error::nil, writer.WriteFull(body.data(), body.size()));
+
+    // then: the buffered bytes and the data are written with a single call
+    ASSERT_EQ(1u, dest->Writes.size());
+    EXPECT_EQ("head" + body, dest->Writes[0]);
+    EXPECT_EQ(0u, writer.Buffered());
+}
+
+TEST(BufferedWriter, PartialWrites) {
+    // setup:
+    std::shared_ptr<RecordingWriter> dest = std::make_shared<RecordingWriter>();
+    dest->Limit = 3;
+    BufferedWriter writer(dest, BufferedWriterConfig{8, 0, false});
+    ASSERT_EQ(error::nil, writer.WriteFull("head", 4));
+
+    // when: the destination accepts a few bytes at a time
+    std::string body(10, 'x');
+    ASSERT_EQ(error::nil, writer.WriteFull(body.data(), body.size()));
+    ASSERT_EQ(error::nil, writer.Flush());
+
+    // then: every byte is written once in order
+    EXPECT_EQ("head" + body, dest->All());
+}
+
+TEST(BufferedWriter, NonBlockingWithFullPeer) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const size_t total = 4 * 1024 * 1024;
+    const size_t chunks[] = {1024, 1024, 1024, 1024, 6000}; // fill the buffer up, and write past it
+    std::string data(total, '\0');
+    for (size_t i = 0; i < total; i++) {
+        data[i] = (char) (i % 251);
+    }
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    ASSERT_EQ(error::nil, client->SetNonBlocking(true));
+    BufferedWriter writer(client, BufferedWriterConfig{4096, 0, false});
+
+    // when: write faster than the peer reads, retrying the bytes which have not been accepted
+    std::string received;
+    std::vector<char> buf(64 * 1024);
+    auto drain = [&]() {
+        int nbytes = 0;
+        if (server->Read(buf.data(), buf.size(), &nbytes) == error::nil) {
+            received.append(buf.data(), nbytes);
+        }
+    };
+    int wouldblocks = 0;
+    for (size_t offset = 0, i = 0; offset < total; i++) {
+        size_t chunk = chunks[i % (sizeof(chunks) / sizeof(chunks[0]))];
+        size_t len = (total - offset < chunk) ? total - offset : chunk;
+        size_t nbytes = 0;
+        error err = writer.WriteFull(&data[offset], len, &nbytes);
+        offset += nbytes;
+        if (err == error::wouldblock) {
+            wouldblocks++;
+            drain();
+        } else {
+            ASSERT_EQ(error::nil, err);
+        }
+    }
+    while (writer.Flush() == error::wouldblock) {
+        drain();
+    }
+    while (received.size() < total) {
+        drain();
+    }
+
+    // then: every byte has arrived once in order
+    EXPECT_GT(wouldblocks, 0);
+    ASSERT_EQ(total, received.size());
+    EXPECT_TRUE(data == received);
+
+    // cleanup:
+    client->Close();
+    server->Close();
+    listener->Close();
+}
+
+TEST(BufferedWriter, FlushOnDeadline) {
+    // setup:
+    std::shared_ptr<RecordingWriter> dest = std::make_shared<RecordingWriter>();
+    BufferedWriter writer(dest, BufferedWriterConfig{64, 20, false});
+    ASSERT_EQ(error::nil, writer.WriteFull("a", 1));
+
+    // when: the deadline has not passed
+    // then: nothing is written
+    ASSERT_EQ(error::nil, writer.FlushIfExpired());
+    EXPECT_EQ(0u, dest->Writes.size());
+
+    // when: write after the deadline
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    ASSERT_EQ(error::nil, writer.WriteFull("b", 1));
+
+    // then: the buffer is written
+    ASSERT_EQ(1u, dest->Writes.size());
+    EXPECT_EQ("ab", dest->Writes[0]);
+
+    // when: the timer of a quiet writer fires
+    ASSERT_EQ(error::nil, writer.WriteFull("c", 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    ASSERT_EQ(error::nil, writer.FlushIfExpired());
+
+    // then: the buffer is written
+    ASSERT_EQ(2u, dest->Writes.size());
+    EXPECT_EQ("c", dest->Writes[1]);
+}
@@ -0,0 +1,143 @@
+#include "netlib/coroutine.h"
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "netlib/tcp.h"
+#include "netlib/udp.h"
+
+using namespace net;
+
+static void newEngine(IOEngineType type, std::shared_ptr<IOEngine>* engine) {
+    IOEngineConfig config = {};
+    config.Type = type;
+    error err = NewIOEngine(config, engine);
+    if (err == error::opnotsupp) {
+        return;
+    }
+    ASSERT_EQ(error::nil, err);
+}
+
+static void runUntil(const std::shared_ptr<IOEngine>& engine, const bool& done) {
+    for (int i = 0; i < 1000 && !done; i++) {
+        EXPECT_EQ(error::nil, engine->RunOnce(10));
+    }
+    EXPECT_TRUE(done) << "timed out";
+}
+
+static Task<> serve(IOEngine& engine, std::shared_ptr<TCPSocket> sock) {
+    char buf[256];
+    while (true) {
+        int nbytes = 0;
+        if (co_await AsyncRead(engine, *sock, buf, sizeof(buf), &nbytes) != error::nil) {
+            break;
+        }
+        if (co_await AsyncWriteFull(engine, *sock, buf, nbytes) != error::nil) {
+            break;
+        }
+    }
+    engine.Cancel(sock->FD());
+}
+
+static Task<> acceptLoop(IOEngine& engine, TCPListener& listener, int nClients) {
+    for (int i = 0; i < nClients; i++) {
+        std::shared_ptr<TCPSocket> sock;
+        error err = co_await AsyncAccept(engine, listener, &sock);
+        EXPECT_EQ(error::nil, err);
+        if (err != error::nil) {
+            co_return;
+        }
+        Spawn(serve(engine, sock));
+    }
+}
+
+static Task<> client(IOEngine& engine, uint16_t port, const std::string message, int* finished) {
+    std::shared_ptr<TCPSocket> sock;
+    error err = co_await AsyncConnectTCP(engine, "localhost", port, &sock);
+    EXPECT_EQ(error::nil, err);
+    if (err != error::nil) {
+        co_return;
+    }
+    EXPECT_EQ(error::nil, co_await AsyncWriteFull(engine, *sock, message.data(), message.size()));
+
+    // then: receive the echoed message
+    std::string buf(message.size(), '\0');
+    EXPECT_EQ(error::nil, co_await AsyncReadFull(engine, *sock, &buf[0], buf.size()));
+    EXPECT_EQ(message, buf);
+    engine.Cancel(sock->FD());
+    (*finished)++;
+}
+
+static void testEchoServer(IOEngineType type) {
+    // setup:
+    const unsigned int port = 8080;
+    const int nClients = 16;
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(type, &engine);
+    if (engine == nullptr) {
+        return; // not supported by this kernel
+    }
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    // when: serve and connect many clients concurrently on a single thread
+    Spawn(acceptLoop(*engine, *listener, nClients));
+    int finished = 0;
+    for (int i = 0; i < nClients; i++) {
+        Spawn(client(*engine, port, "message" + std::to_string(i), &finished));
+    }
+
+    // then: every client receives its own message
+    for (int i = 0; i < 1000 && finished < nClients; i++) {
+        EXPECT_EQ(error::nil, engine->RunOnce(10));
+    }
+    EXPECT_EQ(nClients, finished);
+
+    // cleanup:
+    engine->Cancel(listener->FD());
+    engine->RunOnce(0);
+}
+
+TEST(Coroutine, EpollEchoServer) {
+    testEchoServer(IOEngineType::Epoll);
+}
+
+TEST(Coroutine, IOUringEchoServer) {
+    testEchoServer(IOEngineType::IOUring);
+}
+
+static Task<> echoDatagram(IOEngine& engine, UDPSocket& sock, bool* done) {
+    char buf[256];
+    int nbytes = 0;
+    std::string addr;
+    uint16_t port = 0;
+    EXPECT_EQ(error::nil, co_await AsyncReadFrom(engine, sock, buf, sizeof(buf), &nbytes, &addr, &port));
+    EXPECT_EQ("127.0.0.1", addr);
+    EXPECT_EQ(error::nil, co_await AsyncWriteTo(engine, sock, buf, nbytes, addr, port, nullptr));
+    *done = true;
+}
+
+TEST(Coroutine, Datagram) {
+    // setup:
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(IOEngineType::Epoll, &engine);
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP("localhost", port, &client));
+
+    // when: echo back a datagram
+    bool done = false;
+    Spawn(echoDatagram(*engine, *server, &done));
+    engine->Submit();
+    EXPECT_EQ(error::nil, client->WriteFull(message, sizeof(message)));
+    runUntil(engine, done);
+
+    // then: the client receives the echoed datagram
+    char buf[256] = {0};
+    EXPECT_EQ(error::nil, client->ReadFull(buf, sizeof(message)));
+    EXPECT_STREQ(message, buf);
+}
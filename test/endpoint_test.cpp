@@ -0,0 +1,97 @@
+#include "netlib/endpoint.h"
+#include <map>
+#include <string>
+#include <unordered_set>
+#if defined(_WIN32) || defined(_WIN64)
+ #include <ws2tcpip.h>
+#else
+ #include <netinet/in.h>
+ #include <sys/socket.h>
+#endif // defined(_WIN32) || defined(_WIN64)
+#include <gtest/gtest.h>
+
+using namespace net;
+
+TEST(Endpoint, Unspecified) {
+    Endpoint endpoint;
+
+    EXPECT_FALSE(endpoint.IsSpecified());
+    EXPECT_EQ(0, endpoint.Port());
+    EXPECT_EQ(Endpoint(), endpoint);
+}
+
+TEST(Endpoint, ParseIPv4) {
+    Endpoint endpoint;
+    error err = Endpoint::Parse("192.168.0.1", 8080, &endpoint);
+
+    EXPECT_EQ(error::nil, err);
+    EXPECT_TRUE(endpoint.IsSpecified());
+    EXPECT_FALSE(endpoint.IsIPv6());
+    EXPECT_EQ(8080, endpoint.Port());
+    EXPECT_EQ("192.168.0.1", endpoint.Address());
+    EXPECT_EQ("192.168.0.1:8080", endpoint.String());
+}
+
+TEST(Endpoint, ParseIPv6) {
+    Endpoint endpoint;
+    error err = Endpoint::Parse("::1", 443, &endpoint);
+
+    EXPECT_EQ(error::nil, err);
+    EXPECT_TRUE(endpoint.IsIPv6());
+    EXPECT_EQ("::1", endpoint.Address());
+    EXPECT_EQ("[::1]:443", endpoint.String());
+}
+
+TEST(Endpoint, ParseHostname) {
+    Endpoint endpoint;
+    error err = Endpoint::Parse("localhost", 80, &endpoint);
+
+    EXPECT_EQ(error::illegal_argument, err);
+    EXPECT_FALSE(endpoint.IsSpecified());
+}
+
+TEST(Endpoint, SockAddr) {
+    // setup:
+    Endpoint endpoint;
+    ASSERT_EQ(error::nil, Endpoint::Parse("10.0.0.1", 53, &endpoint));
+
+    // when: convert to a sockaddr
+    struct sockaddr_storage ss;
+    size_t len = endpoint.ToSockAddr(&ss);
+
+    // then:
+    ASSERT_EQ(sizeof(struct sockaddr_in), len);
+    struct sockaddr_in* in4 = (struct sockaddr_in*) &ss;
+    EXPECT_EQ(AF_INET, in4->sin_family);
+    EXPECT_EQ(htons(53), in4->sin_port);
+    EXPECT_EQ(htonl(0x0a000001), in4->sin_addr.s_addr);
+
+    // when: convert back
+    Endpoint converted;
+    ASSERT_EQ(error::nil, Endpoint::FromSockAddr((struct sockaddr*) &ss, len, &converted));
+
+    // then:
+    EXPECT_EQ(endpoint, converted);
+}
+
+TEST(Endpoint, HashAndOrder) {
+    // setup:
+    Endpoint a, b, c, d;
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.1", 1000, &a));
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.1", 1001, &b));
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.2", 1000, &c));
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.1", 1000, &d));
+
+    // when: used as the keys of containers
+    std::unordered_set<Endpoint> set = {a, b, c, d};
+    std::map<Endpoint, int> map = {{a, 0}, {b, 1}, {c, 2}, {d, 3}};
+
+    // then: the equal endpoints are the same key
+    EXPECT_EQ(a, d);
+    EXPECT_EQ(a.Hash(), d.Hash());
+    EXPECT_NE(a, b);
+    EXPECT_EQ(3u, set.size());
+    EXPECT_EQ(3u, map.size());
+    EXPECT_TRUE(a < b);
+    EXPECT_TRUE(b < c);
+}
@@ -0,0 +1,261 @@
+#include "netlib/event_loop.h"
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include "netlib/tcp.h"
+
+using namespace net;
+
+TEST(EventLoop, EchoServer) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    error err;
+
+    std::shared_ptr<EventLoop> loop;
+    err = NewEventLoop(&loop);
+    ASSERT_EQ(error::nil, err);
+
+    std::shared_ptr<TCPListener> listener;
+    err = ListenTCP(port, &listener);
+    ASSERT_EQ(error::nil, err);
+
+    // when: register the listener, and echo back everything the accepted sockets receive
+    EventHandler listenerHandler;
+    listenerHandler.OnReadable = [&]() {
+        while (true) {
+            std::shared_ptr<TCPSocket> socket;
+            if (listener->Accept(&socket) != error::nil) {
+                break;
+            }
+            EventHandler socketHandler;
+            socketHandler.OnReadable = [=]() {
+                char buf[256];
+                int nbytes;
+                while (true) {
+                    error err = socket->Read(buf, sizeof(buf), &nbytes);
+                    if (err != error::nil) {
+                        if (err != error::wouldblock) {
+                            loop->Remove(socket->FD());
+                        }
+                        break;
+                    }
+                    socket->WriteFull(buf, nbytes);
+                }
+            };
+            EXPECT_EQ(error::nil, socket->SetNonBlocking(true));
+            EXPECT_EQ(error::nil, loop->Add(socket->FD(), socketHandler));
+        }
+    };
+    ASSERT_EQ(error::nil, listener->SetNonBlocking(true));
+    err = loop->Add(listener->FD(), listenerHandler);
+    ASSERT_EQ(error::nil, err);
+
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+
+    // when: connect to the server and send a message
+    std::shared_ptr<TCPSocket> socket;
+    err = ConnectTCP(host, port, connectionTimeout, &socket);
+    ASSERT_EQ(error::nil, err);
+    err = socket->WriteFull(message, sizeof(message));
+    EXPECT_EQ(error::nil, err);
+
+    // then: receive the echoed message
+    char buf[256] = {0};
+    err = socket->ReadFull(buf, sizeof(message));
+    EXPECT_EQ(error::nil, err);
+    EXPECT_STREQ(message, buf);
+
+    // when: close the client
+    socket->Close();
+
+    // then: the server socket is removed on end of file
+    std::promise<size_t> promise;
+    auto future = promise.get_future();
+    for (int i = 0; i < 100 && loop->Size() > 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    loop->Post([&]() {
+        promise.set_value(loop->Size());
+    });
+    EXPECT_EQ(1u, future.get());
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    loop->Remove(listener->FD());
+}
+
+TEST(EventLoop, RunOnceTimeout) {
+    using namespace std::chrono;
+
+    // setup:
+    const int64_t timeout = 10; // ms
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+
+    // when: wait without any events
+    auto start = system_clock::now();
+    error err = loop->RunOnce(timeout);
+    auto diff = duration_cast<milliseconds>(system_clock::now() - start);
+
+    // then: time of timeout is accurate
+    EXPECT_EQ(error::nil, err);
+    EXPECT_NEAR(timeout, diff.count(), timeout * 0.5);
+}
+
+TEST(EventLoop, ClosedByPeerReset) {
+    // setup:
+    const unsigned int port = 8080;
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP("localhost", port, 1000, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+
+    // when: register the server socket, and reset the connection from the client
+    error closedErr = error::nil;
+    EventHandler handler;
+    handler.OnClosed = [&](const error& err) {
+        closedErr = err;
+    };
+    ASSERT_EQ(error::nil, server->SetNonBlocking(true));
+    ASSERT_EQ(error::nil, loop->Add(server->FD(), handler));
+    struct linger lin = {1, 0};
+    setsockopt(client->FD(), SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+    client->Close();
+    for (int i = 0; i < 10 && closedErr == error::nil; i++) {
+        loop->RunOnce(100);
+    }
+
+    // then: the socket is reported as closed and unregistered
+    EXPECT_EQ(error::connreset, closedErr);
+    EXPECT_EQ(0u, loop->Size());
+}
+
+#ifdef __linux__
+TEST(EventLoop, ZeroCopyCompletions) {
+    // setup:
+    const unsigned int port = 8080;
+    const std::string message(64 * 1024, 'x');
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP("localhost", port, 1000, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    error err = server->SetZeroCopy(true);
+    if (err == error::opnotsupp) {
+        return; // the kernel is older than 4.14
+    }
+    ASSERT_EQ(error::nil, err);
+
+    // when: register the server socket, and send without copying
+    std::vector<ZeroCopyCompletion> completions;
+    bool closed = false;
+    EventHandler handler;
+    handler.OnErrorQueue = [&]() {
+        server->ReadZeroCopyCompletions(&completions);
+    };
+    handler.OnClosed = [&](const error&) {
+        closed = true;
+    };
+    ASSERT_EQ(error::nil, server->SetNonBlocking(true));
+    ASSERT_EQ(error::nil, loop->Add(server->FD(), handler));
+    int nbytes = 0;
+    uint32_t id = 0;
+    ASSERT_EQ(error::nil, server->WriteZeroCopy(message.data(), message.size(), &nbytes, &id));
+    ASSERT_EQ((int) message.size(), nbytes);
+    std::string received(message.size(), '\0');
+    ASSERT_EQ(error::nil, client->ReadFull(&received[0], received.size()));
+    for (int i = 0; i < 10 && (completions.empty() || completions.back().Last != id); i++) {
+        loop->RunOnce(100);
+    }
+
+    // then: the completion is delivered, and the socket stays registered
+    ASSERT_FALSE(completions.empty());
+    EXPECT_EQ(id, completions.back().Last);
+    EXPECT_FALSE(closed);
+    EXPECT_EQ(1u, loop->Size());
+
+    // cleanup:
+    loop->Remove(server->FD());
+}
+#endif // __linux__
+
+TEST(EventLoop, RunAfter) {
+    using namespace std::chrono;
+
+    // setup:
+    const int64_t delay = 10; // ms
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+
+    // when: schedule a timer, and cancel another one
+    bool fired = false;
+    bool cancelled = true;
+    loop->RunAfter(delay, [&]() {
+        fired = true;
+    });
+    TimerID id = loop->RunAfter(delay, [&]() {
+        cancelled = false;
+    });
+    EXPECT_TRUE(loop->CancelTimer(id));
+    auto start = system_clock::now();
+    error err = loop->RunOnce(-1);
+    auto diff = duration_cast<milliseconds>(system_clock::now() - start);
+
+    // then: the loop wakes up for the timer only
+    EXPECT_EQ(error::nil, err);
+    EXPECT_TRUE(fired);
+    EXPECT_TRUE(cancelled);
+    EXPECT_NEAR(delay, diff.count(), delay * 0.5);
+}
+
+TEST(EventLoop, IdleTimeout) {
+    // setup:
+    const unsigned int port = 8080;
+    const int64_t idleTimeout = 20; // ms
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP("localhost", port, 1000, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+
+    // when: register the server socket with an idle timeout, and send nothing
+    error closedErr = error::nil;
+    EventHandler handler;
+    handler.OnClosed = [&](const error& err) {
+        closedErr = err;
+    };
+    ASSERT_EQ(error::nil, server->SetNonBlocking(true));
+    ASSERT_EQ(error::nil, loop->Add(server->FD(), handler));
+    ASSERT_EQ(error::nil, loop->SetIdleTimeout(server->FD(), idleTimeout));
+    for (int i = 0; i < 10 && closedErr == error::nil; i++) {
+        loop->RunOnce(100);
+    }
+
+    // then: the socket times out and is unregistered
+    EXPECT_EQ(error::timedout, closedErr);
+    EXPECT_EQ(0u, loop->Size());
+}
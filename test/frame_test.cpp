@@ -0,0 +1,185 @@
+#include "netlib/frame.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+namespace {
+
+// An in-memory pipe which counts the calls.
+// Writes fail with error::wouldblock once Budget bytes have been written.
+class Pipe final : public ReadWriter {
+public:
+    std::string Data;
+    int Reads = 0;
+    int Writes = 0;
+    size_t Budget = SIZE_MAX;
+
+    error Read(char* buf, size_t len, int* nbytes) {
+        Reads++;
+        if (Data.empty()) {
+            return error::eof;
+        }
+        size_t n = (len < Data.size()) ? len : Data.size();
+        memcpy(buf, Data.data(), n);
+        Data.erase(0, n);
+        *nbytes = (int) n;
+        return error::nil;
+    }
+
+    error Write(const char* buf, size_t len, int* nbytes) {
+        IOVec iov = {const_cast<char*>(buf), len};
+        return WriteV(&iov, 1, nbytes);
+    }
+
+    error WriteV(const IOVec* iov, size_t iovcnt, int* nbytes) {
+        Writes++;
+        if (Budget == 0) {
+            return error::wouldblock;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < iovcnt && Budget > 0; i++) {
+            size_t m = (iov[i].Len < Budget) ? iov[i].Len : Budget;
+            Data.append(iov[i].Base, m);
+            Budget -= m;
+            n += m;
+        }
+        *nbytes = (int) n;
+        return error::nil;
+    }
+};
+
+} // namespace
+
+TEST(Frame, Fixed32) {
+    // setup:
+    std::shared_ptr<Pipe> pipe = std::make_shared<Pipe>();
+    FrameConfig config = {LengthPrefix::Fixed32, ByteOrder::BigEndian, 0};
+    FrameWriter writer(pipe, config);
+    FrameReader reader(pipe, config);
+
+    // when: write a batch of frames
+    ASSERT_EQ(error::nil, writer.Add("first", 5));
+    ASSERT_EQ(error::nil, writer.Add("", 0));
+    IOBuf chained("thi", 3);
+    chained.Append(IOBuf("rd", 2));
+    ASSERT_EQ(error::nil, writer.Add(chained));
+    EXPECT_EQ(22u, writer.Pending());
+    ASSERT_EQ(error::nil, writer.Flush());
+
+    // then: the frames are written with a single call
+    EXPECT_EQ(1, pipe->Writes);
+    EXPECT_EQ(0u, writer.Pending());
+    EXPECT_EQ(std::string("\0\0\0\5first", 9), pipe->Data.substr(0, 9));
+
+    // then: the frames are read with a single call
+    std::vector<char> frame;
+    ASSERT_EQ(error::nil, reader.ReadFrame(&frame));
+    EXPECT_EQ("first", std::string(frame.begin(), frame.end()));
+    ASSERT_EQ(error::nil, reader.ReadFrame(&frame));
+    EXPECT_EQ(0u, frame.size());
+    ASSERT_EQ(error::nil, reader.ReadFrame(&frame));
+    EXPECT_EQ("third", std::string(frame.begin(), frame.end()));
+    EXPECT_EQ(1, pipe->Reads);
+    EXPECT_EQ(error::eof, reader.ReadFrame(&frame));
+}
+
+TEST(Frame, Varint) {
+    // setup:
+    std::shared_ptr<Pipe> pipe = std::make_shared<Pipe>();
+    FrameConfig config = {LengthPrefix::Varint, ByteOrder::BigEndian, 0};
+    FrameWriter writer(pipe, config);
+    FrameReader reader(pipe, config, 64); // smaller than the frames
+    const std::string small(127, 'a');
+    const std::string large(300, 'b');
+
+    // when:
+    ASSERT_EQ(error::nil, writer.WriteFrame(small.data(), small.size()));
+    ASSERT_EQ(error::nil, writer.WriteFrame(large.data(), large.size()));
+
+    // then: the prefixes take one and two bytes
+    EXPECT_EQ(1 + 127 + 2 + 300u, pipe->Data.size());
+    EXPECT_EQ('\x7f', pipe->Data[0]);
+    EXPECT_EQ(std::string("\xac\x02"), pipe->Data.substr(128, 2));
+
+    // then:
+    std::vector<char> frame;
+    ASSERT_EQ(error::nil, reader.ReadFrame(&frame));
+    EXPECT_EQ(small, std::string(frame.begin(), frame.end()));
+    ASSERT_EQ(error::nil, reader.ReadFrame(&frame));
+    EXPECT_EQ(large, std::string(frame.begin(), frame.end()));
+}
+
+TEST(Frame, MaxFrameSize) {
+    // setup:
+    std::shared_ptr<Pipe> pipe = std::make_shared<Pipe>();
+    FrameConfig config = {LengthPrefix::Fixed16, ByteOrder::LittleEndian, 4};
+    FrameWriter writer(pipe, config);
+    FrameReader reader(pipe, config);
+
+    // when: add a frame larger than the limit
+    // then: nothing is added
+    EXPECT_EQ(error::msgsize, writer.Add("12345", 5));
+    EXPECT_EQ(0u, writer.Pending());
+
+    // when: read a frame larger than the limit
+    pipe->Data = std::string("\x05\x00" "12345", 7);
+
+    // then:
+    std::vector<char> frame;
+    EXPECT_EQ(error::msgsize, reader.ReadFrame(&frame));
+}
+
+TEST(Frame, HostilePrefix) {
+    // setup: the default limit
+    std::shared_ptr<Pipe> pipe = std::make_shared<Pipe>();
+    FrameConfig varint = {LengthPrefix::Varint, ByteOrder::BigEndian, 0};
+    FrameConfig fixed32 = {LengthPrefix::Fixed32, ByteOrder::BigEndian, 0};
+    std::vector<char> frame;
+
+    // when: a varint prefix of nearly 2^64
+    pipe->Data = std::string(9, '\xff') + '\x01';
+
+    // then: it is rejected without allocating
+    EXPECT_EQ(error::msgsize, FrameReader(pipe, varint).ReadFrame(&frame));
+    EXPECT_TRUE(frame.empty());
+
+    // when: a varint prefix beyond 64 bits
+    pipe->Data = std::string(9, '\xff') + '\x02';
+
+    // then:
+    EXPECT_EQ(error::proto, FrameReader(pipe, varint).ReadFrame(&frame));
+
+    // when: a fixed prefix of 4 GB
+    pipe->Data = std::string(4, '\xff');
+
+    // then:
+    EXPECT_EQ(error::msgsize, FrameReader(pipe, fixed32).ReadFrame(&frame));
+    EXPECT_TRUE(frame.empty());
+}
+
+TEST(Frame, FlushAfterPartialWrite) {
+    // setup:
+    std::shared_ptr<Pipe> pipe = std::make_shared<Pipe>();
+    FrameConfig config = {LengthPrefix::Fixed16, ByteOrder::BigEndian, 0};
+    FrameWriter writer(pipe, config);
+    ASSERT_EQ(error::nil, writer.Add("abc", 3));
+    ASSERT_EQ(error::nil, writer.Add("defg", 4));
+
+    // when: the destination accepts a part of the second frame only
+    pipe->Budget = 7;
+    EXPECT_EQ(error::wouldblock, writer.Flush());
+
+    // then: the rest is kept
+    EXPECT_EQ(4u, writer.Pending());
+
+    // when: flush again
+    pipe->Budget = SIZE_MAX;
+    ASSERT_EQ(error::nil, writer.Flush());
+
+    // then: every byte is written once in order
+    EXPECT_EQ(std::string("\0\3abc\0\4defg", 11), pipe->Data);
+}
@@ -0,0 +1,281 @@
+#include "netlib/io_engine.h"
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include "netlib/tcp.h"
+#include "netlib/udp.h"
+
+using namespace net;
+
+static void newEngine(IOEngineType type, std::shared_ptr<IOEngine>* engine) {
+    IOEngineConfig config = {};
+    config.Type = type;
+    error err = NewIOEngine(config, engine);
+    if (err == error::opnotsupp) {
+        return;
+    }
+    ASSERT_EQ(error::nil, err);
+}
+
+static void runUntil(const std::shared_ptr<IOEngine>& engine, std::future<void>& future) {
+    for (int i = 0; i < 1000; i++) {
+        if (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            return;
+        }
+        EXPECT_EQ(error::nil, engine->RunOnce(10));
+    }
+    FAIL() << "timed out";
+}
+
+static void testEchoServer(IOEngineType type) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(type, &engine);
+    if (engine == nullptr) {
+        return; // not supported by this kernel
+    }
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    // when: accept clients, and echo back everything they send
+    std::vector<std::shared_ptr<TCPSocket>> sockets;
+    error err = engine->AcceptMultishot(listener->FD(), [&](const error& err, const std::shared_ptr<TCPSocket>& sock) {
+        if (err != error::nil) {
+            return; // cancelled
+        }
+        sockets.push_back(sock);
+        engine->RecvMultishot(sock->FD(), [=](const error& err, const char* data, int nbytes) {
+            if (err != error::nil) {
+                return;
+            }
+            std::shared_ptr<std::string> buf = std::make_shared<std::string>(data, nbytes);
+            engine->Send(sock->FD(), buf->data(), buf->size(), [buf](const error& err, int nbytes) {
+                EXPECT_EQ(error::nil, err);
+                EXPECT_EQ((int) buf->size(), nbytes);
+            });
+        });
+    });
+    ASSERT_EQ(error::nil, err);
+
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    std::thread th([&]() {
+        std::shared_ptr<TCPSocket> socket;
+        ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &socket));
+        EXPECT_EQ(error::nil, socket->WriteFull(message, sizeof(message)));
+
+        // then: receive the echoed message
+        char buf[256] = {0};
+        EXPECT_EQ(error::nil, socket->ReadFull(buf, sizeof(message)));
+        EXPECT_STREQ(message, buf);
+        promise.set_value();
+    });
+    runUntil(engine, future);
+
+    // cleanup:
+    th.join();
+    for (auto& sock : sockets) {
+        engine->Cancel(sock->FD());
+    }
+    engine->Cancel(listener->FD());
+    engine->RunOnce(0);
+}
+
+TEST(IOEngine, EpollEchoServer) {
+    testEchoServer(IOEngineType::Epoll);
+}
+
+TEST(IOEngine, IOUringEchoServer) {
+    testEchoServer(IOEngineType::IOUring);
+}
+
+static void testConnectAndSend(IOEngineType type) {
+    // setup:
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(type, &engine);
+    if (engine == nullptr) {
+        return;
+    }
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    // when: connect to the server and send a message
+    std::shared_ptr<TCPSocket> client;
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    error err = engine->Connect("127.0.0.1", port, [&](const error& err, const std::shared_ptr<TCPSocket>& sock) {
+        ASSERT_EQ(error::nil, err);
+        // then: the socket is in blocking mode whichever the backend is
+        EXPECT_FALSE(sock->IsNonBlocking());
+        EXPECT_EQ(0, fcntl(sock->FD(), F_GETFL) & O_NONBLOCK);
+        client = sock;
+        engine->Send(sock->FD(), message, sizeof(message), [&](const error& err, int nbytes) {
+            EXPECT_EQ(error::nil, err);
+            EXPECT_EQ((int) sizeof(message), nbytes);
+            promise.set_value();
+        });
+    });
+    ASSERT_EQ(error::nil, err);
+    runUntil(engine, future);
+
+    // then: the server receives the message
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    char buf[256] = {0};
+    EXPECT_EQ(error::nil, server->ReadFull(buf, sizeof(message)));
+    EXPECT_STREQ(message, buf);
+
+    // when: close the server side
+    server->Close();
+
+    // then: the client receives end of file
+    std::promise<void> eofPromise;
+    auto eofFuture = eofPromise.get_future();
+    engine->Recv(client->FD(), buf, sizeof(buf), [&](const error& err, int nbytes) {
+        EXPECT_EQ(error::eof, err);
+        eofPromise.set_value();
+    });
+    runUntil(engine, eofFuture);
+    engine->Cancel(client->FD());
+}
+
+TEST(IOEngine, EpollConnectAndSend) {
+    testConnectAndSend(IOEngineType::Epoll);
+}
+
+TEST(IOEngine, IOUringConnectAndSend) {
+    testConnectAndSend(IOEngineType::IOUring);
+}
+
+TEST(IOEngine, EpollReusedFD) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(IOEngineType::Epoll, &engine);
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> first;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &first));
+    std::shared_ptr<TCPSocket> stale;
+    ASSERT_EQ(error::nil, listener->Accept(&stale));
+    SocketFD fd = stale->FD();
+    char staleBuf[256];
+    error staleErr = error::nil;
+    ASSERT_EQ(error::nil, engine->Recv(fd, staleBuf, sizeof(staleBuf), [&](const error& err, int nbytes) {
+        staleErr = err;
+    }));
+    ASSERT_EQ(error::nil, engine->RunOnce(0));
+
+    // when: close the socket without Cancel, and accept a new one into the same fd
+    std::shared_ptr<TCPSocket> second;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &second));
+    stale->Close();
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    ASSERT_EQ(fd, server->FD());
+
+    // when: receive on the new socket before anything has been sent
+    char buf[256] = {0};
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    ASSERT_EQ(error::nil, engine->Recv(server->FD(), buf, sizeof(buf), [&](const error& err, int nbytes) {
+        EXPECT_EQ(error::nil, err);
+        EXPECT_EQ((int) sizeof(message), nbytes);
+        promise.set_value();
+    }));
+
+    // then: the engine does not block, and the operation of the closed socket is aborted
+    ASSERT_EQ(error::nil, engine->RunOnce(0));
+    EXPECT_EQ(error::wrap(etype::os, EBADF), staleErr);
+
+    // then: the new socket receives
+    ASSERT_EQ(error::nil, second->WriteFull(message, sizeof(message)));
+    runUntil(engine, future);
+    EXPECT_STREQ(message, buf);
+
+    // cleanup:
+    engine->Cancel(server->FD());
+    engine->RunOnce(0);
+}
+
+static void testDatagram(IOEngineType type) {
+    // setup:
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<IOEngine> engine;
+    newEngine(type, &engine);
+    if (engine == nullptr) {
+        return;
+    }
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP("localhost", port, &client));
+
+    // when: receive a datagram and send it back to the sender
+    char buf[256] = {0};
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    engine->RecvFrom(server->FD(), buf, sizeof(buf), [&](const error& err, int nbytes, const std::string& addr, uint16_t port) {
+        EXPECT_EQ(error::nil, err);
+        EXPECT_EQ("127.0.0.1", addr);
+        engine->SendTo(server->FD(), buf, nbytes, addr, port, [&](const error& err, int nbytes) {
+            EXPECT_EQ(error::nil, err);
+            promise.set_value();
+        });
+    });
+    engine->Submit();
+    EXPECT_EQ(error::nil, client->WriteFull(message, sizeof(message)));
+    runUntil(engine, future);
+
+    // then: the client receives the echoed datagram
+    char echoed[256] = {0};
+    EXPECT_EQ(error::nil, client->ReadFull(echoed, sizeof(message)));
+    EXPECT_STREQ(message, echoed);
+    engine->Cancel(server->FD());
+}
+
+TEST(IOEngine, EpollDatagram) {
+    testDatagram(IOEngineType::Epoll);
+}
+
+TEST(IOEngine, IOUringDatagram) {
+    testDatagram(IOEngineType::IOUring);
+}
+
+TEST(IOEngine, PostAndStop) {
+    for (auto type : { IOEngineType::Epoll, IOEngineType::IOUring }) {
+        std::shared_ptr<IOEngine> engine;
+        newEngine(type, &engine);
+        if (engine == nullptr) {
+            continue;
+        }
+
+        // when: post a task from another thread which stops the engine
+        std::thread th([&]() {
+            engine->Post([&]() {
+                engine->Stop();
+            });
+        });
+
+        // then: Run returns
+        EXPECT_EQ(error::nil, engine->Run());
+        th.join();
+    }
+}
@@ -0,0 +1,125 @@
+#include "netlib/iobuf.h"
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+static std::string toString(const IOBuf& buf) {
+    std::string s(buf.Length(), '\0');
+    buf.CopyTo(0, &s[0], s.size());
+    return s;
+}
+
+TEST(IOBuf, AppendAndPrepend) {
+    // setup:
+    IOBuf buf(16, 4);
+
+    // when: append within the block, and prepend into the headroom
+    buf.Append("body", 4);
+    buf.Prepend("hd", 2);
+
+    // then: a single segment holds the bytes
+    EXPECT_EQ("hdbody", toString(buf));
+    EXPECT_EQ(1u, buf.CountSegments());
+    EXPECT_EQ(2u, buf.Headroom());
+    EXPECT_EQ(8u, buf.Tailroom());
+
+    // when: prepend and append beyond the rooms
+    buf.Prepend("head", 4);
+    buf.Append(std::string(10, 'x').data(), 10);
+
+    // then: new blocks are chained
+    EXPECT_EQ("headhdbody" + std::string(10, 'x'), toString(buf));
+    EXPECT_EQ(3u, buf.CountSegments());
+    EXPECT_EQ(20u, buf.Length());
+}
+
+TEST(IOBuf, Move) {
+    // setup:
+    IOBuf buf("0123456789", 10);
+
+    // when: move construct
+    IOBuf moved(std::move(buf));
+
+    // then: the source is left empty
+    EXPECT_EQ("0123456789", toString(moved));
+    EXPECT_TRUE(buf.Empty());
+    EXPECT_EQ(0u, buf.CountSegments());
+
+    // when: move assign, and reuse the source
+    IOBuf assigned;
+    assigned = std::move(moved);
+    moved.Append("abc", 3);
+
+    // then:
+    EXPECT_EQ("0123456789", toString(assigned));
+    EXPECT_EQ("abc", toString(moved));
+}
+
+TEST(IOBuf, SliceSharesBlocks) {
+    // setup:
+    IOBuf buf("0123456789", 10);
+
+    // when: slice a range
+    IOBuf slice = buf.Slice(2, 5);
+
+    // then: the bytes are shared, so the block is no longer writable in place
+    EXPECT_EQ("23456", toString(slice));
+    EXPECT_EQ(0u, buf.Tailroom());
+
+    // when: append to both
+    buf.Append("a", 1);
+    slice.Append("b", 1);
+
+    // then: neither sees the bytes of the other
+    EXPECT_EQ("0123456789a", toString(buf));
+    EXPECT_EQ("23456b", toString(slice));
+}
+
+TEST(IOBuf, ChainAndTrim) {
+    // setup:
+    IOBuf header("head", 4);
+    IOBuf body("body", 4);
+    IOBuf trailer("tail", 4);
+
+    // when: chain the parts without copying
+    IOBuf message = header;
+    message.Append(body);
+    message.Append(trailer);
+
+    // then:
+    EXPECT_EQ("headbodytail", toString(message));
+    EXPECT_EQ(3u, message.CountSegments());
+
+    // when: trim across segments
+    message.TrimStart(6);
+    message.TrimEnd(3);
+
+    // then:
+    EXPECT_EQ("dyt", toString(message));
+    EXPECT_EQ(2u, message.CountSegments());
+    EXPECT_EQ("body", toString(body)); // the parts are unchanged
+}
+
+TEST(IOBuf, CoalesceAndIOVecs) {
+    // setup:
+    IOBuf buf("abc", 3);
+    buf.Append(IOBuf("def", 3));
+
+    // when: convert to buffers for a vectored write
+    std::vector<IOVec> iov;
+    buf.ToIOVecs(&iov);
+
+    // then: a buffer per segment
+    ASSERT_EQ(2u, iov.size());
+    EXPECT_EQ("abc", std::string(iov[0].Base, iov[0].Len));
+    EXPECT_EQ("def", std::string(iov[1].Base, iov[1].Len));
+
+    // when: coalesce
+    const char* data = buf.Coalesce();
+
+    // then: a single contiguous segment
+    EXPECT_EQ(1u, buf.CountSegments());
+    EXPECT_EQ("abcdef", std::string(data, buf.Length()));
+}
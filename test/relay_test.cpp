@@ -0,0 +1,125 @@
+#include "netlib/relay.h"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+namespace {
+
+struct Pair {
+    std::shared_ptr<TCPSocket> Client;
+    std::shared_ptr<TCPSocket> Server;
+};
+
+void connectPair(const std::shared_ptr<TCPListener>& listener, unsigned int port, Pair* pair) {
+    const int64_t connectionTimeout = 1000; // ms
+    ASSERT_EQ(error::nil, ConnectTCP("localhost", port, connectionTimeout, &pair->Client));
+    ASSERT_EQ(error::nil, listener->Accept(&pair->Server));
+}
+
+} // namespace
+
+TEST(Relay, BothDirectionsWithHalfClose) {
+    // setup:
+    const unsigned int port = 8080;
+    const std::string message(256 * 1024, 'x'); // larger than the pipes
+    const std::string reply = "reply";
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    Pair pairA, pairB;
+    connectPair(listener, port, &pairA);
+    connectPair(listener, port, &pairB);
+
+    std::promise<error> done;
+    std::shared_ptr<Relay> relay;
+    ASSERT_EQ(error::nil, NewRelay(loop, pairA.Server, pairB.Server, RelayConfig{0, 0}, [&](const error& err) {
+        done.set_value(err);
+    }, &relay));
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+
+    // when: A sends a message and shuts down its writing side
+    auto written = std::async(std::launch::async, [&]() {
+        EXPECT_EQ(error::nil, pairA.Client->WriteFull(message.data(), message.size()));
+        EXPECT_EQ(error::nil, pairA.Client->CloseWrite());
+    });
+
+    // then: B receives the message and end of file
+    std::string received(message.size(), '\0');
+    EXPECT_EQ(error::nil, pairB.Client->ReadFull(&received[0], received.size()));
+    EXPECT_TRUE(message == received);
+    written.get();
+    char buf[16] = {0};
+    int nbytes = 0;
+    EXPECT_EQ(error::eof, pairB.Client->Read(buf, sizeof(buf), &nbytes));
+
+    // when: B replies after end of file, and closes
+    EXPECT_EQ(error::nil, pairB.Client->WriteFull(reply.data(), reply.size()));
+    EXPECT_EQ(error::nil, pairB.Client->Close());
+
+    // then: A receives the reply and end of file, and the relay finishes
+    EXPECT_EQ(error::nil, pairA.Client->ReadFull(buf, reply.size()));
+    EXPECT_STREQ(reply.c_str(), buf);
+    EXPECT_EQ(error::eof, pairA.Client->Read(buf, sizeof(buf), &nbytes));
+    EXPECT_EQ(error::nil, done.get_future().get());
+    EXPECT_EQ(message.size(), relay->BytesAToB());
+    EXPECT_EQ(reply.size(), relay->BytesBToA());
+    EXPECT_TRUE(pairA.Server->IsClosed());
+    EXPECT_TRUE(pairB.Server->IsClosed());
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    pairA.Client->Close();
+}
+
+TEST(Relay, IdleTimeout) {
+    // setup:
+    const unsigned int port = 8080;
+    const int64_t idleTimeout = 50; // ms
+
+    std::shared_ptr<EventLoop> loop;
+    ASSERT_EQ(error::nil, NewEventLoop(&loop));
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    Pair pairA, pairB;
+    connectPair(listener, port, &pairA);
+    connectPair(listener, port, &pairB);
+
+    std::promise<error> done;
+    std::shared_ptr<Relay> relay;
+    ASSERT_EQ(error::nil, NewRelay(loop, pairA.Server, pairB.Server, RelayConfig{idleTimeout, 0}, [&](const error& err) {
+        done.set_value(err);
+    }, &relay));
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, loop->Run());
+    });
+
+    // when: some bytes are relayed, and then nothing
+    EXPECT_EQ(error::nil, pairA.Client->WriteFull("ping", 4));
+    char buf[8] = {0};
+    EXPECT_EQ(error::nil, pairB.Client->ReadFull(buf, 4));
+
+    // then: the relay times out, and closes the connections
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(error::timedout, done.get_future().get());
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    EXPECT_LE(elapsed.count(), idleTimeout * 4);
+    int nbytes = 0;
+    EXPECT_EQ(error::eof, pairA.Client->Read(buf, sizeof(buf), &nbytes));
+    EXPECT_EQ(error::eof, pairB.Client->Read(buf, sizeof(buf), &nbytes));
+
+    // cleanup:
+    loop->Stop();
+    th.join();
+    pairA.Client->Close();
+    pairB.Client->Close();
+}
@@ -1,5 +1,7 @@
 #include "netlib/resolver.h"
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 using namespace net;
@@ -19,3 +21,19 @@ TEST(LookupAddress, LocalIPv4) {
     EXPECT_EQ(error::nil, err);
     EXPECT_EQ("127.0.0.1", addr);
 }
+
+TEST(LookupAddresses, Localhost) {
+    std::vector<std::string> addrs;
+    error err = LookupAddresses("localhost", &addrs);
+
+    EXPECT_EQ(error::nil, err);
+    EXPECT_NE(addrs.end(), std::find(addrs.begin(), addrs.end(), "127.0.0.1"));
+}
+
+TEST(LookupAddresses, LocalIPv6) {
+    std::vector<std::string> addrs;
+    error err = LookupAddresses("::1", &addrs);
+
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(std::vector<std::string>{"::1"}, addrs);
+}
@@ -0,0 +1,65 @@
+#include "netlib/stream.h"
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+namespace {
+
+// Writes at most kMaxWrite bytes per call, and the first buffer only on WriteV.
+class ShortWriter final : public Writer {
+public:
+    static const size_t kMaxWrite = 3;
+    std::string Written;
+    int Calls = 0;
+
+    error Write(const char* buf, size_t len, int* nbytes) {
+        size_t n = (len < kMaxWrite) ? len : kMaxWrite;
+        Written.append(buf, n);
+        Calls++;
+        *nbytes = (int) n;
+        return error::nil;
+    }
+};
+
+} // namespace
+
+TEST(Stream, WriteFullV) {
+    // setup:
+    char header[] = "head";
+    char empty[] = "";
+    char payload[] = "payload";
+    const IOVec iov[] = {{header, 4}, {empty, 0}, {payload, 7}};
+    ShortWriter writer;
+
+    // when: write the buffers with short writes
+    size_t nbytes = 0;
+    error err = writer.WriteFullV(iov, 3, &nbytes);
+
+    // then: every buffer is written in order, resuming from the middle of a buffer
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(11u, nbytes);
+    EXPECT_EQ("headpayload", writer.Written);
+    EXPECT_EQ(5, writer.Calls); // "hea", "d", "pay", "loa", "d"
+
+    // then: iov is left as is
+    EXPECT_EQ(header, iov[0].Base);
+    EXPECT_EQ(4u, iov[0].Len);
+    EXPECT_EQ(payload, iov[2].Base);
+    EXPECT_EQ(7u, iov[2].Len);
+}
+
+TEST(Stream, WriteFullVEmpty) {
+    // setup:
+    ShortWriter writer;
+
+    // when: write no buffers
+    size_t nbytes = 1;
+    error err = writer.WriteFullV(nullptr, 0, &nbytes);
+
+    // then: nothing is written
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(0u, nbytes);
+    EXPECT_EQ(0, writer.Calls);
+}
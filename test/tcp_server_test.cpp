@@ -0,0 +1,212 @@
+#include "netlib/tcp_server.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+ #include <arpa/inet.h>
+ #include <netinet/in.h>
+ #include <sys/socket.h>
+ #include <unistd.h>
+#endif // __linux__
+#include <gtest/gtest.h>
+#include "test_helper.h"
+
+using namespace net;
+
+TEST(TCPServer, Serve) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int nClients = 32;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    // when: serve connections which echo back a message
+    TCPServerConfig config = {};
+    config.Workers = 4;
+    config.QueueCapacity = 8;
+    std::shared_ptr<TCPServer> server;
+    error err = NewTCPServer(listener, config, [&](const std::shared_ptr<TCPSocket>& sock) {
+        char buf[256] = {0};
+        if (sock->ReadFull(buf, sizeof(message)) == error::nil) {
+            sock->WriteFull(buf, sizeof(message));
+        }
+        sock->Close();
+    }, &server);
+    ASSERT_EQ(error::nil, err);
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, server->Serve());
+    });
+
+    // when: connect more clients than the workers and the queue can take at once
+    std::vector<std::shared_ptr<TCPSocket>> sockets;
+    for (int i = 0; i < nClients; i++) {
+        std::shared_ptr<TCPSocket> socket;
+        ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &socket));
+        EXPECT_EQ(error::nil, socket->WriteFull(message, sizeof(message)));
+        sockets.push_back(socket);
+    }
+
+    // then: every client receives the echoed message
+    for (auto& socket : sockets) {
+        char buf[256] = {0};
+        EXPECT_EQ(error::nil, socket->ReadFull(buf, sizeof(message)));
+        EXPECT_STREQ(message, buf);
+        socket->Close();
+    }
+    for (int i = 0; i < 100 && server->Stats().Handled < (uint64_t) nClients; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    TCPServerStats stats = server->Stats();
+    EXPECT_EQ((uint64_t) nClients, stats.Accepted);
+    EXPECT_EQ((uint64_t) nClients, stats.Handled);
+    EXPECT_EQ(0u, stats.QueueDepth);
+    EXPECT_LE(stats.MaxQueueDepth, config.QueueCapacity);
+
+    // then: Serve returns after Close
+    EXPECT_EQ(error::nil, server->Close());
+    th.join();
+}
+
+TEST(TCPServer, CloseWhileServing) {
+    // setup:
+    const unsigned int port = 8080;
+
+    for (int i = 0; i < 50; i++) {
+        std::shared_ptr<TCPListener> listener;
+        ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+        std::shared_ptr<TCPServer> server;
+        ASSERT_EQ(error::nil, NewTCPServer(listener, TCPServerConfig(), [](const std::shared_ptr<TCPSocket>& sock) {
+            sock->Close();
+        }, &server));
+
+        // when: close while Serve is starting or blocked in Accept
+        std::thread th([&]() {
+            EXPECT_EQ(error::nil, server->Serve());
+        });
+        if (i % 2 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_EQ(error::nil, server->Close());
+        th.join();
+
+        // then: the listener is closed after Serve has returned
+        EXPECT_TRUE(listener->IsClosed());
+    }
+}
+
+TEST(TCPServer, CloseClosesWaitingConnections) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int nClients = 3;
+    const int64_t connectionTimeout = 1000; // ms
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    TCPServerConfig config = {};
+    config.Workers = 1;
+    std::atomic<bool> release(false);
+    std::shared_ptr<TCPServer> server;
+    ASSERT_EQ(error::nil, NewTCPServer(listener, config, [&](const std::shared_ptr<TCPSocket>& sock) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sock->Close();
+    }, &server));
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, server->Serve());
+    });
+
+    // when: connect while the only worker is busy with the first connection
+    std::vector<std::shared_ptr<TCPSocket>> sockets;
+    for (int i = 0; i < nClients; i++) {
+        std::shared_ptr<TCPSocket> socket;
+        ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &socket));
+        sockets.push_back(socket);
+    }
+    for (int i = 0; i < 100 && server->Stats().Accepted < (uint64_t) nClients; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ((uint64_t) nClients, server->Stats().Accepted);
+
+    // when: close, and let the running handler return
+    std::thread closer([&]() {
+        EXPECT_EQ(error::nil, server->Close());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+    closer.join();
+    th.join();
+
+    // then: the waiting connections have been closed without running the handler
+    EXPECT_EQ(1u, server->Stats().Handled);
+    for (auto& socket : sockets) {
+        char buf[16];
+        int nbytes = 0;
+        EXPECT_EQ(error::eof, socket->Read(buf, sizeof(buf), &nbytes));
+        socket->Close();
+    }
+}
+
+#ifdef __linux__
+TEST(TCPServer, OutOfFileDescriptors) {
+    // setup:
+    const unsigned int port = 8080;
+    const int nClients = 4;
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    TCPServerConfig config = {};
+    config.Workers = 1;
+    std::shared_ptr<TCPServer> server;
+    ASSERT_EQ(error::nil, NewTCPServer(listener, config, [](const std::shared_ptr<TCPSocket>& sock) {
+        sock->Close();
+    }, &server));
+    std::thread th([&]() {
+        EXPECT_EQ(error::nil, server->Serve());
+    });
+    std::vector<int> clients;
+    for (int i = 0; i < nClients; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(-1, fd);
+        clients.push_back(fd);
+    }
+
+    // when: connect while the server can open no more files
+    struct rlimit original;
+    ASSERT_TRUE(exhaustFileLimit(&original));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int fd : clients) {
+        ASSERT_EQ(0, connect(fd, (struct sockaddr*) &addr, sizeof(addr)));
+    }
+    int64_t cpu = cpuMilliseconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    cpu = cpuMilliseconds() - cpu;
+    restoreFileLimit(original);
+
+    // then: Serve backs off instead of spinning
+    EXPECT_LT(cpu, 250);
+    EXPECT_EQ(0u, server->Stats().Accepted);
+
+    // then: the connections are accepted once files can be opened again
+    for (int i = 0; i < 100 && server->Stats().Accepted < (uint64_t) nClients; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ((uint64_t) nClients, server->Stats().Accepted);
+
+    // cleanup:
+    EXPECT_EQ(error::nil, server->Close());
+    th.join();
+    for (int fd : clients) {
+        close(fd);
+    }
+}
+#endif // __linux__
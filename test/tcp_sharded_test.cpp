@@ -0,0 +1,117 @@
+#include "netlib/tcp_sharded.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "test_helper.h"
+
+using namespace net;
+
+TEST(TCPSharded, ListenAndConnect) {
+    // setup:
+    const std::string host = "localhost";
+    const int nThreads = 4;
+    const int nClients = 32;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    // when: run a sharded TCP server which echoes back everything it receives
+    std::shared_ptr<ShardedTCPListener> server;
+    error err = ListenTCPSharded(0, nThreads, [](EventLoop* loop, const std::shared_ptr<TCPSocket>& sock) {
+        EventHandler handler;
+        handler.OnReadable = [loop, sock]() {
+            char buf[256];
+            int nbytes;
+            while (true) {
+                error err = sock->Read(buf, sizeof(buf), &nbytes);
+                if (err != error::nil) {
+                    if (err != error::wouldblock) {
+                        loop->Remove(sock->FD());
+                    }
+                    return;
+                }
+                sock->WriteFull(buf, nbytes);
+            }
+        };
+        loop->Add(sock->FD(), handler);
+    }, &server);
+    ASSERT_EQ(error::nil, err);
+    EXPECT_EQ((size_t) nThreads, server->Size());
+    EXPECT_NE(0, server->Port());
+
+    // when: connect many clients
+    for (int i = 0; i < nClients; i++) {
+        std::shared_ptr<TCPSocket> socket;
+        err = ConnectTCP(host, server->Port(), connectionTimeout, &socket);
+        ASSERT_EQ(error::nil, err);
+        err = socket->WriteFull(message, sizeof(message));
+        EXPECT_EQ(error::nil, err);
+
+        // then: receive the echoed message
+        char buf[256] = {0};
+        err = socket->ReadFull(buf, sizeof(message));
+        EXPECT_EQ(error::nil, err);
+        EXPECT_STREQ(message, buf);
+    }
+
+    // then: every connection has been accepted by one of the shards
+    uint64_t accepted = 0;
+    for (size_t i = 0; i < server->Size(); i++) {
+        accepted += server->Accepted(i);
+    }
+    EXPECT_EQ((uint64_t) nClients, accepted);
+
+    // cleanup:
+    EXPECT_EQ(error::nil, server->Close());
+}
+
+TEST(TCPSharded, OutOfFileDescriptors) {
+    // setup:
+    const int nClients = 4;
+    std::shared_ptr<ShardedTCPListener> server;
+    ASSERT_EQ(error::nil, ListenTCPSharded(0, 1, [](EventLoop* loop, const std::shared_ptr<TCPSocket>& sock) {
+        // keep nothing, which closes the connection
+    }, &server));
+    std::vector<int> clients;
+    for (int i = 0; i < nClients; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(-1, fd);
+        clients.push_back(fd);
+    }
+
+    // when: connect while the server can open no more files
+    struct rlimit original;
+    ASSERT_TRUE(exhaustFileLimit(&original));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server->Port());
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int fd : clients) {
+        ASSERT_EQ(0, connect(fd, (struct sockaddr*) &addr, sizeof(addr)));
+    }
+    int64_t cpu = cpuMilliseconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    cpu = cpuMilliseconds() - cpu;
+    restoreFileLimit(original);
+
+    // then: the worker backs off instead of spinning
+    EXPECT_LT(cpu, 250);
+    EXPECT_EQ(0u, server->Accepted(0));
+
+    // then: the connections are accepted once files can be opened again
+    for (int i = 0; i < 100 && server->Accepted(0) < (uint64_t) nClients; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ((uint64_t) nClients, server->Accepted(0));
+
+    // cleanup:
+    EXPECT_EQ(error::nil, server->Close());
+    for (int fd : clients) {
+        close(fd);
+    }
+}
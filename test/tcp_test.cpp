@@ -1,9 +1,20 @@
 #include "netlib/tcp.h"
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <future>
 #include <string>
 #include <thread>
+#include <vector>
+#if !defined(_WIN32) && !defined(_WIN64)
+ #include <fcntl.h>
+ #include <netinet/in.h>
+ #include <netinet/tcp.h>
+ #include <sys/socket.h>
+ #include <unistd.h>
+#endif // !defined(_WIN32) && !defined(_WIN64)
 #include <gtest/gtest.h>
+#include "netlib/bufio.h"
 
 using namespace net;
 
@@ -173,3 +184,411 @@ TEST(TCP, AcceptTimeout) {
     // then: time of timeout is accurate
     EXPECT_NEAR(acceptTimeout, diff.count(), acceptTimeout * 0.5);
 }
+
+TEST(TCP, NonBlocking) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    ASSERT_EQ(error::nil, listener->SetNonBlocking(true));
+
+    // when: accept without a pending connection
+    std::shared_ptr<TCPSocket> server;
+    error err = listener->Accept(&server);
+
+    // then: err is EAGAIN or EWOULDBLOCK
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+
+    // when: connect to the TCP server
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    for (int i = 0; i < 100 && err != error::nil; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        err = listener->Accept(&server);
+    }
+    ASSERT_EQ(error::nil, err);
+
+    // then: the accepted socket is non-blocking as well
+    EXPECT_TRUE(server->IsNonBlocking());
+    char buf[256];
+    int nbytes;
+    err = server->Read(buf, sizeof(buf), &nbytes);
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+
+    // when: write until the socket buffers are full
+    ASSERT_EQ(error::nil, client->SetNonBlocking(true));
+    std::string data(1024 * 1024, 'x');
+    size_t written = 0;
+    err = error::nil;
+    for (int i = 0; i < 64 && err == error::nil; i++) {
+        err = client->WriteFull(data.data(), data.size(), &written);
+    }
+
+    // then: the partial write is reported, and the rest of the data would block
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+    EXPECT_LT(written, data.size());
+}
+
+TEST(TCP, AcceptMany) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const size_t nClients = 3;
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+#if !defined(_WIN32) && !defined(_WIN64)
+    EXPECT_NE(0, fcntl(listener->FD(), F_GETFD) & FD_CLOEXEC);
+#endif // !defined(_WIN32) && !defined(_WIN64)
+    std::vector<std::shared_ptr<TCPSocket>> clients(nClients);
+    for (auto& client : clients) {
+        ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    }
+
+    // when: accept fewer connections than pending
+    std::vector<std::shared_ptr<TCPSocket>> servers;
+    error err = listener->AcceptMany(&servers, nClients - 1);
+
+    // then: maxCount connections are accepted
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(nClients - 1, servers.size());
+
+    // when: accept the rest of the backlog
+    err = listener->AcceptMany(&servers, nClients);
+
+    // then: the rest is appended without blocking
+    EXPECT_EQ(error::nil, err);
+    ASSERT_EQ(nClients, servers.size());
+    for (auto& server : servers) {
+        EXPECT_TRUE(server->IsNonBlocking());
+#if !defined(_WIN32) && !defined(_WIN64)
+        EXPECT_NE(0, fcntl(server->FD(), F_GETFD) & FD_CLOEXEC);
+#endif // !defined(_WIN32) && !defined(_WIN64)
+        EXPECT_EQ("127.0.0.1", server->RemoteAddress());
+    }
+
+    // when: accept in non-blocking mode without a pending connection
+    ASSERT_EQ(error::nil, listener->SetNonBlocking(true));
+    err = listener->AcceptMany(&servers, nClients);
+
+    // then: err is EAGAIN or EWOULDBLOCK
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+    EXPECT_EQ(nClients, servers.size());
+}
+
+#ifdef __linux__
+TEST(TCP, SocketOptions) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    SocketOptions options = SocketOptions::LowLatency();
+    options.ReceiveBufferSize = 64 * 1024;
+    options.Backlog = 16;
+
+    // when: listen and connect with the options
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, options, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, options, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+
+    // then: the options are set on the client, and inherited by the accepted socket
+    int fds[] = {client->FD(), server->FD()};
+    for (int fd : fds) {
+        int value = 0;
+        socklen_t len = sizeof(value);
+        ASSERT_EQ(0, getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &len));
+        EXPECT_EQ(1, value);
+        ASSERT_EQ(0, getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, &len));
+        EXPECT_EQ(options.NotSentLowWatermark, value);
+        ASSERT_EQ(0, getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, &len));
+        EXPECT_EQ(options.ReceiveBufferSize * 2, value); // doubled by the kernel for its bookkeeping
+    }
+
+    // when: listen on the port again with SO_REUSEPORT on neither
+    // then: the port is in use
+    std::shared_ptr<TCPListener> other;
+    EXPECT_EQ(error::addrinuse, ListenTCP(port, &other));
+}
+
+TEST(TCP, FastOpen) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const std::string request = "request";
+    SocketOptions options = SocketOptions();
+    options.FastOpenQueueLength = 16;
+    int sysctl = 0;
+    FILE* fp = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+    if (fp != nullptr) {
+        EXPECT_EQ(1, fscanf(fp, "%d", &sysctl));
+        fclose(fp);
+    }
+    const bool clientEnabled = (sysctl & 0x1) != 0;
+    const bool enabled = (sysctl & 0x3) == 0x3; // the client and the server bits
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, options, &listener));
+
+    // when: connect twice, the first of which fetches a cookie unless one has been cached by an earlier run
+    for (int i = 0; i < 2; i++) {
+        bool sentWithSYN = true;
+        std::shared_ptr<TCPSocket> client;
+        ASSERT_EQ(error::nil, ConnectTCPFastOpen(host, port, connectionTimeout, SocketOptions(),
+                request.data(), request.size(), &sentWithSYN, &client));
+        std::shared_ptr<TCPSocket> server;
+        ASSERT_EQ(error::nil, listener->Accept(&server));
+
+        // then: the data arrives either way, and goes in the SYN once a cookie is cached
+        std::string buf(request.size(), '\0');
+        ASSERT_EQ(error::nil, server->ReadFull(&buf[0], buf.size()));
+        EXPECT_EQ(request, buf);
+        if (!clientEnabled) {
+            EXPECT_FALSE(sentWithSYN);
+        } else if (i > 0 && enabled) {
+            EXPECT_TRUE(sentWithSYN);
+        }
+    }
+}
+#endif // __linux__
+
+TEST(TCP, ReadVWriteV) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    std::string header = "header";
+    std::string payload(1024 * 1024, 'x'); // larger than the socket buffers
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+
+    // when: write a header and a payload at once
+    std::thread th([&]() {
+        const IOVec iov[] = {{&header[0], header.size()}, {&payload[0], payload.size()}};
+        size_t written = 0;
+        EXPECT_EQ(error::nil, client->WriteFullV(iov, 2, &written));
+        EXPECT_EQ(header.size() + payload.size(), written);
+    });
+
+    // then: the header and the payload are scattered into their own buffers
+    std::string receivedHeader(header.size(), '\0');
+    std::string receivedPayload(payload.size(), '\0');
+    size_t offset = 0;
+    while (offset < receivedHeader.size() + receivedPayload.size()) {
+        IOVec iov[2];
+        size_t count = 0;
+        if (offset < receivedHeader.size()) {
+            iov[count++] = {&receivedHeader[offset], receivedHeader.size() - offset};
+            iov[count++] = {&receivedPayload[0], receivedPayload.size()};
+        } else {
+            size_t payloadOffset = offset - receivedHeader.size();
+            iov[count++] = {&receivedPayload[payloadOffset], receivedPayload.size() - payloadOffset};
+        }
+        int nbytes = 0;
+        ASSERT_EQ(error::nil, server->ReadV(iov, count, &nbytes));
+        offset += nbytes;
+    }
+    th.join();
+    EXPECT_EQ(header, receivedHeader);
+    EXPECT_TRUE(payload == receivedPayload);
+}
+
+#ifdef __linux__
+TEST(TCP, SendFileAndSplice) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const int64_t timeout = 10; // ms
+    const std::string content = "0123456789";
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+
+    FILE* file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), file));
+    fflush(file);
+
+    // when: send a range of the file
+    size_t sent = 0;
+    error err = server->SendFile(fileno(file), 2, 5, &sent);
+
+    // then: the range is received
+    EXPECT_EQ(error::nil, err);
+    EXPECT_EQ(5u, sent);
+    char buf[16] = {0};
+    EXPECT_EQ(error::nil, client->ReadFull(buf, 5));
+    EXPECT_STREQ("23456", buf);
+
+    // when: send beyond the end of the file
+    err = server->SendFile(fileno(file), 8, 5, &sent);
+
+    // then: the rest of the file is sent with end of file
+    EXPECT_EQ(error::eof, err);
+    EXPECT_EQ(2u, sent);
+    fclose(file);
+
+    // when: splice from a pipe which has fewer bytes than requested
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(3, write(fds[1], "abc", 3));
+    ASSERT_EQ(error::nil, server->SetTimeout(timeout));
+    err = server->Splice(fds[0], 4, &sent);
+
+    // then: the partial progress is reported with the timeout
+    EXPECT_EQ(error::timedout, err);
+    EXPECT_EQ(3u, sent);
+    memset(buf, 0, sizeof(buf));
+    EXPECT_EQ(error::nil, client->ReadFull(buf, 5));
+    EXPECT_STREQ("89abc", buf);
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif // __linux__
+
+#ifdef __linux__
+TEST(TCP, WriteZeroCopy) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const std::string message(64 * 1024, 'x');
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    error err = server->SetZeroCopy(true);
+    if (err == error::opnotsupp) {
+        return; // the kernel is older than 4.14
+    }
+    ASSERT_EQ(error::nil, err);
+
+    // when: send twice without copying
+    uint32_t ids[2];
+    for (uint32_t& id : ids) {
+        int nbytes = 0;
+        ASSERT_EQ(error::nil, server->WriteZeroCopy(message.data(), message.size(), &nbytes, &id));
+        ASSERT_EQ((int) message.size(), nbytes);
+    }
+
+    // then: the ids count up, and the message is received as is
+    EXPECT_EQ(0u, ids[0]);
+    EXPECT_EQ(1u, ids[1]);
+    std::string received(message.size() * 2, '\0');
+    ASSERT_EQ(error::nil, client->ReadFull(&received[0], received.size()));
+    EXPECT_TRUE(message + message == received);
+
+    // then: both sends are completed
+    std::vector<ZeroCopyCompletion> completions;
+    for (int i = 0; i < 100; i++) {
+        server->ReadZeroCopyCompletions(&completions);
+        if (!completions.empty() && completions.back().Last == ids[1]) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(completions.empty());
+    EXPECT_EQ(ids[0], completions.front().First);
+    EXPECT_EQ(ids[1], completions.back().Last);
+
+    // then: no more completions are pending
+    EXPECT_TRUE(error::wouldblock == server->ReadZeroCopyCompletions(&completions));
+}
+#endif // __linux__
+
+#ifdef __linux__
+TEST(TCP, BufferedWriterCork) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const int64_t timeout = 10; // ms
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+    std::shared_ptr<TCPSocket> client;
+    ASSERT_EQ(error::nil, ConnectTCP(host, port, connectionTimeout, &client));
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    ASSERT_EQ(error::nil, server->SetTimeout(timeout));
+    BufferedWriter writer(client, BufferedWriterConfig{4, 0, true});
+
+    // when: write more than the buffer holds
+    ASSERT_EQ(error::nil, writer.WriteFull("abc", 3));
+    ASSERT_EQ(error::nil, writer.WriteFull("def", 3));
+
+    // then: the tail is still buffered, and the rest is held back by the cork
+    EXPECT_EQ(3u, writer.Buffered());
+    char buf[16] = {0};
+    int nbytes = 0;
+    error err = server->Read(buf, sizeof(buf), &nbytes);
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+
+    // when: flush
+    ASSERT_EQ(error::nil, writer.Flush());
+
+    // then: everything is received
+    EXPECT_EQ(error::nil, server->ReadFull(buf, 6));
+    EXPECT_STREQ("abcdef", buf);
+}
+#endif // __linux__
+
+TEST(TCP, ConnectHappyEyeballs) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+    const char message[] = "message";
+
+    std::shared_ptr<TCPListener> listener;
+    ASSERT_EQ(error::nil, ListenTCP(port, &listener));
+
+    // when: connect to every address of localhost, of which only IPv4 is listened on
+    std::shared_ptr<TCPSocket> client;
+    error err = ConnectTCPHappyEyeballs(host, port, connectionTimeout, &client);
+
+    // then: the connection to the IPv4 address is kept
+    ASSERT_EQ(error::nil, err);
+    EXPECT_EQ("127.0.0.1", client->RemoteAddress());
+
+    // then: the connection is usable
+    std::shared_ptr<TCPSocket> server;
+    ASSERT_EQ(error::nil, listener->Accept(&server));
+    EXPECT_EQ(error::nil, client->WriteFull(message, sizeof(message)));
+    char buf[256] = {0};
+    EXPECT_EQ(error::nil, server->ReadFull(buf, sizeof(message)));
+    EXPECT_STREQ(message, buf);
+}
+
+TEST(TCP, ConnectHappyEyeballsRefused) {
+    // setup:
+    const unsigned int port = 8080;
+    const int64_t connectionTimeout = 1000; // ms
+
+    // when: connect to a port which nobody listens on
+    std::shared_ptr<TCPSocket> client;
+    error err = ConnectTCPHappyEyeballs("localhost", port, connectionTimeout, &client);
+
+    // then: the error of the last attempt is returned without waiting for the timeout
+    EXPECT_EQ(error::connrefused, err);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <cstdint>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/** CPU time consumed by this process in milliseconds, in user and system mode together. */
+inline int64_t cpuMilliseconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+/**
+ * Lower the soft limit of open files to the lowest free fd,
+ * so that the process can open no more files until restoreFileLimit is called.
+ *
+ * @param[out] original The original limit
+ * @return false if the limit could not be changed
+ */
+inline bool exhaustFileLimit(struct rlimit* original) {
+    if (getrlimit(RLIMIT_NOFILE, original) != 0) {
+        return false;
+    }
+    int spare = dup(0);
+    if (spare == -1) {
+        return false;
+    }
+    close(spare);
+    struct rlimit limited = *original;
+    limited.rlim_cur = spare; // every fd below spare is in use
+    return setrlimit(RLIMIT_NOFILE, &limited) == 0;
+}
+
+/**
+ * @param[in] original The limit returned by exhaustFileLimit
+ */
+inline void restoreFileLimit(const struct rlimit& original) {
+    setrlimit(RLIMIT_NOFILE, &original);
+}
+
+#endif // __linux__
@@ -0,0 +1,93 @@
+#include "netlib/timer.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+TEST(TimerWheel, FireInOrder) {
+    // setup:
+    TimerWheel wheel(0);
+    std::vector<int> fired;
+
+    // when: schedule timers in the reverse order of expiry
+    wheel.Schedule(300, [&]() { fired.push_back(300); });
+    wheel.Schedule(20, [&]() { fired.push_back(20); });
+    wheel.Schedule(1, [&]() { fired.push_back(1); });
+    EXPECT_EQ(3u, wheel.Size());
+
+    // then: nothing fires before the time
+    EXPECT_EQ(0u, wheel.Advance(0));
+    EXPECT_EQ(1, wheel.NextTimeout(0));
+
+    // then: timers fire in the order of expiry
+    EXPECT_EQ(2u, wheel.Advance(100));
+    EXPECT_EQ(1u, wheel.Advance(300));
+    EXPECT_EQ((std::vector<int>{1, 20, 300}), fired);
+    EXPECT_EQ(0u, wheel.Size());
+    EXPECT_EQ(-1, wheel.NextTimeout(300));
+}
+
+TEST(TimerWheel, Cancel) {
+    // setup:
+    TimerWheel wheel(0);
+    bool fired = false;
+
+    // when: cancel a timer
+    TimerID id = wheel.Schedule(10, [&]() { fired = true; });
+    EXPECT_TRUE(wheel.Cancel(id));
+
+    // then: it never fires, and cannot be cancelled twice
+    EXPECT_EQ(0u, wheel.Advance(100));
+    EXPECT_FALSE(fired);
+    EXPECT_FALSE(wheel.Cancel(id));
+}
+
+TEST(TimerWheel, Cascade) {
+    // setup:
+    const int64_t start = 123456;
+    TimerWheel wheel(start);
+    std::vector<int64_t> fired;
+    // across every level, and beyond the range of the wheel
+    const std::vector<int64_t> delays = {63, 64, 4095, 4097, 262143, 262145, 16777215, 16777217, 50000000};
+
+    // when: schedule timers far in the future
+    int64_t now = start;
+    for (int64_t delay : delays) {
+        wheel.Schedule(start + delay, [&, delay]() {
+            fired.push_back(delay);
+            // then: a timer never fires early
+            EXPECT_GE(now, start + delay);
+        });
+    }
+
+    // when: advance the time to each next timeout
+    while (wheel.Size() > 0) {
+        int64_t timeout = wheel.NextTimeout(now);
+        ASSERT_GE(timeout, 0);
+        now += (timeout > 0) ? timeout : 1;
+        wheel.Advance(now);
+    }
+
+    // then: every timer fires in time
+    EXPECT_EQ(delays, fired);
+}
+
+TEST(TimerWheel, ScheduleFromTask) {
+    // setup:
+    TimerWheel wheel(0);
+    int count = 0;
+
+    // when: a task reschedules itself with a past time
+    std::function<void()> task = [&]() {
+        if (++count < 3) {
+            wheel.Schedule(0, task);
+        }
+    };
+    wheel.Schedule(1, task);
+
+    // then: it fires once per tick
+    EXPECT_EQ(1u, wheel.Advance(1));
+    EXPECT_EQ(1u, wheel.Advance(2));
+    EXPECT_EQ(1u, wheel.Advance(10));
+    EXPECT_EQ(3, count);
+}
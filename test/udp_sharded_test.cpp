@@ -0,0 +1,123 @@
+#include "netlib/udp_sharded.h"
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <gtest/gtest.h>
+
+using namespace net;
+
+static void echo(UDPSocket* sock, Datagram* msgs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        msgs[i].Len = msgs[i].Size;
+    }
+    size_t sent = 0;
+    sock->WriteBatch(msgs, count, &sent);
+}
+
+static void sendAndReceive(uint16_t port, int nMessages) {
+    const std::string host = "localhost";
+    const char message[] = "message";
+
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &client));
+    ASSERT_EQ(error::nil, client->SetTimeout(1000));
+    for (int i = 0; i < nMessages; i++) {
+        int nbytes = 0;
+        ASSERT_EQ(error::nil, client->Write(message, sizeof(message), &nbytes));
+
+        // then: receive the echoed message
+        char buf[256] = {0};
+        ASSERT_EQ(error::nil, client->Read(buf, sizeof(buf), &nbytes));
+        EXPECT_STREQ(message, buf);
+    }
+}
+
+TEST(UDPSharded, ListenAndEcho) {
+    // setup:
+    const int nThreads = 4;
+    const int nMessages = 32;
+
+    // when: run a sharded UDP server which echoes back every datagram
+    std::shared_ptr<ShardedUDPListener> server;
+    ASSERT_EQ(error::nil, ListenUDPSharded(0, nThreads, echo, &server));
+    EXPECT_EQ((size_t) nThreads, server->Size());
+    EXPECT_NE(0, server->Port());
+
+    // when: send datagrams from a single client
+    sendAndReceive(server->Port(), nMessages);
+
+    // then: the datagrams of the flow have all been received by the same shard
+    int shards = 0;
+    for (size_t i = 0; i < server->Size(); i++) {
+        if (server->Received(i) > 0) {
+            EXPECT_EQ((uint64_t) nMessages, server->Received(i));
+            shards++;
+        }
+    }
+    EXPECT_EQ(1, shards);
+
+    // cleanup:
+    EXPECT_EQ(error::nil, server->Close());
+}
+
+TEST(UDPSharded, MapCPUsToShards) {
+    // when: map an affinity mask which does not start at CPU 0
+    std::vector<int> shardOfCPU = MapCPUsToShards({2, 3, 5, 7}, 2);
+
+    // then: the listed CPUs go around the shards, and the others are left out
+    std::vector<int> expected = {-1, -1, 0, 1, -1, 0, -1, 1};
+    EXPECT_EQ(expected, shardOfCPU);
+
+    // when: map fewer CPUs than the shards
+    shardOfCPU = MapCPUsToShards({1, 4}, 3);
+
+    // then: the last shard has no CPU
+    expected = {-1, 0, -1, -1, 1};
+    EXPECT_EQ(expected, shardOfCPU);
+}
+
+TEST(UDPSharded, PinCPUsAndSteerByCPU) {
+    // setup:
+    const int nThreads = 4;
+    const int nClients = 8;
+    const int nMessages = 4;
+    ShardedUDPConfig config = ShardedUDPConfig();
+    config.PinCPUs = true;
+    config.SteerByCPU = true;
+    config.DatagramSize = 512;
+    config.BatchSize = 8;
+    cpu_set_t original;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(original), &original));
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &original)) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    // when: run a sharded UDP server steered by CPU
+    std::shared_ptr<ShardedUDPListener> server;
+    ASSERT_EQ(error::nil, ListenUDPSharded(0, nThreads, config, echo, &server));
+
+    // when: send datagrams of several flows from a single CPU, on which loopback receives them
+    int cpu = sched_getcpu();
+    ASSERT_LE(0, cpu);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    ASSERT_EQ(0, sched_setaffinity(0, sizeof(set), &set));
+    for (int i = 0; i < nClients; i++) {
+        sendAndReceive(server->Port(), nMessages);
+    }
+    sched_setaffinity(0, sizeof(original), &original);
+
+    // then: the flows, which the hash would spread, have all been steered to the shard of the CPU
+    int shard = MapCPUsToShards(cpus, nThreads)[cpu];
+    for (size_t i = 0; i < server->Size(); i++) {
+        uint64_t expected = ((int) i == shard) ? nClients * nMessages : 0;
+        EXPECT_EQ(expected, server->Received(i));
+    }
+
+    // cleanup:
+    EXPECT_EQ(error::nil, server->Close());
+}
@@ -1,8 +1,11 @@
 #include "netlib/udp.h"
+#include <cstring>
 #include <future>
 #include <string>
 #include <thread>
+#include <vector>
 #include <gtest/gtest.h>
+#include "netlib/resolver.h"
 
 using namespace net;
 
@@ -47,3 +50,316 @@ TEST(UDP, ListenAndConnect) {
     // cleanup:
     th.join();
 }
+
+TEST(UDP, NonBlocking) {
+    // setup:
+    const unsigned int port = 8080;
+
+    std::shared_ptr<UDPSocket> socket;
+    ASSERT_EQ(error::nil, ListenUDP(port, &socket));
+    ASSERT_EQ(error::nil, socket->SetNonBlocking(true));
+
+    // when: receive without a pending datagram
+    char buf[256];
+    int nbytes;
+    std::string addr;
+    uint16_t remotePort;
+    error err = socket->ReadFrom(buf, sizeof(buf), &nbytes, &addr, &remotePort);
+
+    // then: err is EAGAIN or EWOULDBLOCK
+    EXPECT_TRUE(err == error::again || err == error::wouldblock);
+}
+
+TEST(UDP, ReadVWriteV) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    char header[] = "head";
+    char payload[] = "payload";
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &client));
+
+    // when: gather two buffers into a datagram
+    const IOVec out[] = {{header, 4}, {payload, 7}};
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->WriteV(out, 2, &nbytes));
+    EXPECT_EQ(11, nbytes);
+
+    // then: the datagram is scattered at the given boundary
+    char first[2] = {0};
+    char second[16] = {0};
+    const IOVec in[] = {{first, sizeof(first)}, {second, sizeof(second)}};
+    ASSERT_EQ(error::nil, server->ReadV(in, 2, &nbytes));
+    EXPECT_EQ(11, nbytes);
+    EXPECT_EQ(0, memcmp("he", first, 2));
+    EXPECT_STREQ("adpayload", second);
+}
+
+TEST(UDP, ReadFromWriteToEndpoint) {
+    // setup:
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ListenUDP(0, &client));
+    Endpoint serverEndpoint;
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.1", port, &serverEndpoint));
+
+    // when: send to an endpoint
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->WriteTo(message, sizeof(message), serverEndpoint, &nbytes));
+
+    // then: the peer is received as an endpoint, to which a reply goes back
+    char buf[256] = {0};
+    Endpoint peer;
+    ASSERT_EQ(error::nil, server->ReadFrom(buf, sizeof(buf), &nbytes, &peer));
+    EXPECT_STREQ(message, buf);
+    EXPECT_EQ("127.0.0.1", peer.Address());
+    ASSERT_EQ(error::nil, server->WriteTo(buf, nbytes, peer, &nbytes));
+    Endpoint from;
+    ASSERT_EQ(error::nil, client->ReadFrom(buf, sizeof(buf), &nbytes, &from));
+    EXPECT_EQ(serverEndpoint, from);
+}
+
+TEST(UDP, Connected) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const char message[] = "message";
+    const char foreign[] = "foreign";
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, SocketOptions(), true, &client));
+    EXPECT_TRUE(client->IsConnected());
+    std::shared_ptr<UDPSocket> other;
+    ASSERT_EQ(error::nil, ListenUDP(0, &other));
+
+    // when: write to the connected peer
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->Write(message, sizeof(message), &nbytes));
+    char buf[256] = {0};
+    Endpoint peer;
+    ASSERT_EQ(error::nil, server->ReadFrom(buf, sizeof(buf), &nbytes, &peer));
+    EXPECT_STREQ(message, buf);
+
+    // when: another socket sends to the client before the server replies
+    uint16_t clientPort = 0;
+    ASSERT_EQ(error::nil, LookupPort(client->FD(), &clientPort));
+    Endpoint clientEndpoint;
+    ASSERT_EQ(error::nil, Endpoint::Parse("127.0.0.1", clientPort, &clientEndpoint));
+    ASSERT_EQ(error::nil, other->WriteTo(foreign, sizeof(foreign), clientEndpoint, &nbytes));
+    ASSERT_EQ(error::nil, server->WriteTo(message, sizeof(message), peer, &nbytes));
+
+    // then: only the datagram of the connected peer is received
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(error::nil, client->Read(buf, sizeof(buf), &nbytes));
+    EXPECT_STREQ(message, buf);
+}
+
+TEST(UDP, ConnectedRefused) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const char message[] = "message";
+
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, SocketOptions(), true, &client));
+    ASSERT_EQ(error::nil, client->SetTimeout(1000));
+
+    // when: write to a port which nobody listens on
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->Write(message, sizeof(message), &nbytes));
+
+    // then: the ICMP port unreachable fails the next read
+    char buf[256];
+    EXPECT_EQ(error::connrefused, client->Read(buf, sizeof(buf), &nbytes));
+}
+
+TEST(UDP, ReadWriteBatch) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    char small[] = "small";
+    char large[] = "larger than the buffer";
+    char last[] = "last";
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &client));
+
+    // when: send three datagrams at once to the remote of ConnectUDP
+    Datagram out[3] = {};
+    out[0].Buf = small;
+    out[0].Len = 5;
+    out[1].Buf = large;
+    out[1].Len = 22;
+    out[2].Buf = last;
+    out[2].Len = 4;
+    size_t sent = 0;
+    ASSERT_EQ(error::nil, client->WriteBatch(out, 3, &sent));
+    EXPECT_EQ(3u, sent);
+
+    // then: every datagram is received with its length and peer, and the large one is truncated
+    char bufs[4][8];
+    Datagram in[4] = {};
+    for (int i = 0; i < 4; i++) {
+        in[i].Buf = bufs[i];
+        in[i].Len = sizeof(bufs[i]);
+    }
+    size_t received = 0;
+    while (received < 3) {
+        size_t n = 0;
+        ASSERT_EQ(error::nil, server->ReadBatch(&in[received], 4 - received, &n));
+        received += n;
+    }
+    EXPECT_EQ(3u, received);
+    EXPECT_EQ(5u, in[0].Size);
+    EXPECT_FALSE(in[0].Truncated);
+    EXPECT_EQ(0, memcmp(small, in[0].Buf, 5));
+    EXPECT_EQ(8u, in[1].Size);
+    EXPECT_TRUE(in[1].Truncated);
+    EXPECT_EQ(0, memcmp(large, in[1].Buf, 8));
+    EXPECT_EQ(4u, in[2].Size);
+    EXPECT_EQ(0, memcmp(last, in[2].Buf, 4));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ("127.0.0.1", in[i].Peer.Address());
+        EXPECT_NE(0, in[i].Peer.Port());
+        EXPECT_EQ(in[0].Peer, in[i].Peer);
+    }
+
+    // when: reply to the peer of a received datagram
+    Datagram reply = in[0];
+    reply.Len = reply.Size;
+    ASSERT_EQ(error::nil, server->WriteBatch(&reply, 1, &sent));
+
+    // then: the client receives the reply
+    char buf[8] = {0};
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->Read(buf, sizeof(buf), &nbytes));
+    EXPECT_EQ(5, nbytes);
+    EXPECT_STREQ(small, buf);
+}
+
+#ifdef __linux__
+TEST(UDP, ReusePort) {
+    // setup:
+    const unsigned int port = 8080;
+    SocketOptions options = SocketOptions();
+    options.ReusePort = true;
+
+    // when: listen on the same port twice with SO_REUSEPORT
+    std::shared_ptr<UDPSocket> first;
+    ASSERT_EQ(error::nil, ListenUDP(port, options, &first));
+    std::shared_ptr<UDPSocket> second;
+    error err = ListenUDP(port, options, &second);
+
+    // then: both are bound
+    EXPECT_EQ(error::nil, err);
+
+    // when: without SO_REUSEPORT
+    // then: the port is in use
+    std::shared_ptr<UDPSocket> third;
+    EXPECT_EQ(error::addrinuse, ListenUDP(port, &third));
+}
+
+TEST(UDP, SegmentationOffload) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const size_t segmentSize = 1000;
+    std::vector<char> payload(3500);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = (char) i;
+    }
+    std::vector<char> buf(64 * 1024);
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &client));
+    Datagram out = {};
+    out.Buf = payload.data();
+    out.Len = payload.size();
+    Datagram in = {};
+    in.Buf = buf.data();
+    in.Len = buf.size();
+
+    // when: send the payload in segments
+    int nbytes = 0;
+    ASSERT_EQ(error::nil, client->WriteSegmented(out, segmentSize, &nbytes));
+    EXPECT_EQ(3500, nbytes);
+
+    // then: the receiver without coalescing gets a datagram per segment
+    const size_t sizes[] = {1000, 1000, 1000, 500};
+    size_t offset = 0;
+    for (size_t expected : sizes) {
+        size_t segment = 0;
+        ASSERT_EQ(error::nil, server->ReadCoalesced(&in, &segment));
+        EXPECT_EQ(expected, in.Size);
+        EXPECT_EQ(expected, segment);
+        EXPECT_EQ(0, memcmp(&payload[offset], in.Buf, in.Size));
+        offset += in.Size;
+    }
+
+    // when: send again to the receiver coalescing datagrams
+    ASSERT_EQ(error::nil, server->SetReceiveCoalescing(true));
+    ASSERT_EQ(error::nil, client->WriteSegmented(out, segmentSize, &nbytes));
+
+    // then: the segments are read at once along with their size
+    size_t segment = 0;
+    ASSERT_EQ(error::nil, server->ReadCoalesced(&in, &segment));
+    EXPECT_EQ(payload.size(), in.Size);
+    EXPECT_EQ(segmentSize, segment);
+    EXPECT_FALSE(in.Truncated);
+    EXPECT_EQ(0, memcmp(payload.data(), in.Buf, in.Size));
+}
+
+TEST(UDP, SegmentationLimits) {
+    // setup:
+    const std::string host = "localhost";
+    const unsigned int port = 8080;
+    const size_t segmentSize = 8;
+    std::vector<char> payload(UDPSocket::kMaxSegmentedLength + 1);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = (char) i;
+    }
+
+    std::shared_ptr<UDPSocket> server;
+    ASSERT_EQ(error::nil, ListenUDP(port, &server));
+    std::shared_ptr<UDPSocket> client;
+    ASSERT_EQ(error::nil, ConnectUDP(host, port, &client));
+    Datagram out = {};
+    out.Buf = payload.data();
+    int nbytes = 0;
+
+    // when: exceed the number of segments, the segment size or the total length
+    // then: the call is refused, without turning segmentation off
+    out.Len = segmentSize * (UDPSocket::kMaxSegments + 1);
+    EXPECT_EQ(error::illegal_argument, client->WriteSegmented(out, segmentSize, &nbytes));
+    out.Len = 1000;
+    EXPECT_EQ(error::illegal_argument, client->WriteSegmented(out, 65536, &nbytes));
+    out.Len = payload.size();
+    EXPECT_EQ(error::illegal_argument, client->WriteSegmented(out, 65535, &nbytes));
+
+    // when: send as many segments as allowed
+    out.Len = segmentSize * UDPSocket::kMaxSegments;
+    ASSERT_EQ(error::nil, client->WriteSegmented(out, segmentSize, &nbytes));
+    EXPECT_EQ((int) out.Len, nbytes);
+
+    // then: every segment has arrived as a datagram
+    for (size_t i = 0; i < UDPSocket::kMaxSegments; i++) {
+        char buf[64] = {0};
+        ASSERT_EQ(error::nil, server->Read(buf, sizeof(buf), &nbytes));
+        ASSERT_EQ((int) segmentSize, nbytes);
+        EXPECT_EQ(0, memcmp(&payload[i * segmentSize], buf, segmentSize));
+    }
+}
+#endif // __linux__